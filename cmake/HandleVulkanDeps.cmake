@@ -23,6 +23,10 @@ macro(APPEND_GLSL_TO_TARGET target glsl_files_dir)
 
         # Get the glsl files
         file(GLOB_RECURSE glsl_source_files "${glsl_files_dir}/*.glsl")
+        # Shaders are compiled once and shared by every target using them
+        if(TARGET Shaders)
+            set(glsl_source_files)
+        endif()
         # Generate spv files for each
         foreach(glsl_file ${glsl_source_files})
             cmake_path(GET glsl_file FILENAME filename) # Removes the parent path
@@ -47,9 +51,11 @@ macro(APPEND_GLSL_TO_TARGET target glsl_files_dir)
         endforeach()
 
         # Define target for this shaders
-        add_custom_target( Shaders
-            DEPENDS ${SPIRV_BINARY_FILES}
-	    )
+        if(NOT TARGET Shaders)
+            add_custom_target( Shaders
+                DEPENDS ${SPIRV_BINARY_FILES}
+            )
+        endif()
         # Make the target dependent to shaders
         add_dependencies(${target} Shaders)
         # Copy shader files to target location
@@ -0,0 +1,43 @@
+#version 450
+
+// Writes the culled indirect commands, see vulkan_culling.h
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Commands { DrawCommand commands[]; };
+layout(std430, set = 0, binding = 2) readonly buffer CommandCounts { uint commandCounts[]; };
+layout(std430, set = 0, binding = 4) writeonly buffer CulledCommands { DrawCommand culledCommands[]; };
+layout(std430, set = 0, binding = 5) buffer CulledCounts { uint culledCounts[]; };
+
+layout(push_constant) uniform Constants {
+    uint firstCommand;
+    uint commandCount;
+    uint batch;
+    // The draw count of the batch is read from culledCounts, otherwise the commands stay in place
+    uint compact;
+} constants;
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= constants.commandCount)
+        return;
+
+    uint commandIndex = constants.firstCommand + index;
+    DrawCommand command = commands[commandIndex];
+    command.instanceCount = commandCounts[commandIndex];
+
+    uint target = commandIndex;
+    if (constants.compact != 0) {
+        if (command.instanceCount == 0)
+            return;
+        target = constants.firstCommand + atomicAdd(culledCounts[constants.batch], 1);
+    }
+    culledCommands[target] = command;
+}
@@ -0,0 +1,96 @@
+#version 450
+
+// Frustum and occlusion culling of the instances, see vulkan_culling.h
+layout(local_size_x = 64) in;
+
+struct InstanceData {
+    vec3 position;
+    uint command;
+    vec4 boundingSphere;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances { InstanceData instances[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Commands { DrawCommand commands[]; };
+layout(std430, set = 0, binding = 2) buffer CommandCounts { uint commandCounts[]; };
+layout(std430, set = 0, binding = 3) writeonly buffer VisibleInstances { uint visibleInstances[]; };
+
+// The depth pyramid of the previous frame, see vulkan_depth_pyramid.h
+layout(std430, set = 0, binding = 6) readonly buffer Occlusion {
+    // The depth in the pyramid was drawn with it
+    mat4 viewProjection;
+    // Size in pixels of the depth the pyramid was built from
+    vec2 depthSize;
+    // 0 without a pyramid to test against
+    uint levelCount;
+    uint padding;
+} occlusion;
+layout(set = 0, binding = 7) uniform sampler2D depthPyramid;
+
+layout(push_constant) uniform Constants {
+    vec4 frustumPlanes[6];
+    uint instanceCount;
+} constants;
+
+// The sphere was hidden in the previous frame: the nearest depth of its bounding box is farther than the
+// farthest depth over the pixels the box covers
+bool occluded(vec4 sphere) {
+    if (occlusion.levelCount == 0)
+        return false;
+
+    vec2 low = vec2(1.0);
+    vec2 high = vec2(-1.0);
+    float nearest = 0.0;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = occlusion.viewProjection * vec4(corner, 1.0);
+        // Crosses the near plane, nothing is in front of it
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        low = min(low, ndc.xy);
+        high = max(high, ndc.xy);
+        // Reverse-Z: the nearest depth is the greatest
+        nearest = max(nearest, ndc.z);
+    }
+
+    ivec2 lastPixel = ivec2(occlusion.depthSize) - 1;
+    ivec2 firstPixel = clamp(ivec2((low * 0.5 + 0.5) * occlusion.depthSize), ivec2(0), lastPixel);
+    ivec2 endPixel = clamp(ivec2((high * 0.5 + 0.5) * occlusion.depthSize), ivec2(0), lastPixel);
+
+    // A texel of level n covers 2 << n pixels, so the box is within 2x2 texels of the first level it is not wider than
+    ivec2 extent = endPixel - firstPixel + 1;
+    int level = min(max(findMSB(max(extent.x, extent.y) - 1), 0), int(occlusion.levelCount) - 1);
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 first = min(firstPixel >> (level + 1), levelSize - 1);
+    ivec2 last = min(endPixel >> (level + 1), levelSize - 1);
+
+    float farthest = min(min(texelFetch(depthPyramid, first, level).r, texelFetch(depthPyramid, ivec2(last.x, first.y), level).r),
+                         min(texelFetch(depthPyramid, ivec2(first.x, last.y), level).r, texelFetch(depthPyramid, last, level).r));
+    return nearest < farthest;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= constants.instanceCount)
+        return;
+
+    InstanceData instance = instances[index];
+    for (int i = 0; i < 6; ++i) {
+        if (dot(constants.frustumPlanes[i].xyz, instance.boundingSphere.xyz) + constants.frustumPlanes[i].w < -instance.boundingSphere.w)
+            return;
+    }
+    if (occluded(instance.boundingSphere))
+        return;
+
+    // Appended to the instance range of its command
+    uint slot = atomicAdd(commandCounts[instance.command], 1);
+    visibleInstances[commands[instance.command].firstInstance + slot] = index;
+}
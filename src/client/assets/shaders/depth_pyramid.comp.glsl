@@ -0,0 +1,28 @@
+#version 450
+
+// Builds a level of the depth pyramid, see vulkan_depth_pyramid.h
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// The depth of the frame for level 0, the previous level otherwise
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D destination;
+
+layout(push_constant) uniform Constants {
+    uvec2 sourceSize;
+    uvec2 destinationSize;
+} constants;
+
+void main() {
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(texel, constants.destinationSize)))
+        return;
+
+    // The last texel of an odd row (or column) covers a single source texel
+    ivec2 first = ivec2(texel * 2);
+    ivec2 last = min(first + 1, ivec2(constants.sourceSize) - 1);
+
+    // Reverse-Z: the farthest depth is the smallest
+    float depth = min(min(texelFetch(source, first, 0).r, texelFetch(source, ivec2(last.x, first.y), 0).r),
+                      min(texelFetch(source, ivec2(first.x, last.y), 0).r, texelFetch(source, last, 0).r));
+    imageStore(destination, ivec2(texel), vec4(depth));
+}
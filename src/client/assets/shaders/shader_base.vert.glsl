@@ -1,20 +1,38 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+struct InstanceData {
+    vec3 position;
+    uint command;
+    vec4 boundingSphere;
+};
+
+// Storage buffer array of the global set, see vulkan_bindless.h
+layout(std430, set = 0, binding = 0) readonly buffer Instances { InstanceData instances[]; } instanceBuffers[];
+// The instances left by the culling, see vulkan_culling.h
+layout(std430, set = 0, binding = 0) readonly buffer VisibleInstances { uint visibleInstances[]; } visibleInstanceBuffers[];
+
+// Uniforms of the frame, see vulkan_uniform_ring.h
+layout(set = 1, binding = 0) uniform Globals {
+    mat4 viewProjection;
+} globals;
+
+layout(push_constant) uniform Constants {
+    uint instanceBuffer;
+    uint visibleInstanceBuffer;
+} constants;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// The depth pre-pass and the shading pass compare their depths with EQUAL, they have to be bit identical
+invariant gl_Position;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    uint instanceIndex = visibleInstanceBuffers[constants.visibleInstanceBuffer].visibleInstances[gl_InstanceIndex];
+    InstanceData instance = instanceBuffers[constants.instanceBuffer].instances[instanceIndex];
+    gl_Position = globals.viewProjection * vec4(inPosition + instance.position, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,339 @@
+/*
+Frame benchmark harness.
+Drives the renderer headless (by default) for a fixed number of warm-up and measured frames
+and reports the distribution of the frame timings as JSON, i.e.
+
+    vulkan_benchmark --warmup 100 --frames 1000 --output result.json
+
+To run against a software driver such as lavapipe, point the loader to its ICD:
+
+    VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json vulkan_benchmark
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "vulkan_renderer.h"
+#include "platform.h"
+#include "log_assert.h"
+#include "defines.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+typedef struct benchmark_config
+{
+    u32 warmup_frames;
+    u32 measured_frames;
+    u32 width, height;
+    u32 frames_in_flight;
+    u32 recording_threads;
+    u32 draw_count;
+    b8 use_fences;
+    b8 no_gpu_culling;
+    b8 no_dynamic_rendering;
+    b8 depth_prepass;
+    u32 msaa_samples; // renderer default if 0
+    const char *present_policy; // renderer default if NULL
+    b8 windowed;
+    const char *output_path; // stdout if NULL
+} benchmark_config;
+
+// Samples of a single metric, in milliseconds
+typedef struct benchmark_samples
+{
+    f64 *values;
+    u32 count;
+    u32 capacity;
+} benchmark_samples;
+
+typedef struct benchmark_summary
+{
+    f64 min, mean, p50, p95, p99, max;
+} benchmark_summary;
+
+static void samples_create(u32 capacity, benchmark_samples *out_samples)
+{
+    out_samples->values = (f64 *)(malloc(sizeof(f64) * capacity));
+    out_samples->count = 0;
+    out_samples->capacity = capacity;
+}
+
+static void samples_push(benchmark_samples *samples, f64 value)
+{
+    if (samples->count < samples->capacity)
+        samples->values[samples->count++] = value;
+}
+
+static void samples_destroy(benchmark_samples *samples)
+{
+    free(samples->values);
+    samples->values = NULL;
+    samples->count = samples->capacity = 0;
+}
+
+static int compare_f64(const void *a, const void *b)
+{
+    f64 lhs = *(const f64 *)a, rhs = *(const f64 *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Nearest-rank percentile of sorted values
+static f64 percentile(const f64 *sorted, u32 count, f64 p)
+{
+    u32 rank = (u32)ceil(p / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static benchmark_summary summarize(benchmark_samples *samples)
+{
+    benchmark_summary summary = {};
+    if (!samples->count)
+        return summary;
+
+    qsort(samples->values, samples->count, sizeof(f64), compare_f64);
+
+    f64 sum = 0;
+    for (u32 i = 0; i < samples->count; ++i)
+        sum += samples->values[i];
+
+    summary.min = samples->values[0];
+    summary.max = samples->values[samples->count - 1];
+    summary.mean = sum / samples->count;
+    summary.p50 = percentile(samples->values, samples->count, 50);
+    summary.p95 = percentile(samples->values, samples->count, 95);
+    summary.p99 = percentile(samples->values, samples->count, 99);
+    return summary;
+}
+
+static void write_summary(FILE *out, const char *name, benchmark_samples *samples, b8 last)
+{
+    benchmark_summary s = summarize(samples);
+    fprintf(out,
+            "    \"%s\": {\"samples\": %u, \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+            name, samples->count, s.min, s.mean, s.p50, s.p95, s.p99, s.max, last ? "" : ",");
+}
+
+static void parse_args(int argc, char **argv, benchmark_config *config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        b8 has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--warmup") && has_value)
+            config->warmup_frames = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--frames") && has_value)
+            config->measured_frames = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--width") && has_value)
+            config->width = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--height") && has_value)
+            config->height = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--frames-in-flight") && has_value)
+            config->frames_in_flight = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--recording-threads") && has_value)
+            config->recording_threads = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--draws") && has_value)
+            config->draw_count = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--msaa") && has_value)
+            config->msaa_samples = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--present") && has_value)
+            config->present_policy = argv[++i];
+        else if (!strcmp(argv[i], "--output") && has_value)
+            config->output_path = argv[++i];
+        else if (!strcmp(argv[i], "--fences"))
+            config->use_fences = BC_TRUE;
+        else if (!strcmp(argv[i], "--no-gpu-culling"))
+            config->no_gpu_culling = BC_TRUE;
+        else if (!strcmp(argv[i], "--no-dynamic-rendering"))
+            config->no_dynamic_rendering = BC_TRUE;
+        else if (!strcmp(argv[i], "--depth-prepass"))
+            config->depth_prepass = BC_TRUE;
+        else if (!strcmp(argv[i], "--windowed"))
+            config->windowed = BC_TRUE;
+        else
+            printf("Unknown argument: %s\n", argv[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    benchmark_config config = {};
+    config.warmup_frames = 100;
+    config.measured_frames = 1000;
+    config.width = 800;
+    config.height = 600;
+    config.frames_in_flight = 2;
+    config.draw_count = 1;
+    parse_args(argc, argv, &config);
+
+    GLFWwindow *window = NULL;
+    if (config.windowed)
+    {
+        if (!glfwInit())
+            ERR_EXIT("Cannot initialize GLFW.\nExiting ...\n", "benchmark");
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        window = glfwCreateWindow(config.width, config.height, "Benchmark", NULL, NULL);
+        if (!window)
+            ERR_EXIT("Cannot create a window in which to draw!\n", "benchmark");
+    }
+
+    renderer_config renderer = renderer_default_config(config.width, config.height);
+    renderer.headless = !config.windowed;
+    renderer.frames_in_flight = config.frames_in_flight;
+    renderer.recording_threads = config.recording_threads;
+    renderer.draw_count = config.draw_count;
+    renderer.use_timeline_semaphores = !config.use_fences;
+    renderer.gpu_culling = !config.no_gpu_culling;
+    renderer.use_dynamic_rendering = !config.no_dynamic_rendering;
+    renderer.depth_prepass = config.depth_prepass;
+    if (config.msaa_samples)
+        renderer.msaa_samples = config.msaa_samples;
+    if (config.present_policy)
+    {
+        if (!strcmp(config.present_policy, "vsync"))
+            renderer.present_policy = RENDERER_PRESENT_POLICY_VSYNC;
+        else if (!strcmp(config.present_policy, "low-latency"))
+            renderer.present_policy = RENDERER_PRESENT_POLICY_LOW_LATENCY;
+        else if (!strcmp(config.present_policy, "uncapped"))
+            renderer.present_policy = RENDERER_PRESENT_POLICY_UNCAPPED;
+        else
+            printf("Unknown present policy: %s\n", config.present_policy);
+    }
+    if (init_renderer_with_config(window, &renderer) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+    // Otherwise the first frames draw nothing
+    renderer_wait_for_pipelines();
+
+    benchmark_samples cpu_frame_ms, gpu_frame_ms, gpu_pre_render_pass_ms, gpu_render_pass_ms, fence_wait_ms, acquire_ms, present_to_acquire_ms, host_allocation_calls;
+    samples_create(config.measured_frames, &cpu_frame_ms);
+    samples_create(config.measured_frames, &gpu_frame_ms);
+    samples_create(config.measured_frames, &gpu_pre_render_pass_ms);
+    samples_create(config.measured_frames, &gpu_render_pass_ms);
+    samples_create(config.measured_frames, &fence_wait_ms);
+    samples_create(config.measured_frames, &acquire_ms);
+    samples_create(config.measured_frames, &present_to_acquire_ms);
+    samples_create(config.measured_frames, &host_allocation_calls);
+
+    // GPU timings arrive a few frames late, so they are matched to the measured frames by number
+    u64 first_measured_frame = UINT64_MAX;
+    u64 last_measured_frame = 0;
+    u64 last_seen_gpu_frame = 0;
+    b8 seen_any_gpu_frame = BC_FALSE;
+
+    f32 delta_time = 0;
+    u32 measured = 0;
+    u32 total_frames = config.warmup_frames + config.measured_frames;
+    // A few extra frames at the end let the last GPU results come in
+    const u32 drain_frames = 4;
+    for (u32 i = 0; i < total_frames + drain_frames; ++i)
+    {
+        if (window)
+            glfwPollEvents();
+
+        f64 frame_start = platform_get_absolute_time();
+        b8 drawn = draw_frame(delta_time, window);
+        f64 frame_end = platform_get_absolute_time();
+        delta_time = (f32)(frame_end - frame_start);
+
+        if (drawn && i >= config.warmup_frames && i < total_frames)
+        {
+            renderer_frame_stats stats;
+            renderer_get_frame_stats(&stats);
+            if (first_measured_frame == UINT64_MAX)
+                first_measured_frame = stats.frame_number;
+            last_measured_frame = stats.frame_number;
+
+            samples_push(&cpu_frame_ms, (frame_end - frame_start) * 1000.0);
+            samples_push(&fence_wait_ms, stats.fence_wait_ms);
+            samples_push(&acquire_ms, stats.acquire_ms);
+            if (stats.present_to_acquire_ms > 0)
+                samples_push(&present_to_acquire_ms, stats.present_to_acquire_ms);
+            samples_push(&host_allocation_calls, (f64)stats.host_allocation_calls);
+            ++measured;
+        }
+
+        // Pick up the GPU results which arrived since the last frame (newest first)
+        u64 newest_gpu_frame = last_seen_gpu_frame;
+        renderer_gpu_frame_timings timings;
+        for (u32 ago = 0; renderer_get_gpu_timings(ago, &timings); ++ago)
+        {
+            if (seen_any_gpu_frame && timings.frame_number <= last_seen_gpu_frame)
+                break;
+            if (ago == 0)
+                newest_gpu_frame = timings.frame_number;
+            if (measured && timings.frame_number >= first_measured_frame && timings.frame_number <= last_measured_frame)
+            {
+                samples_push(&gpu_frame_ms, timings.frame_ms);
+                samples_push(&gpu_pre_render_pass_ms, timings.pre_render_pass_ms);
+                samples_push(&gpu_render_pass_ms, timings.render_pass_ms);
+            }
+        }
+        if (renderer_gpu_timings_count())
+        {
+            last_seen_gpu_frame = newest_gpu_frame;
+            seen_any_gpu_frame = BC_TRUE;
+        }
+    }
+
+    FILE *out = stdout;
+    if (config.output_path)
+    {
+        out = fopen(config.output_path, "w");
+        if (!out)
+            ERR_EXIT("Unable to open benchmark output file.\n", "benchmark");
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"warmup_frames\": %u, \"measured_frames\": %u, \"width\": %u, \"height\": %u, \"frames_in_flight\": %u, \"recording_threads\": %u, \"draws\": %u, \"gpu_culling\": %s, \"dynamic_rendering\": %s, \"depth_prepass\": %s, \"msaa_samples\": %u, \"headless\": %s},\n",
+            config.warmup_frames, measured, config.width, config.height, config.frames_in_flight,
+            config.recording_threads, config.draw_count, config.no_gpu_culling ? "false" : "true",
+            config.no_dynamic_rendering ? "false" : "true", config.depth_prepass ? "true" : "false", renderer.msaa_samples, config.windowed ? "false" : "true");
+    fprintf(out, "  \"metrics_ms\": {\n");
+    write_summary(out, "cpu_frame", &cpu_frame_ms, BC_FALSE);
+    write_summary(out, "gpu_frame", &gpu_frame_ms, BC_FALSE);
+    write_summary(out, "gpu_pre_render_pass", &gpu_pre_render_pass_ms, BC_FALSE);
+    write_summary(out, "gpu_render_pass", &gpu_render_pass_ms, BC_FALSE);
+    write_summary(out, "fence_wait", &fence_wait_ms, BC_FALSE);
+    write_summary(out, "acquire", &acquire_ms, BC_FALSE);
+    write_summary(out, "present_to_acquire", &present_to_acquire_ms, BC_TRUE);
+    fprintf(out, "  },\n");
+
+    // Driver host allocations, per frame and per VkSystemAllocationScope since init
+    static const char *scope_names[RENDERER_HOST_ALLOCATION_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+    renderer_host_memory_stats host_stats;
+    renderer_get_host_memory_stats(&host_stats);
+    fprintf(out, "  \"host_memory\": {\n");
+    write_summary(out, "calls_per_frame", &host_allocation_calls, BC_FALSE);
+    fprintf(out, "    \"pooled_bytes\": %llu,\n", (unsigned long long)host_stats.pooled_bytes);
+    for (u32 i = 0; i < RENDERER_HOST_ALLOCATION_SCOPE_COUNT; ++i)
+    {
+        const renderer_host_allocation_stats *scope = &host_stats.scopes[i];
+        fprintf(out, "    \"%s\": {\"bytes\": %llu, \"peak_bytes\": %llu, \"allocations\": %llu, \"total_calls\": %llu, \"internal_bytes\": %llu}%s\n",
+                scope_names[i], (unsigned long long)scope->bytes, (unsigned long long)scope->peak_bytes,
+                (unsigned long long)scope->allocation_count, (unsigned long long)scope->total_calls,
+                (unsigned long long)scope->internal_bytes, i + 1 < RENDERER_HOST_ALLOCATION_SCOPE_COUNT ? "," : "");
+    }
+    fprintf(out, "  }\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+
+    samples_destroy(&cpu_frame_ms);
+    samples_destroy(&gpu_frame_ms);
+    samples_destroy(&gpu_pre_render_pass_ms);
+    samples_destroy(&gpu_render_pass_ms);
+    samples_destroy(&fence_wait_ms);
+    samples_destroy(&acquire_ms);
+    samples_destroy(&present_to_acquire_ms);
+    samples_destroy(&host_allocation_calls);
+
+    cleanup_renderer();
+    if (window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+
+    return EXIT_SUCCESS;
+}
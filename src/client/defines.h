@@ -18,7 +18,7 @@ typedef float f32;
 typedef double f64;
 
 typedef char b8;
-#define BC_TRUE 1;
-#define BC_FALSE 0;
+#define BC_TRUE 1
+#define BC_FALSE 0
 
 #endif
@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
 
 b8 filesystem_exists(const char *path)
 {
@@ -141,4 +144,20 @@ b8 filesystem_write(file_handle *handle, u64 data_size, const void *data, u64 *o
         return BC_TRUE;
     }
     return BC_FALSE;
+}
+
+b8 filesystem_rename(const char *old_path, const char *new_path)
+{
+#if defined(_WIN32)
+    // rename() fails on Windows if the destination exists
+    return MoveFileExA(old_path, new_path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    // Atomic on POSIX if both paths are on the same file system
+    return rename(old_path, new_path) == 0;
+#endif
+}
+
+b8 filesystem_remove(const char *path)
+{
+    return remove(path) == 0;
 }
\ No newline at end of file
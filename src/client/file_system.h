@@ -88,4 +88,19 @@ b8 filesystem_read_all_bytes(file_handle *handle, u8 **out_bytes, u64 *out_bytes
  */
 b8 filesystem_write(file_handle *handle, u64 data_size, const void *data, u64 *out_bytes_written);
 
+/**
+ * Renames a file, replacing the destination if it exists. The file should be closed.
+ * @param old_path The current path of the file.
+ * @param new_path The new path of the file.
+ * @returns True if successful; otherwise false.
+ */
+b8 filesystem_rename(const char *old_path, const char *new_path);
+
+/**
+ * Deletes a file.
+ * @param path The path of the file to be deleted.
+ * @returns True if successful; otherwise false.
+ */
+b8 filesystem_remove(const char *path);
+
 #endif
\ No newline at end of file
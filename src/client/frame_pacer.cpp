@@ -0,0 +1,77 @@
+#include "frame_pacer.h"
+#include "platform.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FRAME_PACER_CALIBRATION_SLEEP 0.001
+#define FRAME_PACER_CALIBRATION_STEPS 8
+// Weight of a new sample in the running statistics
+#define FRAME_PACER_OVERSLEEP_WEIGHT 0.05
+
+static void add_oversleep_sample(frame_pacer *pacer, f64 oversleep, f64 weight)
+{
+    f64 difference = oversleep - pacer->oversleep_mean;
+    pacer->oversleep_mean += weight * difference;
+    pacer->oversleep_variance = (1.0 - weight) * (pacer->oversleep_variance + weight * difference * difference);
+    pacer->oversleep_estimate = pacer->oversleep_mean + sqrt(pacer->oversleep_variance);
+}
+
+static f64 measured_sleep(frame_pacer *pacer, f64 seconds, f64 weight)
+{
+    f64 start = platform_get_absolute_time();
+    platform_sleep(seconds);
+    f64 end = platform_get_absolute_time();
+    add_oversleep_sample(pacer, end - start - seconds, weight);
+    return end;
+}
+
+void frame_pacer_create(f64 target_rate, frame_pacer *out_pacer)
+{
+    memset(out_pacer, 0, sizeof(frame_pacer));
+
+    // Plain mean and variance of the calibration sleeps: the weight of the n-th sample is 1/n
+    for (u32 i = 0; i < FRAME_PACER_CALIBRATION_STEPS; ++i)
+        measured_sleep(out_pacer, FRAME_PACER_CALIBRATION_SLEEP, 1.0 / (f64)(i + 1));
+
+    frame_pacer_set_target_rate(out_pacer, target_rate);
+    frame_pacer_reset(out_pacer);
+}
+
+void frame_pacer_set_target_rate(frame_pacer *pacer, f64 target_rate)
+{
+    pacer->target_frame_time = target_rate > 0 ? 1.0 / target_rate : 0;
+    pacer->next_deadline = pacer->last_frame_start + pacer->target_frame_time;
+}
+
+f64 frame_pacer_begin_frame(frame_pacer *pacer)
+{
+    f64 now = platform_get_absolute_time();
+    if (pacer->target_frame_time > 0)
+    {
+        // A sleep can also end early, then the rest is slept again
+        f64 sleep_time = pacer->next_deadline - now - pacer->oversleep_estimate;
+        while (sleep_time > 0)
+        {
+            now = measured_sleep(pacer, sleep_time, FRAME_PACER_OVERSLEEP_WEIGHT);
+            sleep_time = pacer->next_deadline - now - pacer->oversleep_estimate;
+        }
+        while (now < pacer->next_deadline)
+            now = platform_get_absolute_time();
+
+        pacer->next_deadline += pacer->target_frame_time;
+        if (pacer->next_deadline < now)
+            pacer->next_deadline = now + pacer->target_frame_time;
+    }
+
+    f64 delta_time = now - pacer->last_frame_start;
+    pacer->last_frame_start = now;
+    return delta_time;
+}
+
+void frame_pacer_reset(frame_pacer *pacer)
+{
+    f64 now = platform_get_absolute_time();
+    pacer->last_frame_start = now - pacer->target_frame_time;
+    pacer->next_deadline = now;
+}
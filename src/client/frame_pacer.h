@@ -0,0 +1,61 @@
+#ifndef VULKAN_NOTES_1704540112_FRAME_PACER_H
+#define VULKAN_NOTES_1704540112_FRAME_PACER_H
+
+#include "defines.h"
+
+/*
+Paces the frame loop to a target rate and measures the real time between frames.
+
+Frames start on a fixed grid of deadlines, one target frame time apart. Waiting for a deadline sleeps until
+shortly before it, then spins on the clock for the rest. A sleep lasts longer than asked by an amount that
+depends on the OS timer resolution and the load of the machine, so that oversleep is measured: a few short sleeps
+are taken when the pacer is created, and the estimate (mean plus one standard deviation) follows every sleep
+taken afterwards. The thread wakes up that estimate before the deadline, so it sleeps for most of the frame and
+spins only for about the timer resolution.
+
+A frame which overruns its deadline makes the next one start right away, and the grid is restarted if a whole
+frame is missed so late frames are not followed by a burst of catching up.
+*/
+
+typedef struct frame_pacer
+{
+    // 0 when uncapped
+    f64 target_frame_time;
+    f64 next_deadline;
+    f64 last_frame_start;
+
+    // Running statistics of the time a sleep lasts longer than asked
+    f64 oversleep_mean;
+    f64 oversleep_variance;
+    // The oversleep expected at most
+    f64 oversleep_estimate;
+} frame_pacer;
+
+/**
+ * Creates a pacer and calibrates the sleep against the OS timer, which takes a few milliseconds.
+ * @param target_rate The target number of frames per second. 0 for uncapped.
+ * @param out_pacer A pointer to the pacer to be created.
+ */
+void frame_pacer_create(f64 target_rate, frame_pacer *out_pacer);
+
+/**
+ * Changes the target rate, starting with the next frame.
+ * @param pacer A pointer to the pacer.
+ * @param target_rate The target number of frames per second. 0 for uncapped.
+ */
+void frame_pacer_set_target_rate(frame_pacer *pacer, f64 target_rate);
+
+/**
+ * Waits for the start of the next frame.
+ * @param pacer A pointer to the pacer.
+ * @returns The time since the start of the previous frame in seconds.
+ */
+f64 frame_pacer_begin_frame(frame_pacer *pacer);
+
+/**
+ * Restarts the pacing after the loop has been suspended, so the next frame starts right away and its delta time
+ * doesn't include the time suspended.
+ */
+void frame_pacer_reset(frame_pacer *pacer);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef VULKAN_NOTES_1704790415_RENDERER_TYPES_H
+#define VULKAN_NOTES_1704790415_RENDERER_TYPES_H
+
+#include "defines.h"
+
+/*
+Data types shared by the public renderer API and the vulkan_* modules, which include this header rather than
+vulkan_renderer.h.
+*/
+
+#define RENDERER_MAX_FRAMES_IN_FLIGHT 4
+
+// Vertex layout of the meshes, matches the inputs of shader_base.vert.glsl
+typedef struct renderer_vertex
+{
+    f32 position[3];
+    f32 color[3];
+} renderer_vertex;
+
+// An instance of a mesh, matches the instances of shader_base.vert.glsl
+typedef struct renderer_instance
+{
+    f32 position[3];
+    // Index returned by renderer_create_mesh
+    u32 mesh;
+} renderer_instance;
+
+// How frames are handed to the display, see renderer_set_present_policy
+typedef enum renderer_present_policy
+{
+    // Every frame is shown, one per vertical blank (FIFO). No tearing; the CPU is throttled to the display
+    // rate and frames queue up behind each other, which costs latency.
+    RENDERER_PRESENT_POLICY_VSYNC,
+    // No tearing, and a newer frame replaces the one waiting for the vertical blank (MAILBOX). Without it, late
+    // frames are shown right away and may tear (FIFO_RELAXED), else FIFO.
+    RENDERER_PRESENT_POLICY_LOW_LATENCY,
+    // Frames are shown as soon as they are done, tearing (IMMEDIATE). Falls back to the low latency modes.
+    RENDERER_PRESENT_POLICY_UNCAPPED
+} renderer_present_policy;
+
+// CPU side stats of the last frame drawn
+typedef struct renderer_frame_stats
+{
+    u64 frame_number;
+    // Time spent blocked waiting for previous frames to complete (fences or timeline semaphore)
+    f64 fence_wait_ms;
+    // Time spent blocked in vkAcquireNextImageKHR
+    f64 acquire_ms;
+    // Time from the present of the acquired image to it being acquired again, i.e. how long frames spend queued in
+    // the presentation engine and on screen. 0 when headless or if the image was not presented before.
+    f64 present_to_acquire_ms;
+    // Host allocation, reallocation and free calls made by the driver during the previous frame
+    // (0 unless track_host_allocations is set)
+    u32 host_allocation_calls;
+} renderer_frame_stats;
+
+// Same values as VkSystemAllocationScope
+typedef enum renderer_host_allocation_scope
+{
+    RENDERER_HOST_ALLOCATION_SCOPE_COMMAND,
+    RENDERER_HOST_ALLOCATION_SCOPE_OBJECT,
+    RENDERER_HOST_ALLOCATION_SCOPE_CACHE,
+    RENDERER_HOST_ALLOCATION_SCOPE_DEVICE,
+    RENDERER_HOST_ALLOCATION_SCOPE_INSTANCE,
+    RENDERER_HOST_ALLOCATION_SCOPE_COUNT
+} renderer_host_allocation_scope;
+
+// Host memory the driver requested through the allocation callbacks within a scope
+typedef struct renderer_host_allocation_stats
+{
+    // Bytes currently allocated and the highest value they reached
+    u64 bytes;
+    u64 peak_bytes;
+    // Number of live allocations
+    u64 allocation_count;
+    // Allocation, reallocation and free calls since init
+    u64 total_calls;
+    // Of those, the ones made during the previous frame
+    u32 calls_last_frame;
+    // Memory the driver allocated by itself and reported with the internal allocation notifications
+    u64 internal_bytes;
+} renderer_host_allocation_stats;
+
+typedef struct renderer_host_memory_stats
+{
+    renderer_host_allocation_stats scopes[RENDERER_HOST_ALLOCATION_SCOPE_COUNT];
+    // Bytes reserved by the size class pools, used or not
+    u64 pooled_bytes;
+} renderer_host_memory_stats;
+
+// Only the first RENDERER_MAX_TIMED_DRAWS draws of a frame get their own timestamps.
+// A draw is an indirect draw call, that is all the objects drawn with the same pipeline.
+#define RENDERER_MAX_TIMED_DRAWS 64
+// Number of frames kept in the rolling GPU timing history.
+#define RENDERER_GPU_TIMING_HISTORY 256
+
+// GPU side cost of a single frame, measured with timestamp and pipeline statistics queries.
+typedef struct renderer_gpu_frame_timings
+{
+    u64 frame_number;
+    // Time between the first and the last command of the frame, i.e. up to the depth pyramid build after the render pass
+    f64 frame_ms;
+    // Time of the work recorded ahead of the render pass: the acquire barriers of the uploads and, without async
+    // compute, the culling dispatches. Async compute runs on its own queue and is not timed.
+    f64 pre_render_pass_ms;
+    // Time between the beginning and the end of the main render pass
+    f64 render_pass_ms;
+    u32 timed_draw_count;
+    f64 draw_ms[RENDERER_MAX_TIMED_DRAWS];
+
+    // Pipeline statistics of the main render pass. Only valid if has_pipeline_statistics is set
+    // (the device may not support pipelineStatisticsQuery).
+    b8 has_pipeline_statistics;
+    u64 input_assembly_vertices;
+    u64 input_assembly_primitives;
+    u64 vertex_shader_invocations;
+    u64 clipping_invocations;
+    u64 clipping_primitives;
+    u64 fragment_shader_invocations;
+} renderer_gpu_frame_timings;
+
+#endif
@@ -2,12 +2,182 @@
 #define VULKAN_NOTES_1698946259_VULKAN_RENDERER_H
 
 #include "defines.h"
+#include "renderer_types.h"
 
 struct GLFWwindow;
 
+typedef struct renderer_config
+{
+    // Render into a ring of renderer owned images instead of a window surface.
+    // No GLFW window (or display) is required and nothing is presented.
+    b8 headless;
+    // Initial framebuffer size in pixels
+    u32 width;
+    u32 height;
+    // Number of frames the CPU can record ahead of the GPU, clamped to [1, RENDERER_MAX_FRAMES_IN_FLIGHT].
+    // More frames hide CPU/GPU stalls (throughput) at the cost of input latency.
+    u32 frames_in_flight;
+    // Number of worker threads recording the draws into secondary command buffers, which the
+    // primary command buffer then executes. 0 records everything inline on the calling thread.
+    u32 recording_threads;
+    // Number of worker threads compiling the graphics pipelines, which are drawn with once compiled.
+    // 0 compiles them on the calling thread when they are created.
+    u32 pipeline_compile_threads;
+    // Number of objects drawn each frame at the origin, cycling through the created meshes, until
+    // renderer_set_instances is called. Objects sharing a mesh are drawn as instances of a single indirect command.
+    u32 draw_count;
+    // Maximum number of indirect draw commands per frame, that is of distinct meshes drawn
+    u32 draw_command_capacity;
+    // Maximum number of instances
+    u32 instance_capacity;
+    // Frustum cull the instances, then occlusion cull them against the depth pyramid of the previous frame, and
+    // compact the indirect draws in compute passes (see use_async_compute) rather than drawing every instance.
+    // Requires drawIndirectFirstInstance, and a depth format which can be sampled for the occlusion culling.
+    b8 gpu_culling;
+    // Capacity of the device local vertex and index buffers shared by all meshes
+    u32 vertex_capacity;
+    u32 index_capacity;
+    // Size of the host visible buffer uploads are staged through, bigger uploads are split
+    u32 staging_buffer_size;
+    // Bytes of uniform data each frame can write, per frame in flight
+    u32 uniform_buffer_size;
+    // Run uploads on a transfer only queue if the device has one (and supports timeline semaphores),
+    // rather than on the graphics queue
+    b8 use_transfer_queue;
+    // Submit the compute work of the frames to a compute only queue if the device has one, so it overlaps
+    // with rendering, rather than recording it into the frames' command buffers
+    b8 use_async_compute;
+    // Render straight into the swapchain images with dynamic rendering (Vulkan 1.3) rather than through a
+    // render pass and a framebuffer per image, which also have to be recreated along with the swapchain.
+    // Falls back to the render pass if the device does not support it.
+    b8 use_dynamic_rendering;
+    // Draw the depth of every instance first with a depth only pipeline, then shade only the visible fragments
+    // (depth test EQUAL). Pays off when the fragments cost more than drawing the geometry twice.
+    b8 depth_prepass;
+    // Presentation mode policy, ignored when headless
+    renderer_present_policy present_policy;
+    // Samples per pixel of the colour and depth attachments, lowered to what the device supports. 1 disables MSAA.
+    // The multisampled targets are resolved into the swapchain image in the pass and never stored, but for the depth
+    // which is also resolved for the occlusion culling (see gpu_culling).
+    u32 msaa_samples;
+    // Synchronize frames with a timeline semaphore (Vulkan 1.2) rather than a fence per frame.
+    // Falls back to fences if the device does not support it.
+    b8 use_timeline_semaphores;
+    // Pipeline cache file loaded at init and saved at cleanup. NULL disables the on-disk cache.
+    const char *pipeline_cache_path;
+    // Development: recompile the GLSL sources of shader_source_dir with glslc when they are written to, and
+    // rebuild the graphics pipelines using them in the background, swapped in at a frame boundary. Linux only.
+    b8 shader_hot_reload;
+    // The GLSL sources, the source tree's assets/shaders by default (NULL if unknown)
+    const char *shader_source_dir;
+    // Route the host allocations of the driver through the renderer's VkAllocationCallbacks,
+    // which pools small allocations and keeps the stats of renderer_get_host_memory_stats.
+    b8 track_host_allocations;
+} renderer_config;
+
+/**
+ * Returns the configuration init_renderer uses.
+ * @param width The initial framebuffer width in pixels.
+ * @param height The initial framebuffer height in pixels.
+ */
+renderer_config renderer_default_config(u32 width, u32 height);
+
 int init_renderer(GLFWwindow *window, u32 width, u32 height);
-void draw_frame(f32 delta_time, GLFWwindow *window);
+/**
+ * Initializes the renderer with the given configuration.
+ * @param window The window to present to. Can be NULL if config->headless is set.
+ * @param config The renderer configuration.
+ * @returns EXIT_SUCCESS if initialized successfully; otherwise EXIT_FAILURE.
+ */
+int init_renderer_with_config(GLFWwindow *window, const renderer_config *config);
+/**
+ * Blocks until the pipelines created so far are compiled. Until then the frames skip the draws using them,
+ * i.e. right after init_renderer.
+ */
+void renderer_wait_for_pipelines();
+/**
+ * Creates a mesh in the device local geometry buffers. The data is copied before returning and
+ * uploaded along with the next frame.
+ * @param vertices The vertices of the mesh.
+ * @param vertex_count The number of vertices.
+ * @param indices The indices of the mesh, relative to its first vertex.
+ * @param index_count The number of indices.
+ * @returns The index of the mesh or -1 on failure (i.e. the geometry buffers are full).
+ */
+i32 renderer_create_mesh(const renderer_vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
+/**
+ * Replaces the instances drawn each frame (and the draw_count default ones), from the next frame on.
+ * @param instances The instances, copied before returning.
+ * @param instance_count The number of instances.
+ * @returns True if all instances are drawn; false if some were dropped (unknown mesh, or out of capacity).
+ */
+b8 renderer_set_instances(const renderer_instance *instances, u32 instance_count);
+/**
+ * Sets the matrix the instances are transformed to clip space with. The depth buffer is reversed (cleared to 0,
+ * nearer fragments have a greater depth), so the projection should map the near plane to 1 and the far one to 0,
+ * see renderer_perspective_reverse_z. Identity by default, but for the depth: z' = 1 - z.
+ * @param view_projection The column major matrix, with a clip space depth in [0, 1].
+ */
+void renderer_set_view_projection(const f32 view_projection[16]);
+/**
+ * Builds a reverse-Z perspective projection with an infinite far plane, for a right-handed view space looking
+ * down -z with y up (flipped to Vulkan's y down). Depth is 1 at the near plane and tends to 0 at infinity.
+ * @param fov_y The vertical field of view in radians.
+ * @param aspect The width over the height of the viewport.
+ * @param near_plane The distance to the near plane, greater than 0.
+ * @param out_projection The column major matrix.
+ */
+void renderer_perspective_reverse_z(f32 fov_y, f32 aspect, f32 near_plane, f32 out_projection[16]);
+
+// window can be NULL when running headless
+// Returns true if a frame has been submitted.
+b8 draw_frame(f32 delta_time, GLFWwindow *window);
 void renderer_on_resized(int width, int height);
+/**
+ * Switches the presentation mode policy. The swapchain is recreated with the new mode when the next frame begins,
+ * the frames in flight are not waited on.
+ * @param policy The policy.
+ */
+void renderer_set_present_policy(renderer_present_policy policy);
 void cleanup_renderer();
 
+//--------------
+// Frame stats
+//--------------
+void renderer_get_frame_stats(renderer_frame_stats *out_stats);
+
+//--------------
+// Host memory
+//--------------
+/**
+ * Gets the host memory stats of the driver allocations. Can be called from any thread.
+ * @param out_stats A pointer to the structure to be populated.
+ * @returns True if track_host_allocations is enabled; otherwise false.
+ */
+b8 renderer_get_host_memory_stats(renderer_host_memory_stats *out_stats);
+
+//--------------
+// GPU timings
+//--------------
+/**
+ * Returns the number of frames in the GPU timing history (up to RENDERER_GPU_TIMING_HISTORY).
+ * Results arrive at least one frame late since they are read back without stalling.
+ */
+u32 renderer_gpu_timings_count();
+
+/**
+ * Gets the GPU timings of a frame from the rolling history.
+ * @param frames_ago 0 for the most recent frame with available results, 1 for the one before it etc.
+ * @param out_timings A pointer to the structure to be populated.
+ * @returns True if the requested frame is in the history; otherwise false.
+ */
+b8 renderer_get_gpu_timings(u32 frames_ago, renderer_gpu_frame_timings *out_timings);
+
+/**
+ * Writes the GPU timing history to a CSV file, oldest frame first.
+ * @param path The path of the file to be written.
+ * @returns True if successful; otherwise false.
+ */
+b8 renderer_dump_gpu_timings_csv(const char *path);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "job_system.h"
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define JOB_QUEUE_CAPACITY 1024
+
+typedef struct queued_job
+{
+    job work;
+    job_counter *counter;
+} queued_job;
+
+typedef struct job_system_state
+{
+    std::thread *workers;
+    u32 worker_count;
+
+    // Ring buffer of pending jobs, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable job_available;
+    queued_job queue[JOB_QUEUE_CAPACITY];
+    u32 head;
+    u32 count;
+
+    b8 is_running;
+} job_system_state;
+
+static job_system_state *state;
+
+static void run_job(const queued_job *entry, u32 thread_index)
+{
+    entry->work.function(entry->work.data, thread_index);
+    if (entry->counter)
+        entry->counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+// Pops a job if there is any. Expects the mutex to be locked.
+static b8 pop_job(queued_job *out_entry)
+{
+    if (!state->count)
+        return BC_FALSE;
+
+    *out_entry = state->queue[state->head];
+    state->head = (state->head + 1) % JOB_QUEUE_CAPACITY;
+    --state->count;
+    return BC_TRUE;
+}
+
+static void worker_main(u32 thread_index)
+{
+    for (;;)
+    {
+        queued_job entry;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->job_available.wait(lock, []
+                                      { return state->count > 0 || !state->is_running; });
+            // Drain the queue before quitting
+            if (!pop_job(&entry))
+                return;
+        }
+        run_job(&entry, thread_index);
+    }
+}
+
+b8 job_system_create(u32 worker_count)
+{
+    if (state)
+    {
+        printf("job_system_create is called when already created.\n");
+        return BC_FALSE;
+    }
+
+    state = new job_system_state();
+    state->worker_count = worker_count;
+    state->is_running = BC_TRUE;
+    state->workers = worker_count ? new std::thread[worker_count] : NULL;
+    for (u32 i = 0; i < worker_count; ++i)
+        state->workers[i] = std::thread(worker_main, i + 1);
+
+    return BC_TRUE;
+}
+
+void job_system_destroy()
+{
+    if (!state)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->is_running = BC_FALSE;
+    }
+    state->job_available.notify_all();
+    for (u32 i = 0; i < state->worker_count; ++i)
+        state->workers[i].join();
+
+    // Without workers the queue may still hold jobs nobody waited on
+    queued_job entry;
+    while (pop_job(&entry))
+        run_job(&entry, 0);
+
+    delete[] state->workers;
+    delete state;
+    state = NULL;
+}
+
+u32 job_system_worker_count()
+{
+    return state ? state->worker_count : 0;
+}
+
+void job_system_submit(const job *jobs, u32 count, job_counter *counter)
+{
+    if (counter)
+        counter->pending.fetch_add(count, std::memory_order_relaxed);
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        queued_job entry = {jobs[i], counter};
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->count < JOB_QUEUE_CAPACITY)
+            {
+                state->queue[(state->head + state->count) % JOB_QUEUE_CAPACITY] = entry;
+                ++state->count;
+                entry.work.function = NULL;
+            }
+        }
+
+        if (entry.work.function)
+            run_job(&entry, 0); // Queue is full, run it right away
+        else
+            state->job_available.notify_one();
+    }
+}
+
+b8 job_system_is_done(job_counter *counter)
+{
+    return counter->pending.load(std::memory_order_acquire) == 0;
+}
+
+void job_system_wait(job_counter *counter)
+{
+    while (!job_system_is_done(counter))
+    {
+        queued_job entry;
+        b8 popped;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            popped = pop_job(&entry);
+        }
+
+        if (popped)
+            run_job(&entry, 0);
+        else
+            std::this_thread::yield(); // The remaining jobs are running on workers
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef VULKAN_NOTES_1703771324_JOB_SYSTEM_H
+#define VULKAN_NOTES_1703771324_JOB_SYSTEM_H
+
+#include "defines.h"
+
+#include <atomic>
+
+/*
+A fixed pool of worker threads consuming a single FIFO queue of jobs.
+Thread index 0 is the thread which created the job system (the main thread), workers are 1..worker_count,
+so the index can be used to pick per-thread resources such as command pools.
+*/
+
+// thread_index is the index of the thread running the job
+typedef void (*pfn_job)(void *data, u32 thread_index);
+
+typedef struct job
+{
+    pfn_job function;
+    void *data;
+} job;
+
+// Number of unfinished jobs of a batch. Zero initialize before submitting.
+typedef struct job_counter
+{
+    std::atomic<u32> pending;
+} job_counter;
+
+/**
+ * Starts the worker threads.
+ * @param worker_count The number of worker threads. Can be 0, then jobs are run by the thread waiting on them.
+ * @returns True if started successfully; otherwise false.
+ */
+b8 job_system_create(u32 worker_count);
+
+/**
+ * Waits for the queued jobs to finish and joins the worker threads.
+ */
+void job_system_destroy();
+
+/**
+ * @returns The number of worker threads.
+ */
+u32 job_system_worker_count();
+
+/**
+ * Queues jobs. Should be called from the main thread.
+ * @param jobs The jobs to be queued. Copied, so can be released after the call.
+ * @param count The number of jobs.
+ * @param counter A pointer to the counter incremented by count and decremented as each job finishes. Can be NULL.
+ */
+void job_system_submit(const job *jobs, u32 count, job_counter *counter);
+
+/**
+ * @returns True if all the jobs counted by counter are finished.
+ */
+b8 job_system_is_done(job_counter *counter);
+
+/**
+ * Blocks until all the jobs counted by counter are finished. The calling thread runs queued jobs
+ * (as thread index 0) while waiting instead of sleeping. Should be called from the main thread.
+ */
+void job_system_wait(job_counter *counter);
+
+#endif
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "vulkan_renderer.h"
+#include "frame_pacer.h"
 #include "log_assert.h"
 #include "defines.h"
 
@@ -13,6 +15,14 @@ typedef struct application_state
     b8 is_running;
     b8 is_suspended;
     i16 width, height;
+    // Run without a window. The frame loop stops after frame_limit frames.
+    b8 headless;
+    u32 frame_limit;
+    // Frames per second, 0 for uncapped. Negative until set, then the refresh rate of the monitor is used.
+    f64 target_rate;
+    frame_pacer pacer;
+    // Rebuild the shaders and their pipelines when the sources change
+    b8 hot_reload;
 } application_state;
 static application_state *app_state;
 
@@ -42,39 +52,121 @@ void init_window(const char *name, const int width, const int height)
     glfwSetFramebufferSizeCallback(window, handle_resize);
 }
 
-int init()
+void parse_args(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--headless"))
+        {
+            app_state->headless = BC_TRUE;
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            app_state->frame_limit = (u32)strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--hot-reload"))
+        {
+            app_state->hot_reload = BC_TRUE;
+        }
+        else if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+        {
+            app_state->target_rate = strtod(argv[++i], NULL);
+        }
+        else
+        {
+            printf("Unknown argument: %s\n", argv[i]);
+        }
+    }
+}
+
+int init(int argc, char **argv)
 {
     app_state = (application_state *)(malloc(sizeof(application_state)));
+    memset(app_state, 0, sizeof(application_state));
     app_state->width = 800;
     app_state->height = 600;
-    init_window("Test Window", app_state->width, app_state->height);
-    if (init_renderer(window, app_state->width, app_state->height) == EXIT_FAILURE)
+    app_state->frame_limit = 1000;
+    app_state->target_rate = -1;
+    parse_args(argc, argv);
+
+    renderer_config config = renderer_default_config(app_state->width, app_state->height);
+    config.headless = app_state->headless;
+    config.shader_hot_reload = app_state->hot_reload;
+    if (!app_state->headless)
+        init_window("Test Window", app_state->width, app_state->height);
+
+    if (init_renderer_with_config(window, &config) == EXIT_FAILURE)
         return EXIT_FAILURE;
 
+    if (app_state->target_rate < 0)
+    {
+        // Headless runs as fast as it can unless asked otherwise
+        app_state->target_rate = 0;
+        const GLFWvidmode *video_mode = window ? glfwGetVideoMode(glfwGetPrimaryMonitor()) : NULL;
+        if (video_mode)
+            app_state->target_rate = video_mode->refreshRate;
+    }
+    frame_pacer_create(app_state->target_rate, &app_state->pacer);
+    // A window shows what it can meanwhile, headless frames are all expected to draw
+    if (app_state->headless)
+        renderer_wait_for_pipelines();
+
     return EXIT_SUCCESS;
 }
 
+// Minimized windows have a framebuffer of size 0, nothing can be presented
+static b8 is_window_suspended()
+{
+    if (glfwGetWindowAttrib(window, GLFW_ICONIFIED))
+        return BC_TRUE;
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    return width == 0 || height == 0;
+}
+
 void run()
 {
+    if (app_state->headless)
+    {
+        for (u32 i = 0; i < app_state->frame_limit; ++i)
+            draw_frame((f32)frame_pacer_begin_frame(&app_state->pacer), NULL);
+        return;
+    }
+
     while (!glfwWindowShouldClose(window))
     {
+        app_state->is_suspended = is_window_suspended();
+        if (app_state->is_suspended)
+        {
+            // Block until the window is restored (or closed) instead of trying to recreate the swapchain
+            glfwWaitEvents();
+            frame_pacer_reset(&app_state->pacer);
+            continue;
+        }
+
+        // Wait before polling so the frame is recorded with the latest input
+        f64 delta_time = frame_pacer_begin_frame(&app_state->pacer);
         glfwPollEvents();
-        draw_frame(0, window);
+        draw_frame((f32)delta_time, window);
     }
 }
 
 void shutdown()
 {
     cleanup_renderer();
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window)
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 
     free(app_state);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    init();
+    if (init(argc, argv) == EXIT_FAILURE)
+        return EXIT_FAILURE;
     run();
     shutdown();
     return EXIT_SUCCESS;
@@ -0,0 +1,79 @@
+#include "platform.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+
+f64 platform_get_absolute_time()
+{
+    static f64 clock_frequency = 0;
+    if (clock_frequency == 0)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        clock_frequency = 1.0 / (f64)frequency.QuadPart;
+    }
+
+    LARGE_INTEGER now_time;
+    QueryPerformanceCounter(&now_time);
+    return (f64)now_time.QuadPart * clock_frequency;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void platform_sleep(f64 seconds)
+{
+    if (seconds <= 0)
+        return;
+
+    // Sleep() rounds up to the system tick (15.6 ms by default), the high resolution timer (Windows 10 1803+)
+    // does not, and doesn't require raising the resolution of the whole system with timeBeginPeriod
+    static thread_local HANDLE timer = NULL;
+    static thread_local b8 timer_created = BC_FALSE;
+    if (!timer_created)
+    {
+        timer_created = BC_TRUE;
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    }
+
+    if (timer)
+    {
+        LARGE_INTEGER due_time;
+        // Relative time in 100 ns units
+        due_time.QuadPart = -(LONGLONG)(seconds * 10000000.0);
+        if (SetWaitableTimer(timer, &due_time, 0, NULL, NULL, FALSE))
+        {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+
+    Sleep((DWORD)(seconds * 1000.0));
+}
+
+#else
+#include <time.h>
+#include <errno.h>
+
+f64 platform_get_absolute_time()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 0.000000001;
+}
+
+void platform_sleep(f64 seconds)
+{
+    if (seconds <= 0)
+        return;
+
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (f64)duration.tv_sec) * 1000000000.0);
+    // Resume after a signal with the remaining time
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR)
+        ;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef VULKAN_NOTES_1703600418_PLATFORM_H
+#define VULKAN_NOTES_1703600418_PLATFORM_H
+
+#include "defines.h"
+
+/**
+ * Gets the time of a monotonic clock.
+ * @returns The absolute time in seconds. Only meaningful relative to another call.
+ */
+f64 platform_get_absolute_time();
+
+/**
+ * Suspends the calling thread. The thread sleeps for at least the given time, usually a bit more depending on
+ * the resolution of the OS timer.
+ * @param seconds The time to sleep in seconds.
+ */
+void platform_sleep(f64 seconds);
+
+#endif
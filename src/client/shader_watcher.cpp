@@ -0,0 +1,265 @@
+#include "shader_watcher.h"
+#include "platform.h"
+
+#include <stdio.h>
+
+// Set by CMake to the glslc of the Vulkan SDK
+#ifndef BC_GLSLC_EXECUTABLE
+#define BC_GLSLC_EXECUTABLE "glslc"
+#endif
+
+#if defined(__linux__)
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#define SHADER_WATCHER_CAPACITY 64
+// How often the thread checks whether it should stop, in milliseconds
+#define SHADER_WATCHER_POLL_TIMEOUT 100
+// Editors save in several steps (truncate, write, rename), they are given this long to be done
+#define SHADER_WATCHER_SETTLE_TIME 0.05
+
+typedef struct shader_watcher_state
+{
+    char source_dir[SHADER_WATCHER_MAX_PATH];
+    char output_dir[SHADER_WATCHER_MAX_PATH];
+    int inotify_fd;
+    std::thread thread;
+    std::atomic<bool> is_running;
+
+    // SPIR-V files rebuilt and not taken yet, guarded by mutex
+    std::mutex mutex;
+    char rebuilt[SHADER_WATCHER_CAPACITY][SHADER_WATCHER_MAX_PATH];
+    u32 rebuilt_count;
+} shader_watcher_state;
+
+static shader_watcher_state *state;
+
+static b8 ends_with(const char *string, const char *suffix)
+{
+    size_t length = strlen(string);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && !strcmp(string + length - suffix_length, suffix);
+}
+
+// Runs glslc with the arguments as they are: the file names never go through a shell
+static b8 run_glslc(char *const *arguments)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        printf("WARN: shader_watcher - Failed to start %s.\n", BC_GLSLC_EXECUTABLE);
+        return BC_FALSE;
+    }
+    if (pid == 0)
+    {
+        execvp(arguments[0], arguments);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return BC_FALSE;
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+        printf("WARN: shader_watcher - Could not run %s.\n", BC_GLSLC_EXECUTABLE);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Compiles <source_dir>/<name>.<stage>.glsl into out_spv_path
+static b8 compile_shader(const char *glsl_name, char *out_spv_path)
+{
+    char stem[SHADER_WATCHER_MAX_PATH];
+    size_t stem_length = strlen(glsl_name) - strlen(".glsl");
+    if (stem_length >= sizeof(stem))
+        return BC_FALSE;
+    memcpy(stem, glsl_name, stem_length);
+    stem[stem_length] = '\0';
+
+    const char *stage = strrchr(stem, '.');
+    if (!stage)
+    {
+        printf("WARN: shader_watcher - %s does not name its stage (<name>.<stage>.glsl).\n", glsl_name);
+        return BC_FALSE;
+    }
+
+    char temporary_path[SHADER_WATCHER_MAX_PATH + 8];
+    char source_path[SHADER_WATCHER_MAX_PATH * 2];
+    char stage_argument[SHADER_WATCHER_MAX_PATH];
+    int path_length = snprintf(out_spv_path, SHADER_WATCHER_MAX_PATH, "%s/%s.spv", state->output_dir, stem);
+    if (path_length < 0 || path_length >= SHADER_WATCHER_MAX_PATH)
+        return BC_FALSE;
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", out_spv_path);
+    snprintf(source_path, sizeof(source_path), "%s/%s", state->source_dir, glsl_name);
+    snprintf(stage_argument, sizeof(stage_argument), "-fshader-stage=%s", stage + 1);
+
+    char glslc[] = BC_GLSLC_EXECUTABLE;
+    char output_flag[] = "-o";
+    char *arguments[] = {glslc, stage_argument, source_path, output_flag, temporary_path, NULL};
+
+    // glslc reports the errors on stderr
+    f64 start = platform_get_absolute_time();
+    if (!run_glslc(arguments))
+    {
+        printf("WARN: shader_watcher - Failed to compile %s, the previous SPIR-V is kept.\n", glsl_name);
+        remove(temporary_path);
+        return BC_FALSE;
+    }
+    if (rename(temporary_path, out_spv_path) != 0)
+    {
+        printf("WARN: shader_watcher - Failed to replace %s.\n", out_spv_path);
+        remove(temporary_path);
+        return BC_FALSE;
+    }
+
+    printf("Compiled %s (%.1f ms).\n", glsl_name, (platform_get_absolute_time() - start) * 1000.0);
+    return BC_TRUE;
+}
+
+// Reads every pending event, and collects the names of the GLSL files written to
+static u32 read_changed_files(char (*out_names)[SHADER_WATCHER_MAX_PATH], u32 capacity)
+{
+    alignas(struct inotify_event) char buffer[4096];
+    u32 count = 0;
+    ssize_t length;
+    while ((length = read(state->inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *event_data = buffer; event_data < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)event_data;
+            event_data += sizeof(struct inotify_event) + event->len;
+            if (!event->len || !ends_with(event->name, ".glsl") || strlen(event->name) >= SHADER_WATCHER_MAX_PATH)
+                continue;
+
+            b8 known = BC_FALSE;
+            for (u32 i = 0; i < count && !known; ++i)
+                known = !strcmp(out_names[i], event->name);
+            if (!known && count < capacity)
+                strcpy(out_names[count++], event->name);
+        }
+    }
+    return count;
+}
+
+static void watcher_main()
+{
+    char changed[16][SHADER_WATCHER_MAX_PATH];
+    while (state->is_running.load(std::memory_order_relaxed))
+    {
+        struct pollfd poll_fd = {};
+        poll_fd.fd = state->inotify_fd;
+        poll_fd.events = POLLIN;
+        if (poll(&poll_fd, 1, SHADER_WATCHER_POLL_TIMEOUT) <= 0)
+            continue;
+
+        platform_sleep(SHADER_WATCHER_SETTLE_TIME);
+        u32 changed_count = read_changed_files(changed, 16);
+        for (u32 i = 0; i < changed_count; ++i)
+        {
+            char spv_path[SHADER_WATCHER_MAX_PATH];
+            if (!compile_shader(changed[i], spv_path))
+                continue;
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            b8 known = BC_FALSE;
+            for (u32 j = 0; j < state->rebuilt_count && !known; ++j)
+                known = !strcmp(state->rebuilt[j], spv_path);
+            if (!known && state->rebuilt_count < SHADER_WATCHER_CAPACITY)
+                strcpy(state->rebuilt[state->rebuilt_count++], spv_path);
+        }
+    }
+}
+
+b8 shader_watcher_create(const char *source_dir, const char *output_dir)
+{
+    if (state)
+    {
+        printf("shader_watcher_create is called when already created.\n");
+        return BC_FALSE;
+    }
+    if (strlen(source_dir) >= SHADER_WATCHER_MAX_PATH || strlen(output_dir) >= SHADER_WATCHER_MAX_PATH)
+    {
+        printf("ERROR: shader_watcher_create - The shader directories are too long.\n");
+        return BC_FALSE;
+    }
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        printf("ERROR: shader_watcher_create - Failed to initialize inotify.\n");
+        return BC_FALSE;
+    }
+    // Written in place or saved through a rename
+    if (inotify_add_watch(inotify_fd, source_dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        printf("ERROR: shader_watcher_create - Failed to watch %s.\n", source_dir);
+        close(inotify_fd);
+        return BC_FALSE;
+    }
+
+    state = new shader_watcher_state();
+    strcpy(state->source_dir, source_dir);
+    strcpy(state->output_dir, output_dir);
+    state->inotify_fd = inotify_fd;
+    state->rebuilt_count = 0;
+    state->is_running.store(true, std::memory_order_relaxed);
+    state->thread = std::thread(watcher_main);
+
+    printf("Watching the shaders of %s.\n", source_dir);
+    return BC_TRUE;
+}
+
+void shader_watcher_destroy()
+{
+    if (!state)
+        return;
+
+    state->is_running.store(false, std::memory_order_relaxed);
+    state->thread.join();
+    close(state->inotify_fd);
+
+    delete state;
+    state = NULL;
+}
+
+u32 shader_watcher_poll(char (*out_paths)[SHADER_WATCHER_MAX_PATH], u32 capacity)
+{
+    if (!state)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    u32 count = state->rebuilt_count < capacity ? state->rebuilt_count : capacity;
+    for (u32 i = 0; i < count; ++i)
+        strcpy(out_paths[i], state->rebuilt[i]);
+    // Keep the order of the rest
+    memmove(state->rebuilt, state->rebuilt + count, sizeof(state->rebuilt[0]) * (state->rebuilt_count - count));
+    state->rebuilt_count -= count;
+    return count;
+}
+
+#else
+
+b8 shader_watcher_create(const char *source_dir, const char *output_dir)
+{
+    printf("WARN: shader_watcher_create - Shader hot reload requires inotify (Linux).\n");
+    return BC_FALSE;
+}
+
+void shader_watcher_destroy()
+{
+}
+
+u32 shader_watcher_poll(char (*out_paths)[SHADER_WATCHER_MAX_PATH], u32 capacity)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef VULKAN_NOTES_1704712958_SHADER_WATCHER_H
+#define VULKAN_NOTES_1704712958_SHADER_WATCHER_H
+
+#include "defines.h"
+
+/*
+Development tool: watches a directory of GLSL sources (<name>.<stage>.glsl, as APPEND_GLSL_TO_TARGET expects
+them) and recompiles the ones written to into <output_dir>/<name>.<stage>.spv by running glslc on a thread of its
+own. The SPIR-V is written to a temporary file first and renamed over the previous one, so readers never see a
+partial file, and a source which fails to compile leaves the previous SPIR-V in place.
+
+The paths of the rebuilt SPIR-V files are taken with shader_watcher_poll, i.e. once per frame, to rebuild the
+pipelines using them. Linux only (inotify); elsewhere shader_watcher_create fails.
+*/
+
+#define SHADER_WATCHER_MAX_PATH 256
+
+/**
+ * Starts watching.
+ * @param source_dir The directory of the GLSL sources.
+ * @param output_dir The directory the SPIR-V files are loaded from.
+ * @returns True if started successfully; otherwise false.
+ */
+b8 shader_watcher_create(const char *source_dir, const char *output_dir);
+
+/**
+ * Stops watching and joins the thread, after the compilation in progress if any.
+ */
+void shader_watcher_destroy();
+
+/**
+ * Takes the SPIR-V files rebuilt since the previous call.
+ * @param out_paths The array the paths are written into, <output_dir>/<name>.<stage>.spv.
+ * @param capacity The number of paths out_paths can hold.
+ * @returns The number of paths written. The rest are taken by the next call.
+ */
+u32 shader_watcher_poll(char (*out_paths)[SHADER_WATCHER_MAX_PATH], u32 capacity);
+
+#endif
@@ -0,0 +1,337 @@
+#include "vulkan_bindless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const VkDescriptorType descriptor_types[VULKAN_BINDLESS_TYPE_COUNT] = {
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLER};
+
+// Left to the other sets of the pipelines (i.e. the uniform ring) and to the colour attachments, which count
+// against maxPerStageResources as well
+#define BINDLESS_RESERVED_STAGE_RESOURCES 16
+
+static u32 min_u32(u32 a, u32 b)
+{
+    return a < b ? a : b;
+}
+
+// The descriptor at index of an array, as a write into set
+static void fill_write(const vulkan_bindless *bindless, VkDescriptorSet set, u32 type, u32 index, VkWriteDescriptorSet *out_write)
+{
+    const vulkan_bindless_array *array = &bindless->arrays[type];
+    memset(out_write, 0, sizeof(VkWriteDescriptorSet));
+    out_write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    out_write->dstSet = set;
+    out_write->dstBinding = type;
+    out_write->dstArrayElement = index;
+    out_write->descriptorCount = 1;
+    out_write->descriptorType = descriptor_types[type];
+    if (type == VULKAN_BINDLESS_STORAGE_BUFFER)
+        out_write->pBufferInfo = &array->buffers[index];
+    else
+        out_write->pImageInfo = &array->images[index];
+}
+
+// Writes every descriptor in use into set
+static void write_all(vulkan_context *context, const vulkan_bindless *bindless, VkDescriptorSet set)
+{
+    u32 write_count = 0;
+    for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+        write_count += bindless->arrays[type].high_water;
+    if (!write_count)
+        return;
+
+    VkWriteDescriptorSet *writes = (VkWriteDescriptorSet *)(malloc(sizeof(VkWriteDescriptorSet) * write_count));
+    write_count = 0;
+    for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+    {
+        const vulkan_bindless_array *array = &bindless->arrays[type];
+        for (u32 i = 0; i < array->high_water; ++i)
+        {
+            if (array->used[i])
+                fill_write(bindless, set, type, i, &writes[write_count++]);
+        }
+    }
+    vkUpdateDescriptorSets(context->device.logical_device, write_count, writes, 0, NULL);
+    free(writes);
+}
+
+b8 vulkan_bindless_create(vulkan_context *context, u32 frame_count, vulkan_bindless *out_bindless)
+{
+    memset(out_bindless, 0, sizeof(vulkan_bindless));
+
+    const VkPhysicalDeviceVulkan12Features *features12 = &context->device.features12;
+    // The shaders index the arrays with push constants, i.e. dynamically uniform indices
+    const VkPhysicalDeviceFeatures *features = &context->device.features;
+    if (!features12->descriptorBindingPartiallyBound || !features12->runtimeDescriptorArray ||
+        !features->shaderStorageBufferArrayDynamicIndexing || !features->shaderSampledImageArrayDynamicIndexing)
+    {
+        printf("ERROR: vulkan_bindless_create - Descriptor indexing (partially bound runtime arrays) is not supported.\n");
+        return BC_FALSE;
+    }
+    out_bindless->update_after_bind = features12->descriptorBindingStorageBufferUpdateAfterBind &&
+                                      features12->descriptorBindingSampledImageUpdateAfterBind &&
+                                      features12->descriptorBindingUpdateUnusedWhilePending;
+    out_bindless->set_count = out_bindless->update_after_bind ? 1 : frame_count;
+
+    // The arrays are visible to every stage, so each is bound by the per stage and the per set limits of its type,
+    // and together by the resources of a stage. The layout of an update after bind pool has limits of its own.
+    const VkPhysicalDeviceLimits *limits = &context->device.properties.limits;
+    const VkPhysicalDeviceVulkan12Properties *properties12 = &context->device.properties12;
+    u32 type_limits[VULKAN_BINDLESS_TYPE_COUNT];
+    u32 stage_resource_limit;
+    if (out_bindless->update_after_bind)
+    {
+        type_limits[VULKAN_BINDLESS_STORAGE_BUFFER] = min_u32(properties12->maxPerStageDescriptorUpdateAfterBindStorageBuffers, properties12->maxDescriptorSetUpdateAfterBindStorageBuffers);
+        type_limits[VULKAN_BINDLESS_SAMPLED_IMAGE] = min_u32(properties12->maxPerStageDescriptorUpdateAfterBindSampledImages, properties12->maxDescriptorSetUpdateAfterBindSampledImages);
+        type_limits[VULKAN_BINDLESS_SAMPLER] = min_u32(properties12->maxPerStageDescriptorUpdateAfterBindSamplers, properties12->maxDescriptorSetUpdateAfterBindSamplers);
+        stage_resource_limit = properties12->maxPerStageUpdateAfterBindResources;
+    }
+    else
+    {
+        type_limits[VULKAN_BINDLESS_STORAGE_BUFFER] = min_u32(limits->maxPerStageDescriptorStorageBuffers, limits->maxDescriptorSetStorageBuffers);
+        type_limits[VULKAN_BINDLESS_SAMPLED_IMAGE] = min_u32(limits->maxPerStageDescriptorSampledImages, limits->maxDescriptorSetSampledImages);
+        type_limits[VULKAN_BINDLESS_SAMPLER] = min_u32(limits->maxPerStageDescriptorSamplers, limits->maxDescriptorSetSamplers);
+        stage_resource_limit = limits->maxPerStageResources;
+    }
+    stage_resource_limit = stage_resource_limit > BINDLESS_RESERVED_STAGE_RESOURCES ? stage_resource_limit - BINDLESS_RESERVED_STAGE_RESOURCES : 0;
+
+    u32 capacities[VULKAN_BINDLESS_TYPE_COUNT] = {
+        min_u32(VULKAN_BINDLESS_MAX_STORAGE_BUFFERS, type_limits[VULKAN_BINDLESS_STORAGE_BUFFER]),
+        min_u32(VULKAN_BINDLESS_MAX_SAMPLED_IMAGES, type_limits[VULKAN_BINDLESS_SAMPLED_IMAGE]),
+        min_u32(VULKAN_BINDLESS_MAX_SAMPLERS, type_limits[VULKAN_BINDLESS_SAMPLER])};
+    // Past the shared total the arrays are shrunk in proportion
+    u64 total = (u64)capacities[0] + capacities[1] + capacities[2];
+    if (total > stage_resource_limit)
+    {
+        for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+            capacities[type] = (u32)(capacities[type] * (u64)stage_resource_limit / total);
+        printf("WARN: vulkan_bindless_create - The descriptor arrays are limited to %u descriptors per stage.\n", stage_resource_limit);
+    }
+
+    VkDescriptorSetLayoutBinding bindings[VULKAN_BINDLESS_TYPE_COUNT] = {};
+    VkDescriptorBindingFlags binding_flags[VULKAN_BINDLESS_TYPE_COUNT];
+    VkDescriptorPoolSize pool_sizes[VULKAN_BINDLESS_TYPE_COUNT];
+    for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+    {
+        bindings[type].binding = type;
+        bindings[type].descriptorType = descriptor_types[type];
+        bindings[type].descriptorCount = capacities[type];
+        bindings[type].stageFlags = VK_SHADER_STAGE_ALL;
+
+        binding_flags[type] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        if (out_bindless->update_after_bind)
+            binding_flags[type] |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        pool_sizes[type].type = descriptor_types[type];
+        pool_sizes[type].descriptorCount = capacities[type] * out_bindless->set_count;
+
+        vulkan_bindless_array *array = &out_bindless->arrays[type];
+        array->capacity = capacities[type];
+        if (type == VULKAN_BINDLESS_STORAGE_BUFFER)
+            array->buffers = (VkDescriptorBufferInfo *)(malloc(sizeof(VkDescriptorBufferInfo) * array->capacity));
+        else
+            array->images = (VkDescriptorImageInfo *)(malloc(sizeof(VkDescriptorImageInfo) * array->capacity));
+        array->used = (b8 *)(calloc(array->capacity, sizeof(b8)));
+        array->free_indices = (u32 *)(malloc(sizeof(u32) * array->capacity));
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {};
+    binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_create_info.bindingCount = VULKAN_BINDLESS_TYPE_COUNT;
+    binding_flags_create_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.pNext = &binding_flags_create_info;
+    layout_create_info.flags = out_bindless->update_after_bind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
+    layout_create_info.bindingCount = VULKAN_BINDLESS_TYPE_COUNT;
+    layout_create_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(context->device.logical_device, &layout_create_info, context->allocator, &out_bindless->set_layout) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_bindless_create - Failed to create descriptor set layout.\n");
+        return BC_FALSE;
+    }
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.flags = out_bindless->update_after_bind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    pool_create_info.maxSets = out_bindless->set_count;
+    pool_create_info.poolSizeCount = VULKAN_BINDLESS_TYPE_COUNT;
+    pool_create_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(context->device.logical_device, &pool_create_info, context->allocator, &out_bindless->descriptor_pool) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_bindless_create - Failed to create descriptor pool.\n");
+        return BC_FALSE;
+    }
+
+    for (u32 i = 0; i < out_bindless->set_count; ++i)
+    {
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = out_bindless->descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &out_bindless->set_layout;
+        if (vkAllocateDescriptorSets(context->device.logical_device, &allocate_info, &out_bindless->sets[i]) != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_bindless_create - Failed to allocate descriptor set.\n");
+            return BC_FALSE;
+        }
+    }
+
+    return BC_TRUE;
+}
+
+void vulkan_bindless_destroy(vulkan_context *context, vulkan_bindless *bindless)
+{
+    // Frees the sets as well
+    if (bindless->descriptor_pool)
+        vkDestroyDescriptorPool(context->device.logical_device, bindless->descriptor_pool, context->allocator);
+    if (bindless->set_layout)
+        vkDestroyDescriptorSetLayout(context->device.logical_device, bindless->set_layout, context->allocator);
+
+    for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+    {
+        vulkan_bindless_array *array = &bindless->arrays[type];
+        free(array->buffers);
+        free(array->images);
+        free(array->used);
+        free(array->free_indices);
+        free(array->releases);
+    }
+
+    memset(bindless, 0, sizeof(vulkan_bindless));
+}
+
+// Takes a free index of the array, with its descriptor written by the caller
+static u32 add_descriptor(vulkan_context *context, vulkan_bindless *bindless, u32 type, u32 index)
+{
+    vulkan_bindless_array *array = &bindless->arrays[type];
+    array->used[index] = BC_TRUE;
+
+    // Not used by any frame in flight: the index was free. Without update after bind the copy of the current frame
+    // was already brought up to date when the frame began: while it is not bound yet, the descriptor is written into
+    // it as well, so that it can be used from this frame on. Once bound (or submitted) it must not be written, the
+    // descriptor is then only used from the next frame on. The other copies get it when their frame begins.
+    u32 set = bindless->update_after_bind ? 0 : bindless->current_set;
+    b8 set_up_to_date = bindless->set_generations[set] == bindless->generation;
+    bindless->generation++;
+    if (!bindless->update_after_bind && !bindless->current_set_open)
+        return index;
+
+    VkWriteDescriptorSet write;
+    fill_write(bindless, bindless->sets[set], type, index, &write);
+    vkUpdateDescriptorSets(context->device.logical_device, 1, &write, 0, NULL);
+    if (set_up_to_date)
+        bindless->set_generations[set] = bindless->generation;
+    return index;
+}
+
+static u32 take_index(vulkan_bindless_array *array)
+{
+    if (array->free_count)
+        return array->free_indices[--array->free_count];
+    if (array->high_water < array->capacity)
+        return array->high_water++;
+
+    printf("WARN: vulkan_bindless - A descriptor array is full (%u descriptors).\n", array->capacity);
+    return VULKAN_BINDLESS_INVALID_INDEX;
+}
+
+u32 vulkan_bindless_add_buffer(vulkan_context *context, vulkan_bindless *bindless, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    vulkan_bindless_array *array = &bindless->arrays[VULKAN_BINDLESS_STORAGE_BUFFER];
+    u32 index = take_index(array);
+    if (index == VULKAN_BINDLESS_INVALID_INDEX)
+        return index;
+
+    array->buffers[index].buffer = buffer;
+    array->buffers[index].offset = offset;
+    array->buffers[index].range = range;
+    return add_descriptor(context, bindless, VULKAN_BINDLESS_STORAGE_BUFFER, index);
+}
+
+u32 vulkan_bindless_add_image(vulkan_context *context, vulkan_bindless *bindless, VkImageView view, VkImageLayout layout)
+{
+    vulkan_bindless_array *array = &bindless->arrays[VULKAN_BINDLESS_SAMPLED_IMAGE];
+    u32 index = take_index(array);
+    if (index == VULKAN_BINDLESS_INVALID_INDEX)
+        return index;
+
+    array->images[index].sampler = VK_NULL_HANDLE;
+    array->images[index].imageView = view;
+    array->images[index].imageLayout = layout;
+    return add_descriptor(context, bindless, VULKAN_BINDLESS_SAMPLED_IMAGE, index);
+}
+
+u32 vulkan_bindless_add_sampler(vulkan_context *context, vulkan_bindless *bindless, VkSampler sampler)
+{
+    vulkan_bindless_array *array = &bindless->arrays[VULKAN_BINDLESS_SAMPLER];
+    u32 index = take_index(array);
+    if (index == VULKAN_BINDLESS_INVALID_INDEX)
+        return index;
+
+    array->images[index].sampler = sampler;
+    array->images[index].imageView = VK_NULL_HANDLE;
+    array->images[index].imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return add_descriptor(context, bindless, VULKAN_BINDLESS_SAMPLER, index);
+}
+
+void vulkan_bindless_remove(vulkan_bindless *bindless, vulkan_bindless_type type, u32 index, u64 retire_value)
+{
+    vulkan_bindless_array *array = &bindless->arrays[type];
+    if (index >= array->high_water || !array->used[index])
+        return;
+
+    // The descriptor stays in the set(s) until the index is reused, unused
+    array->used[index] = BC_FALSE;
+    if (array->release_count == array->release_capacity)
+    {
+        array->release_capacity = array->release_capacity ? array->release_capacity * 2 : 16;
+        array->releases = (vulkan_bindless_release *)realloc(array->releases, sizeof(vulkan_bindless_release) * array->release_capacity);
+    }
+    array->releases[array->release_count].index = index;
+    array->releases[array->release_count].retire_value = retire_value;
+    array->release_count++;
+}
+
+void vulkan_bindless_begin_frame(vulkan_context *context, vulkan_bindless *bindless, u32 frame_slot, u64 completed_frame_count)
+{
+    for (u32 type = 0; type < VULKAN_BINDLESS_TYPE_COUNT; ++type)
+    {
+        // Releases are in retire order, so the completed ones are at the front
+        vulkan_bindless_array *array = &bindless->arrays[type];
+        u32 released = 0;
+        while (released < array->release_count && array->releases[released].retire_value <= completed_frame_count)
+            array->free_indices[array->free_count++] = array->releases[released++].index;
+
+        if (released)
+        {
+            array->release_count -= released;
+            memmove(array->releases, array->releases + released, sizeof(vulkan_bindless_release) * array->release_count);
+        }
+    }
+
+    if (bindless->update_after_bind)
+        return;
+
+    // The GPU is done with the copy of this frame slot
+    bindless->current_set = frame_slot;
+    bindless->current_set_open = BC_TRUE;
+    if (bindless->set_generations[frame_slot] != bindless->generation)
+    {
+        write_all(context, bindless, bindless->sets[frame_slot]);
+        bindless->set_generations[frame_slot] = bindless->generation;
+    }
+}
+
+void vulkan_bindless_close_frame(vulkan_bindless *bindless)
+{
+    bindless->current_set_open = BC_FALSE;
+}
+
+void vulkan_bindless_bind(const vulkan_bindless *bindless, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout)
+{
+    vkCmdBindDescriptorSets(command_buffer, bind_point, layout, 0, 1, &bindless->sets[bindless->current_set], 0, NULL);
+}
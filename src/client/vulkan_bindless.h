@@ -0,0 +1,106 @@
+#ifndef VULKAN_NOTES_1704371250_VULKAN_BINDLESS_H
+#define VULKAN_NOTES_1704371250_VULKAN_BINDLESS_H
+
+#include "vulkan_types.h"
+
+/*
+A single global descriptor set with an array per descriptor type (VK_EXT_descriptor_indexing, core in Vulkan 1.2):
+    binding 0: storage buffers
+    binding 1: sampled images
+    binding 2: samplers
+Resources are added once, get an index in their array, and shaders pick them with that index, passed through
+push constants or instance data. The set is bound once per command buffer whatever the draws use, so draws of
+different materials don't need descriptor binds in between and can share the same indirect calls.
+
+The arrays are partially bound: the unused elements are never written. With update after bind the descriptors
+are written into the set while frames in flight use it, which is valid since only free elements are written.
+Without it each frame in flight has its own copy of the set, brought up to date when the frame begins. The copy of
+the current frame stays open from vulkan_bindless_begin_frame to vulkan_bindless_close_frame, right before it is
+first bound: descriptors added meanwhile are written into it as well and can be used by the frame. Descriptors added
+once it is closed (while it is bound, or submitted and pending) are not written into it, they are used from the
+next frame on.
+Removed indices are reused once the frames which may still use them have completed.
+*/
+
+// Returned when an array is full
+#define VULKAN_BINDLESS_INVALID_INDEX 0xFFFFFFFFu
+
+// Array sizes, lowered to the descriptor limits of the device (see vulkan_bindless_create)
+#define VULKAN_BINDLESS_MAX_STORAGE_BUFFERS 1024
+#define VULKAN_BINDLESS_MAX_SAMPLED_IMAGES 4096
+#define VULKAN_BINDLESS_MAX_SAMPLERS 64
+
+/**
+ * Creates the layout and the descriptor set(s). Requires descriptorBindingPartiallyBound, runtimeDescriptorArray,
+ * shaderStorageBufferArrayDynamicIndexing and shaderSampledImageArrayDynamicIndexing.
+ * @param context A pointer to the vulkan context.
+ * @param frame_count The number of frames in flight.
+ * @param out_bindless A pointer to the global set to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_bindless_create(vulkan_context *context, u32 frame_count, vulkan_bindless *out_bindless);
+
+/**
+ * Destroys the descriptor set(s) and the layout. The GPU should be done with them.
+ */
+void vulkan_bindless_destroy(vulkan_context *context, vulkan_bindless *bindless);
+
+/**
+ * Adds a storage buffer to the global set.
+ * @param context A pointer to the vulkan context.
+ * @param bindless A pointer to the global set.
+ * @param buffer The buffer, created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+ * @param offset The offset of the range in bytes.
+ * @param range The size of the range in bytes or VK_WHOLE_SIZE.
+ * @returns The index of the buffer in the storage buffer array or VULKAN_BINDLESS_INVALID_INDEX if it is full.
+ */
+u32 vulkan_bindless_add_buffer(vulkan_context *context, vulkan_bindless *bindless, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+/**
+ * Adds a sampled image to the global set.
+ * @param view The image view.
+ * @param layout The layout of the image whenever the shaders sample it.
+ * @returns The index of the image in the sampled image array or VULKAN_BINDLESS_INVALID_INDEX if it is full.
+ */
+u32 vulkan_bindless_add_image(vulkan_context *context, vulkan_bindless *bindless, VkImageView view, VkImageLayout layout);
+
+/**
+ * Adds a sampler to the global set.
+ * @returns The index of the sampler in the sampler array or VULKAN_BINDLESS_INVALID_INDEX if it is full.
+ */
+u32 vulkan_bindless_add_sampler(vulkan_context *context, vulkan_bindless *bindless, VkSampler sampler);
+
+/**
+ * Removes a descriptor from the global set. The shaders must not use its index from the next frame on.
+ * @param bindless A pointer to the global set.
+ * @param type The array of the descriptor.
+ * @param index The index returned when it was added.
+ * @param retire_value The number of frames which have to complete before the index can be reused.
+ */
+void vulkan_bindless_remove(vulkan_bindless *bindless, vulkan_bindless_type type, u32 index, u64 retire_value);
+
+/**
+ * Selects the set of the frame slot and brings it up to date, and frees the indices of the completed frames.
+ * @param context A pointer to the vulkan context.
+ * @param bindless A pointer to the global set.
+ * @param frame_slot The index of the frame in flight. The GPU should be done with its previous use.
+ * @param completed_frame_count The number of frames known to be completed on the GPU.
+ */
+void vulkan_bindless_begin_frame(vulkan_context *context, vulkan_bindless *bindless, u32 frame_slot, u64 completed_frame_count);
+
+/**
+ * Closes the copy of the current frame to the descriptors added from now on, which are used from the next frame on.
+ * Should be called on the thread adding descriptors, before the set is first bound by the frame.
+ */
+void vulkan_bindless_close_frame(vulkan_bindless *bindless);
+
+/**
+ * Binds the set of the current frame as set 0. The frame should be closed (see vulkan_bindless_close_frame). Can be called from any thread.
+ * @param bindless A pointer to the global set.
+ * @param command_buffer The command buffer.
+ * @param bind_point The pipeline bind point.
+ * @param layout A pipeline layout created with the layout of the global set as set 0.
+ */
+void vulkan_bindless_bind(const vulkan_bindless *bindless, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout);
+
+#endif
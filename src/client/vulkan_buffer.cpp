@@ -0,0 +1,73 @@
+#include "vulkan_buffer.h"
+#include "vulkan_memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Graphics, present, transfer and compute
+#define VULKAN_MAX_SHARED_QUEUE_FAMILIES 4
+
+b8 vulkan_buffer_create(vulkan_context *context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, vulkan_buffer *out_buffer)
+{
+    return vulkan_buffer_create_shared(context, size, usage, memory_flags, 0, NULL, out_buffer);
+}
+
+b8 vulkan_buffer_create_shared(
+    vulkan_context *context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags,
+    u32 queue_family_count, const u32 *queue_families, vulkan_buffer *out_buffer)
+{
+    memset(out_buffer, 0, sizeof(vulkan_buffer));
+    out_buffer->size = size;
+    out_buffer->usage = usage;
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = size;
+    buffer_create_info.usage = usage;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // The families of a concurrent buffer have to be unique
+    u32 unique_families[VULKAN_MAX_SHARED_QUEUE_FAMILIES];
+    u32 unique_count = 0;
+    for (u32 i = 0; i < queue_family_count && unique_count < VULKAN_MAX_SHARED_QUEUE_FAMILIES; ++i)
+    {
+        b8 seen = BC_FALSE;
+        for (u32 j = 0; j < unique_count; ++j)
+            seen |= unique_families[j] == queue_families[i];
+        if (!seen)
+            unique_families[unique_count++] = queue_families[i];
+    }
+    if (unique_count > 1)
+    {
+        buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_create_info.queueFamilyIndexCount = unique_count;
+        buffer_create_info.pQueueFamilyIndices = unique_families;
+    }
+
+    VkResult result = vkCreateBuffer(context->device.logical_device, &buffer_create_info, context->allocator, &out_buffer->handle);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_buffer_create - Failed to create buffer.\n");
+        return BC_FALSE;
+    }
+
+    if (!vulkan_memory_allocate_buffer(context, &context->memory, out_buffer->handle, memory_flags, &out_buffer->allocation))
+    {
+        printf("ERROR: vulkan_buffer_create - Failed to allocate buffer memory.\n");
+        vulkan_buffer_destroy(context, out_buffer);
+        return BC_FALSE;
+    }
+    // Host visible blocks are persistently mapped
+    out_buffer->mapped = out_buffer->allocation.mapped;
+
+    return BC_TRUE;
+}
+
+void vulkan_buffer_destroy(vulkan_context *context, vulkan_buffer *buffer)
+{
+    if (buffer->handle)
+        vkDestroyBuffer(context->device.logical_device, buffer->handle, context->allocator);
+    vulkan_memory_free(context, &context->memory, &buffer->allocation);
+
+    memset(buffer, 0, sizeof(vulkan_buffer));
+}
@@ -0,0 +1,34 @@
+#ifndef VULKAN_NOTES_1704028470_VULKAN_BUFFER_H
+#define VULKAN_NOTES_1704028470_VULKAN_BUFFER_H
+
+#include "vulkan_types.h"
+
+/**
+ * Creates a buffer with memory from the context's memory allocator. Host visible buffers are persistently mapped.
+ * @param context A pointer to the vulkan context.
+ * @param size The size of the buffer in bytes.
+ * @param usage The usage flags of the buffer.
+ * @param memory_flags The required memory properties, i.e. VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT.
+ * @param out_buffer A pointer to the buffer to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_buffer_create(vulkan_context *context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, vulkan_buffer *out_buffer);
+
+/**
+ * Creates a buffer which can be used by several queue families at once (VK_SHARING_MODE_CONCURRENT), without ownership transfers.
+ * Same as vulkan_buffer_create if the given families are all the same.
+ * @param queue_family_count The number of queue families in queue_families.
+ * @param queue_families The queue families which use the buffer.
+ */
+b8 vulkan_buffer_create_shared(
+    vulkan_context *context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags,
+    u32 queue_family_count, const u32 *queue_families, vulkan_buffer *out_buffer);
+
+/**
+ * Destroys the buffer and frees its memory right away. The GPU should be done with it.
+ * @param context A pointer to the vulkan context.
+ * @param buffer A pointer to the buffer to be destroyed.
+ */
+void vulkan_buffer_destroy(vulkan_context *context, vulkan_buffer *buffer);
+
+#endif
@@ -0,0 +1,72 @@
+#include "vulkan_command_pool.h"
+#include "log_assert.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+void vulkan_transient_command_pool_create(vulkan_context *context, u32 queue_family_index, vulkan_transient_command_pool *out_pool)
+{
+    memset(out_pool, 0, sizeof(vulkan_transient_command_pool));
+
+    VkCommandPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_create_info.queueFamilyIndex = queue_family_index;
+    // Short lived buffers which are only ever reset through the pool
+    pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    VkResult result = vkCreateCommandPool(context->device.logical_device, &pool_create_info, context->allocator, &out_pool->handle);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to create transient command pool!\n", "vulkan_transient_command_pool_create::vkCreateCommandPool");
+}
+
+void vulkan_transient_command_pool_destroy(vulkan_context *context, vulkan_transient_command_pool *pool)
+{
+    // Destroying the pool frees its command buffers
+    if (pool->handle)
+        vkDestroyCommandPool(context->device.logical_device, pool->handle, context->allocator);
+
+    for (u32 level = 0; level < 2; ++level)
+        free(pool->buffers[level]);
+
+    memset(pool, 0, sizeof(vulkan_transient_command_pool));
+}
+
+void vulkan_transient_command_pool_reset(vulkan_context *context, vulkan_transient_command_pool *pool)
+{
+    // Nothing recorded since the last reset
+    if (!pool->used[0] && !pool->used[1])
+        return;
+
+    VkResult result = vkResetCommandPool(context->device.logical_device, pool->handle, 0);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to reset transient command pool!\n", "vulkan_transient_command_pool_reset::vkResetCommandPool");
+
+    pool->used[0] = 0;
+    pool->used[1] = 0;
+}
+
+VkCommandBuffer vulkan_transient_command_pool_acquire(vulkan_context *context, vulkan_transient_command_pool *pool, VkCommandBufferLevel level)
+{
+    u32 l = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+
+    if (pool->used[l] == pool->capacity[l])
+    {
+        // Grow geometrically, the buffers allocated so far stay where they are in the pool
+        u32 new_capacity = pool->capacity[l] ? pool->capacity[l] * 2 : 4;
+        pool->buffers[l] = (VkCommandBuffer *)realloc(pool->buffers[l], sizeof(VkCommandBuffer) * new_capacity);
+
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = pool->handle;
+        allocate_info.level = level;
+        allocate_info.commandBufferCount = new_capacity - pool->capacity[l];
+
+        VkResult result = vkAllocateCommandBuffers(context->device.logical_device, &allocate_info, &pool->buffers[l][pool->capacity[l]]);
+        if (result != VK_SUCCESS)
+            ERR_EXIT("Failed to allocate command buffers!\n", "vulkan_transient_command_pool_acquire::vkAllocateCommandBuffers");
+
+        pool->capacity[l] = new_capacity;
+    }
+
+    return pool->buffers[l][pool->used[l]++];
+}
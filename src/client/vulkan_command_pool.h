@@ -0,0 +1,39 @@
+#ifndef VULKAN_NOTES_1703679842_VULKAN_COMMAND_POOL_H
+#define VULKAN_NOTES_1703679842_VULKAN_COMMAND_POOL_H
+
+#include "vulkan_types.h"
+
+/**
+ * Creates a transient command pool.
+ * @param context A pointer to the vulkan context. The logical device should be created.
+ * @param queue_family_index The queue family the command buffers will be submitted to.
+ * @param out_pool A pointer to the pool to be created.
+ */
+void vulkan_transient_command_pool_create(vulkan_context *context, u32 queue_family_index, vulkan_transient_command_pool *out_pool);
+
+/**
+ * Destroys the pool along with all of its command buffers.
+ * @param context A pointer to the vulkan context.
+ * @param pool A pointer to the pool to be destroyed.
+ */
+void vulkan_transient_command_pool_destroy(vulkan_context *context, vulkan_transient_command_pool *pool);
+
+/**
+ * Resets every command buffer of the pool with a single vkResetCommandPool. None of them should be
+ * pending execution, i.e. the fence of the last submission using them should be waited on.
+ * @param context A pointer to the vulkan context.
+ * @param pool A pointer to the pool to be reset.
+ */
+void vulkan_transient_command_pool_reset(vulkan_context *context, vulkan_transient_command_pool *pool);
+
+/**
+ * Hands out the next free command buffer of the pool. Allocates a new one only if all the
+ * buffers allocated so far are in use since the last reset.
+ * @param context A pointer to the vulkan context.
+ * @param pool A pointer to the pool.
+ * @param level VK_COMMAND_BUFFER_LEVEL_PRIMARY or VK_COMMAND_BUFFER_LEVEL_SECONDARY.
+ * @returns A command buffer in the initial state.
+ */
+VkCommandBuffer vulkan_transient_command_pool_acquire(vulkan_context *context, vulkan_transient_command_pool *pool, VkCommandBufferLevel level);
+
+#endif
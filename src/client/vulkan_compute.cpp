@@ -0,0 +1,270 @@
+#include "vulkan_compute.h"
+#include "vulkan_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_deletion_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+b8 vulkan_compute_create(vulkan_context *context, u32 frame_count, b8 use_async_compute, vulkan_compute *out_compute)
+{
+    memset(out_compute, 0, sizeof(vulkan_compute));
+    out_compute->frame_count = frame_count;
+
+    out_compute->async = use_async_compute && context->device.computeQueue;
+    if (!out_compute->async)
+    {
+        // The dispatches are recorded into the frames' command buffers
+        out_compute->queue = context->device.graphicsQueue;
+        out_compute->queue_family_index = (u32)context->device.graphics_queue_index;
+        return BC_TRUE;
+    }
+
+    out_compute->queue = context->device.computeQueue;
+    out_compute->queue_family_index = (u32)context->device.compute_queue_index;
+    for (u32 i = 0; i < frame_count; ++i)
+    {
+        vulkan_compute_frame *frame = &out_compute->frames[i];
+        vulkan_transient_command_pool_create(context, out_compute->queue_family_index, &frame->command_pool);
+
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkResult result = vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &frame->complete_semaphore);
+        if (result != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_compute_create - Failed to create semaphore.\n");
+            return BC_FALSE;
+        }
+    }
+
+    return BC_TRUE;
+}
+
+void vulkan_compute_destroy(vulkan_context *context, vulkan_compute *compute)
+{
+    if (compute->async)
+    {
+        for (u32 i = 0; i < compute->frame_count; ++i)
+        {
+            vulkan_compute_frame *frame = &compute->frames[i];
+            vulkan_transient_command_pool_destroy(context, &frame->command_pool);
+            if (frame->complete_semaphore)
+                vkDestroySemaphore(context->device.logical_device, frame->complete_semaphore, context->allocator);
+        }
+    }
+
+    memset(compute, 0, sizeof(vulkan_compute));
+}
+
+static b8 create_compute_pipeline(vulkan_context *context, VkShaderModule shader, VkPipelineLayout layout, VkPipeline *out_pipeline)
+{
+    VkComputePipelineCreateInfo pipeline_create_info = {};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = shader;
+    pipeline_create_info.stage.pName = "main";
+    pipeline_create_info.layout = layout;
+    pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_create_info.basePipelineIndex = -1;
+
+    return vkCreateComputePipelines(context->device.logical_device, context->pipeline_cache, 1, &pipeline_create_info, context->allocator, out_pipeline) == VK_SUCCESS;
+}
+
+b8 vulkan_compute_pipeline_create(
+    vulkan_context *context, VkShaderModule shader,
+    u32 set_layout_count, const VkDescriptorSetLayout *set_layouts, u32 push_constant_size,
+    vulkan_compute_pipeline *out_pipeline)
+{
+    memset(out_pipeline, 0, sizeof(vulkan_compute_pipeline));
+
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = push_constant_size;
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.setLayoutCount = set_layout_count;
+    layout_create_info.pSetLayouts = set_layouts;
+    layout_create_info.pushConstantRangeCount = push_constant_size ? 1 : 0;
+    layout_create_info.pPushConstantRanges = push_constant_size ? &push_constant_range : NULL;
+
+    VkResult result = vkCreatePipelineLayout(context->device.logical_device, &layout_create_info, context->allocator, &out_pipeline->layout);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_compute_pipeline_create - Failed to create pipeline layout.\n");
+        return BC_FALSE;
+    }
+
+    if (!create_compute_pipeline(context, shader, out_pipeline->layout, &out_pipeline->handle))
+    {
+        printf("ERROR: vulkan_compute_pipeline_create - Failed to create compute pipeline.\n");
+        vulkan_compute_pipeline_destroy(context, out_pipeline);
+        return BC_FALSE;
+    }
+
+    return BC_TRUE;
+}
+
+void vulkan_compute_pipeline_destroy(vulkan_context *context, vulkan_compute_pipeline *pipeline)
+{
+    if (pipeline->handle)
+        vkDestroyPipeline(context->device.logical_device, pipeline->handle, context->allocator);
+    if (pipeline->layout)
+        vkDestroyPipelineLayout(context->device.logical_device, pipeline->layout, context->allocator);
+
+    memset(pipeline, 0, sizeof(vulkan_compute_pipeline));
+}
+
+b8 vulkan_compute_pipeline_reload(vulkan_context *context, VkShaderModule shader, vulkan_compute_pipeline *pipeline, u64 retire_value)
+{
+    VkPipeline reloaded;
+    if (!create_compute_pipeline(context, shader, pipeline->layout, &reloaded))
+    {
+        printf("WARN: vulkan_compute_pipeline_reload - Failed to rebuild the compute pipeline, the previous one is kept.\n");
+        return BC_FALSE;
+    }
+
+    // The previous pipeline may still be used by the frames in flight
+    vulkan_deletion_queue_push(&context->deletion_queue, VULKAN_DELETION_PIPELINE, (u64)pipeline->handle, retire_value);
+    pipeline->handle = reloaded;
+    return BC_TRUE;
+}
+
+b8 vulkan_compute_buffer_create(
+    vulkan_context *context, const vulkan_compute *compute,
+    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, vulkan_buffer *out_buffer)
+{
+    u32 queue_families[2] = {(u32)context->device.graphics_queue_index, compute->queue_family_index};
+    return vulkan_buffer_create_shared(context, size, usage, memory_flags, 2, queue_families, out_buffer);
+}
+
+void vulkan_compute_begin_frame(vulkan_context *context, vulkan_compute *compute, u32 frame_slot)
+{
+    compute->current_frame = frame_slot;
+    compute->command_buffer = VK_NULL_HANDLE;
+    compute->wait_semaphore = VK_NULL_HANDLE;
+    compute->wait_stages = 0;
+    compute->dst_stages = 0;
+    compute->dst_access = 0;
+    compute->graphics_wait_stages = 0;
+
+    // The graphics submission of the slot waited on its dispatches, and it is done
+    if (compute->async)
+        vulkan_transient_command_pool_reset(context, &compute->frames[frame_slot].command_pool);
+}
+
+VkCommandBuffer vulkan_compute_begin(
+    vulkan_context *context, vulkan_compute *compute, VkCommandBuffer graphics_command_buffer,
+    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    compute->dst_stages |= dst_stages;
+    compute->dst_access |= dst_access;
+    if (compute->command_buffer)
+        return compute->command_buffer;
+
+    if (!compute->async)
+    {
+        compute->command_buffer = graphics_command_buffer;
+        return compute->command_buffer;
+    }
+
+    vulkan_compute_frame *frame = &compute->frames[compute->current_frame];
+    compute->command_buffer = vulkan_transient_command_pool_acquire(context, &frame->command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(compute->command_buffer, &begin_info) != VK_SUCCESS)
+        printf("ERROR: vulkan_compute_begin - Failed to begin command buffer.\n");
+
+    return compute->command_buffer;
+}
+
+void vulkan_compute_wait(vulkan_compute *compute, VkSemaphore semaphore, VkPipelineStageFlags stages)
+{
+    if (!compute->async)
+        return;
+
+    compute->wait_semaphore = semaphore;
+    compute->wait_stages = stages;
+}
+
+void vulkan_compute_dispatch(
+    VkCommandBuffer command_buffer, const vulkan_compute_pipeline *pipeline,
+    u32 set_count, const VkDescriptorSet *sets, const void *push_constants, u32 push_constant_size,
+    u32 group_count_x, u32 group_count_y, u32 group_count_z)
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->handle);
+    if (set_count)
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->layout, 0, set_count, sets, 0, NULL);
+    if (push_constants)
+        vkCmdPushConstants(command_buffer, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, push_constant_size, push_constants);
+    vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
+}
+
+b8 vulkan_compute_submit(vulkan_context *context, vulkan_compute *compute, VkCommandBuffer graphics_command_buffer)
+{
+    if (!compute->command_buffer)
+        return BC_TRUE;
+
+    VkCommandBuffer command_buffer = compute->command_buffer;
+    compute->command_buffer = VK_NULL_HANDLE;
+
+    if (!compute->async)
+    {
+        // Same queue, a barrier is enough
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = compute->dst_access;
+        vkCmdPipelineBarrier(
+            graphics_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, compute->dst_stages, 0,
+            1, &barrier, 0, NULL, 0, NULL);
+        return BC_TRUE;
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_compute_submit - Failed to end command buffer.\n");
+        return BC_FALSE;
+    }
+
+    // The semaphore makes the writes visible to the graphics queue at the stages it waits at.
+    // Nothing else waits on the submission: the graphics one does and the frame slot is only reused after it.
+    vulkan_compute_frame *frame = &compute->frames[compute->current_frame];
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    if (compute->wait_semaphore)
+    {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &compute->wait_semaphore;
+        submit_info.pWaitDstStageMask = &compute->wait_stages;
+    }
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &frame->complete_semaphore;
+
+    VkResult result = vkQueueSubmit(compute->queue, 1, &submit_info, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_compute_submit - Failed to submit the dispatches.\n");
+        return BC_FALSE;
+    }
+
+    compute->graphics_wait_stages = compute->dst_stages;
+    return BC_TRUE;
+}
+
+b8 vulkan_compute_take_graphics_wait(vulkan_compute *compute, VkSemaphore *out_semaphore, VkPipelineStageFlags *out_stages)
+{
+    if (!compute->graphics_wait_stages)
+        return BC_FALSE;
+
+    *out_semaphore = compute->frames[compute->current_frame].complete_semaphore;
+    *out_stages = compute->graphics_wait_stages;
+    compute->graphics_wait_stages = 0;
+    return BC_TRUE;
+}
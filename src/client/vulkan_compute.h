@@ -0,0 +1,127 @@
+#ifndef VULKAN_NOTES_1704115273_VULKAN_COMPUTE_H
+#define VULKAN_NOTES_1704115273_VULKAN_COMPUTE_H
+
+#include "vulkan_types.h"
+
+/*
+Compute work of a frame (culling, skinning, ...) is recorded between vulkan_compute_begin and vulkan_compute_submit,
+before the graphics work which consumes it.
+
+With async compute the dispatches go into a command buffer of the compute queue family, which is submitted right away
+and signals the frame's semaphore; the graphics submission of the same frame waits on it at the consuming stages
+(see vulkan_compute_take_graphics_wait). So the dispatches of a frame run while the graphics queue is still busy with
+the previous ones. Without async compute they are recorded into the graphics command buffer of the frame, followed by
+a barrier towards the consuming stages.
+
+Resources written by the dispatches and read by the graphics queue should be created with vulkan_compute_buffer_create
+(concurrent between both families, so they need no ownership transfers). They should also be per frame in flight:
+the dispatches of a frame may run before the graphics work of the previous frame is done.
+*/
+
+/**
+ * Creates the command pools and semaphores of each frame in flight.
+ * @param context A pointer to the vulkan context. The logical device should be created.
+ * @param frame_count The number of frames in flight.
+ * @param use_async_compute Submit the dispatches to the compute queue if the device has one.
+ * @param out_compute A pointer to the compute state to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_compute_create(vulkan_context *context, u32 frame_count, b8 use_async_compute, vulkan_compute *out_compute);
+
+/**
+ * Destroys the command pools and semaphores. The GPU should be done with them.
+ */
+void vulkan_compute_destroy(vulkan_context *context, vulkan_compute *compute);
+
+/**
+ * Creates a compute pipeline through the context's pipeline cache.
+ * @param context A pointer to the vulkan context.
+ * @param shader The compute shader module, with a "main" entry point. Can be destroyed once the pipeline is created.
+ * @param set_layout_count The number of descriptor set layouts.
+ * @param set_layouts The descriptor set layouts of the pipeline layout.
+ * @param push_constant_size The size of the push constants in bytes, 0 if none.
+ * @param out_pipeline A pointer to the pipeline to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_compute_pipeline_create(
+    vulkan_context *context, VkShaderModule shader,
+    u32 set_layout_count, const VkDescriptorSetLayout *set_layouts, u32 push_constant_size,
+    vulkan_compute_pipeline *out_pipeline);
+
+void vulkan_compute_pipeline_destroy(vulkan_context *context, vulkan_compute_pipeline *pipeline);
+
+/**
+ * Rebuilds a compute pipeline with a recompiled shader (hot reload), keeping its layout. Compiled right away, on
+ * the calling thread. The previous pipeline is retired to the deletion queue, and kept if the new one fails.
+ * @param context A pointer to the vulkan context.
+ * @param shader The module of the new shader, with the same interface as the previous one.
+ * @param pipeline A pointer to the pipeline to rebuild. Nothing should be recorded with it yet in the current frame.
+ * @param retire_value The number of frames which have to complete before the previous pipeline can be destroyed.
+ * @returns True if rebuilt; otherwise false.
+ */
+b8 vulkan_compute_pipeline_reload(vulkan_context *context, VkShaderModule shader, vulkan_compute_pipeline *pipeline, u64 retire_value);
+
+/**
+ * Creates a buffer which can be written by the dispatches and read by the graphics queue.
+ * Same parameters as vulkan_buffer_create.
+ */
+b8 vulkan_compute_buffer_create(
+    vulkan_context *context, const vulkan_compute *compute,
+    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_flags, vulkan_buffer *out_buffer);
+
+/**
+ * Resets the command pool of the frame slot. Should be called once the frame slot is free again.
+ * @param frame_slot The index of the frame in flight.
+ */
+void vulkan_compute_begin_frame(vulkan_context *context, vulkan_compute *compute, u32 frame_slot);
+
+/**
+ * Gets the command buffer the dispatches of the current frame are recorded into. Can be called several times per frame.
+ * @param context A pointer to the vulkan context.
+ * @param compute A pointer to the compute state.
+ * @param graphics_command_buffer The command buffer of the frame, outside of a render pass. Used without async compute.
+ * @param dst_stages The graphics stages which read what the dispatches write, i.e. VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT.
+ * @param dst_access The access type of those stages, i.e. VK_ACCESS_INDIRECT_COMMAND_READ_BIT.
+ * @returns A command buffer in the recording state.
+ */
+VkCommandBuffer vulkan_compute_begin(
+    vulkan_context *context, vulkan_compute *compute, VkCommandBuffer graphics_command_buffer,
+    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+/**
+ * Makes the dispatches of the current frame wait on a semaphore signaled by another queue, with async compute.
+ * Without it the dispatches are recorded into the graphics command buffer, which needs no wait.
+ * @param compute A pointer to the compute state.
+ * @param semaphore The binary semaphore, signaled by a submission made before vulkan_compute_submit.
+ * @param stages The stages of the dispatches to wait at.
+ */
+void vulkan_compute_wait(vulkan_compute *compute, VkSemaphore semaphore, VkPipelineStageFlags stages);
+
+/**
+ * Binds the pipeline, descriptor sets and push constants, and records a dispatch.
+ * @param command_buffer The command buffer returned by vulkan_compute_begin.
+ * @param set_count The number of descriptor sets bound from set 0.
+ * @param push_constants The push constants, NULL if none.
+ */
+void vulkan_compute_dispatch(
+    VkCommandBuffer command_buffer, const vulkan_compute_pipeline *pipeline,
+    u32 set_count, const VkDescriptorSet *sets, const void *push_constants, u32 push_constant_size,
+    u32 group_count_x, u32 group_count_y, u32 group_count_z);
+
+/**
+ * Ends the dispatches of the current frame: submits them to the compute queue with async compute, otherwise
+ * records the barrier towards the consuming stages into graphics_command_buffer. Does nothing if nothing was recorded.
+ * @returns True if submitted successfully or there was nothing to submit; otherwise false.
+ */
+b8 vulkan_compute_submit(vulkan_context *context, vulkan_compute *compute, VkCommandBuffer graphics_command_buffer);
+
+/**
+ * Gets the wait the graphics submission of the current frame needs for its dispatches, and clears it.
+ * @param compute A pointer to the compute state.
+ * @param out_semaphore The semaphore signaled by the dispatches.
+ * @param out_stages The stages to wait at.
+ * @returns True if the submission has to wait; otherwise false.
+ */
+b8 vulkan_compute_take_graphics_wait(vulkan_compute *compute, VkSemaphore *out_semaphore, VkPipelineStageFlags *out_stages);
+
+#endif
@@ -0,0 +1,435 @@
+#include "vulkan_culling.h"
+#include "vulkan_buffer.h"
+#include "vulkan_compute.h"
+#include "vulkan_depth_pyramid.h"
+#include "vulkan_indirect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// local_size_x of the culling shaders
+#define CULLING_GROUP_SIZE 64
+// Descriptor bindings of the culling passes, see assets/shaders/cull_instances.comp.glsl.
+// The storage buffers come first, the depth pyramid last.
+#define CULLING_BUFFER_BINDING_COUNT 7
+#define CULLING_PYRAMID_BINDING 7
+#define CULLING_BINDING_COUNT 8
+
+#define MESH_WITHOUT_COMMAND 0xFFFFFFFFu
+
+// Push constants of cull_instances.comp
+typedef struct cull_constants
+{
+    // Inward facing and normalized
+    f32 frustum_planes[6][4];
+    u32 instance_count;
+} cull_constants;
+
+// Occlusion buffer of cull_instances.comp (std430)
+typedef struct cull_occlusion
+{
+    f32 view_projection[16];
+    f32 depth_size[2];
+    u32 level_count;
+    u32 padding;
+} cull_occlusion;
+
+// Push constants of compact_draws.comp
+typedef struct compact_constants
+{
+    u32 first_command;
+    u32 command_count;
+    u32 batch;
+    u32 compact;
+} compact_constants;
+
+// Gribb/Hartmann: the planes are sums and differences of the rows of the matrix, for a clip space depth in [0, w]
+static void extract_frustum_planes(const f32 *m, f32 out_planes[6][4])
+{
+    for (u32 i = 0; i < 4; ++i)
+    {
+        f32 row0 = m[i * 4 + 0], row1 = m[i * 4 + 1], row2 = m[i * 4 + 2], row3 = m[i * 4 + 3];
+        out_planes[0][i] = row3 + row0; // left
+        out_planes[1][i] = row3 - row0; // right
+        out_planes[2][i] = row3 + row1; // top (y points down in Vulkan)
+        out_planes[3][i] = row3 - row1; // bottom
+        out_planes[4][i] = row2;        // far with a reverse-Z projection (near otherwise)
+        out_planes[5][i] = row3 - row2; // near with a reverse-Z projection (far otherwise)
+    }
+
+    for (u32 p = 0; p < 6; ++p)
+    {
+        f32 length = sqrtf(out_planes[p][0] * out_planes[p][0] + out_planes[p][1] * out_planes[p][1] + out_planes[p][2] * out_planes[p][2]);
+        if (length > 0)
+        {
+            for (u32 i = 0; i < 4; ++i)
+                out_planes[p][i] /= length;
+        }
+    }
+}
+
+static b8 create_descriptors(vulkan_context *context, vulkan_culling *culling, const vulkan_indirect_draws *draws)
+{
+    VkDescriptorSetLayoutBinding bindings[CULLING_BINDING_COUNT] = {};
+    VkDescriptorBindingFlags binding_flags[CULLING_BINDING_COUNT] = {};
+    for (u32 i = 0; i < CULLING_BINDING_COUNT; ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    // Only written once there is a pyramid, the shader does not read it before (partially bound is required by
+    // the global set already)
+    bindings[CULLING_PYRAMID_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding_flags[CULLING_PYRAMID_BINDING] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {};
+    binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_create_info.bindingCount = CULLING_BINDING_COUNT;
+    binding_flags_create_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.pNext = &binding_flags_create_info;
+    layout_create_info.bindingCount = CULLING_BINDING_COUNT;
+    layout_create_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(context->device.logical_device, &layout_create_info, context->allocator, &culling->set_layout) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_culling_create - Failed to create descriptor set layout.\n");
+        return BC_FALSE;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[0].descriptorCount = CULLING_BUFFER_BINDING_COUNT * culling->frame_count;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[1].descriptorCount = culling->frame_count;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = culling->frame_count;
+    pool_create_info.poolSizeCount = 2;
+    pool_create_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(context->device.logical_device, &pool_create_info, context->allocator, &culling->descriptor_pool) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_culling_create - Failed to create descriptor pool.\n");
+        return BC_FALSE;
+    }
+
+    for (u32 i = 0; i < culling->frame_count; ++i)
+    {
+        vulkan_culling_frame *frame = &culling->frames[i];
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = culling->descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &culling->set_layout;
+        if (vkAllocateDescriptorSets(context->device.logical_device, &allocate_info, &frame->descriptor_set) != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_culling_create - Failed to allocate descriptor set.\n");
+            return BC_FALSE;
+        }
+
+        // Same order as the bindings of the shaders
+        const vulkan_buffer *buffers[CULLING_BUFFER_BINDING_COUNT] = {
+            &frame->instances, &draws->frames[i].commands, &frame->command_counts,
+            &frame->visible_instances, &draws->frames[i].culled_commands, &draws->frames[i].culled_counts,
+            &frame->occlusion};
+        VkDescriptorBufferInfo buffer_infos[CULLING_BUFFER_BINDING_COUNT];
+        VkWriteDescriptorSet writes[CULLING_BUFFER_BINDING_COUNT] = {};
+        for (u32 b = 0; b < CULLING_BUFFER_BINDING_COUNT; ++b)
+        {
+            buffer_infos[b].buffer = buffers[b]->handle;
+            buffer_infos[b].offset = 0;
+            buffer_infos[b].range = VK_WHOLE_SIZE;
+
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = frame->descriptor_set;
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[b].pBufferInfo = &buffer_infos[b];
+        }
+        vkUpdateDescriptorSets(context->device.logical_device, CULLING_BUFFER_BINDING_COUNT, writes, 0, NULL);
+    }
+
+    return BC_TRUE;
+}
+
+b8 vulkan_culling_create(
+    vulkan_context *context, const vulkan_compute *compute, const vulkan_indirect_draws *draws,
+    u32 frame_count, u32 instance_capacity, VkShaderModule cull_shader, VkShaderModule compact_shader,
+    vulkan_culling *out_culling)
+{
+    memset(out_culling, 0, sizeof(vulkan_culling));
+    out_culling->enabled = draws->gpu_culled;
+    out_culling->frame_count = frame_count;
+    out_culling->instance_capacity = instance_capacity;
+    out_culling->instances = (vulkan_instance_data *)(malloc(sizeof(vulkan_instance_data) * instance_capacity));
+    out_culling->command_capacity = draws->command_capacity;
+    out_culling->command_meshes = (u32 *)(malloc(sizeof(u32) * draws->command_capacity));
+    out_culling->command_instance_counts = (u32 *)(malloc(sizeof(u32) * draws->command_capacity));
+    // The frame slots have not written any instances yet
+    out_culling->generation = 1;
+
+    // Without GPU culling the visible instances are written once by the CPU, like the instances
+    VkMemoryPropertyFlags visible_memory_flags = out_culling->enabled
+                                                     ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                                     : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (u32 i = 0; i < frame_count; ++i)
+    {
+        vulkan_culling_frame *frame = &out_culling->frames[i];
+        if (!vulkan_compute_buffer_create(
+                context, compute, sizeof(vulkan_instance_data) * instance_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->instances) ||
+            !vulkan_compute_buffer_create(
+                context, compute, sizeof(u32) * instance_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                visible_memory_flags, &frame->visible_instances))
+        {
+            printf("ERROR: vulkan_culling_create - Failed to create the instance buffers.\n");
+            return BC_FALSE;
+        }
+        // Only used by the culling passes
+        if (out_culling->enabled &&
+            (!vulkan_compute_buffer_create(
+                 context, compute, sizeof(u32) * draws->command_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->command_counts) ||
+             !vulkan_compute_buffer_create(
+                 context, compute, sizeof(cull_occlusion), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->occlusion)))
+        {
+            printf("ERROR: vulkan_culling_create - Failed to create the command count and occlusion buffers.\n");
+            return BC_FALSE;
+        }
+    }
+
+    if (!out_culling->enabled)
+        return BC_TRUE;
+
+    return create_descriptors(context, out_culling, draws) &&
+           vulkan_compute_pipeline_create(context, cull_shader, 1, &out_culling->set_layout, sizeof(cull_constants), &out_culling->cull_pipeline) &&
+           vulkan_compute_pipeline_create(context, compact_shader, 1, &out_culling->set_layout, sizeof(compact_constants), &out_culling->compact_pipeline);
+}
+
+void vulkan_culling_destroy(vulkan_context *context, vulkan_culling *culling)
+{
+    vulkan_compute_pipeline_destroy(context, &culling->cull_pipeline);
+    vulkan_compute_pipeline_destroy(context, &culling->compact_pipeline);
+    if (culling->descriptor_pool)
+        vkDestroyDescriptorPool(context->device.logical_device, culling->descriptor_pool, context->allocator);
+    if (culling->set_layout)
+        vkDestroyDescriptorSetLayout(context->device.logical_device, culling->set_layout, context->allocator);
+
+    for (u32 i = 0; i < culling->frame_count; ++i)
+    {
+        vulkan_buffer_destroy(context, &culling->frames[i].instances);
+        vulkan_buffer_destroy(context, &culling->frames[i].visible_instances);
+        vulkan_buffer_destroy(context, &culling->frames[i].command_counts);
+        vulkan_buffer_destroy(context, &culling->frames[i].occlusion);
+    }
+    free(culling->instances);
+    free(culling->command_meshes);
+    free(culling->command_instance_counts);
+
+    memset(culling, 0, sizeof(vulkan_culling));
+}
+
+b8 vulkan_culling_set_instances(vulkan_culling *culling, const vulkan_geometry *geometry, const renderer_instance *instances, u32 instance_count)
+{
+    b8 all_set = BC_TRUE;
+    u32 mesh_count = geometry->mesh_count;
+    // Instance count of each mesh, then the next instance slot of its command
+    u32 *mesh_slots = (u32 *)(calloc(mesh_count + 1, sizeof(u32)));
+    u32 *mesh_commands = (u32 *)(malloc(sizeof(u32) * (mesh_count + 1)));
+
+    for (u32 i = 0; i < instance_count; ++i)
+    {
+        if (instances[i].mesh < mesh_count)
+            mesh_slots[instances[i].mesh]++;
+        else
+            all_set = BC_FALSE;
+    }
+
+    // One command per mesh drawn, in mesh order
+    culling->command_count = 0;
+    u32 total = 0;
+    for (u32 mesh = 0; mesh < mesh_count; ++mesh)
+    {
+        u32 count = mesh_slots[mesh];
+        mesh_commands[mesh] = MESH_WITHOUT_COMMAND;
+        if (!count)
+            continue;
+        if (culling->command_count == culling->command_capacity || total + count > culling->instance_capacity)
+        {
+            all_set = BC_FALSE;
+            continue;
+        }
+
+        mesh_commands[mesh] = culling->command_count;
+        culling->command_meshes[culling->command_count] = mesh;
+        culling->command_instance_counts[culling->command_count] = count;
+        culling->command_count++;
+        mesh_slots[mesh] = total;
+        total += count;
+    }
+    culling->instance_count = total;
+
+    for (u32 i = 0; i < instance_count; ++i)
+    {
+        u32 mesh = instances[i].mesh;
+        if (mesh >= mesh_count || mesh_commands[mesh] == MESH_WITHOUT_COMMAND)
+            continue;
+
+        const f32 *mesh_sphere = geometry->meshes[mesh].bounding_sphere;
+        vulkan_instance_data *data = &culling->instances[mesh_slots[mesh]++];
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            data->position[axis] = instances[i].position[axis];
+            data->bounding_sphere[axis] = mesh_sphere[axis] + instances[i].position[axis];
+        }
+        data->bounding_sphere[3] = mesh_sphere[3];
+        data->command = mesh_commands[mesh];
+    }
+
+    free(mesh_slots);
+    free(mesh_commands);
+    culling->generation++;
+
+    if (!all_set)
+        printf("WARN: vulkan_culling_set_instances - Some instances are dropped (unknown mesh or out of capacity).\n");
+    return all_set;
+}
+
+void vulkan_culling_begin_frame(
+    vulkan_culling *culling, vulkan_indirect_draws *draws, const vulkan_geometry *geometry,
+    VkPipeline pipeline, u32 frame_slot)
+{
+    vulkan_culling_frame *frame = &culling->frames[frame_slot];
+    if (frame->generation != culling->generation)
+    {
+        memcpy(frame->instances.mapped, culling->instances, sizeof(vulkan_instance_data) * culling->instance_count);
+        if (!culling->enabled)
+        {
+            u32 *visible_instances = (u32 *)frame->visible_instances.mapped;
+            for (u32 i = 0; i < culling->instance_count; ++i)
+                visible_instances[i] = i;
+        }
+        frame->generation = culling->generation;
+    }
+
+    vulkan_indirect_begin_frame(draws, frame_slot);
+    if (!culling->command_count || !pipeline)
+        return;
+
+    // A single pipeline so far
+    vulkan_indirect_begin_batch(draws, pipeline);
+    u32 first_instance = 0;
+    for (u32 i = 0; i < culling->command_count; ++i)
+    {
+        vulkan_indirect_add_draw(draws, &geometry->meshes[culling->command_meshes[i]], culling->command_instance_counts[i], first_instance);
+        first_instance += culling->command_instance_counts[i];
+    }
+}
+
+// Writes what the occlusion test of the frame slot needs of the pyramid, nothing to test against without one.
+// The slot should be free.
+static void write_occlusion(vulkan_context *context, vulkan_culling_frame *frame, const vulkan_depth_pyramid *pyramid)
+{
+    cull_occlusion *occlusion = (cull_occlusion *)frame->occlusion.mapped;
+    memset(occlusion, 0, sizeof(cull_occlusion));
+    if (!pyramid || !pyramid->built)
+        return;
+
+    if (frame->pyramid_generation != pyramid->generation)
+    {
+        VkDescriptorImageInfo image_info = {};
+        image_info.sampler = pyramid->sampler;
+        image_info.imageView = pyramid->view;
+        image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame->descriptor_set;
+        write.dstBinding = CULLING_PYRAMID_BINDING;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(context->device.logical_device, 1, &write, 0, NULL);
+        frame->pyramid_generation = pyramid->generation;
+    }
+
+    memcpy(occlusion->view_projection, pyramid->view_projection, sizeof(occlusion->view_projection));
+    occlusion->depth_size[0] = (f32)pyramid->depth_width;
+    occlusion->depth_size[1] = (f32)pyramid->depth_height;
+    occlusion->level_count = pyramid->level_count;
+}
+
+void vulkan_culling_record(
+    vulkan_context *context, vulkan_culling *culling, vulkan_compute *compute, const vulkan_indirect_draws *draws,
+    vulkan_depth_pyramid *pyramid, VkCommandBuffer graphics_command_buffer, const f32 *view_projection)
+{
+    if (!culling->enabled || !culling->instance_count || !draws->batch_count)
+        return;
+
+    const vulkan_indirect_frame *indirect_frame = &draws->frames[draws->current_frame];
+    vulkan_culling_frame *frame = &culling->frames[draws->current_frame];
+    write_occlusion(context, frame, pyramid);
+
+    // The culled commands are read by the draws, the visible instances by the vertex shader.
+    // The pyramid is built again after the render pass, once the culling is done reading it.
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    if (pyramid)
+        dst_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkCommandBuffer command_buffer = vulkan_compute_begin(
+        context, compute, graphics_command_buffer, dst_stages,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    // With async compute, the build of the previous frame on the graphics queue
+    VkSemaphore pyramid_built;
+    if (pyramid && vulkan_depth_pyramid_take_wait(pyramid, &pyramid_built))
+        vulkan_compute_wait(compute, pyramid_built, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    // Reset the counters
+    vkCmdFillBuffer(command_buffer, frame->command_counts.handle, 0, sizeof(u32) * culling->command_count, 0);
+    vkCmdFillBuffer(command_buffer, indirect_frame->culled_counts.handle, 0, sizeof(u32) * draws->batch_count, 0);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &barrier, 0, NULL, 0, NULL);
+
+    cull_constants cull = {};
+    extract_frustum_planes(view_projection, cull.frustum_planes);
+    cull.instance_count = culling->instance_count;
+    vulkan_compute_dispatch(
+        command_buffer, &culling->cull_pipeline, 1, &frame->descriptor_set, &cull, sizeof(cull),
+        (culling->instance_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+    // The instance counts of the commands are complete
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &barrier, 0, NULL, 0, NULL);
+
+    for (u32 i = 0; i < draws->batch_count; ++i)
+    {
+        const vulkan_draw_batch *batch = &draws->batches[i];
+        if (!batch->command_count)
+            continue;
+
+        compact_constants compact = {};
+        compact.first_command = batch->first_command;
+        compact.command_count = batch->command_count;
+        compact.batch = i;
+        compact.compact = draws->use_draw_count;
+        vulkan_compute_dispatch(
+            command_buffer, &culling->compact_pipeline, 1, &frame->descriptor_set, &compact, sizeof(compact),
+            (batch->command_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef VULKAN_NOTES_1704288514_VULKAN_CULLING_H
+#define VULKAN_NOTES_1704288514_VULKAN_CULLING_H
+
+#include "vulkan_types.h"
+
+/*
+The instances are kept sorted by mesh, one indirect command per mesh, and written into the instance buffer
+of a frame slot only when they changed since the slot last used them.
+
+With GPU culling, two compute passes run before the render pass of each frame:
+    1. cull_instances: one invocation per instance tests its bounding sphere against the frustum, then the
+       bounding box of the sphere against the depth pyramid of the previous frame (see vulkan_depth_pyramid.h),
+       and appends the visible ones to the instance range of their command with an atomic counter.
+    2. compact_draws: one invocation per command writes the command with its visible instance count into the
+       culled commands, compacted with an atomic counter per batch if the draw counts are read from the GPU
+       (drawIndirectCount), in place otherwise.
+The render pass then draws each batch with a single indirect (count) call, the vertex shader reads the
+instance through visible_instances[gl_InstanceIndex]. Without GPU culling visible_instances is the identity
+and every instance is drawn.
+
+The occlusion test projects the box with the view projection of the previous frame, which the depth in the pyramid
+was drawn with, so the instances should not move. It is skipped until the pyramid is built (first frame, resize)
+and for the boxes crossing the near plane. An instance hidden in the previous frame stays culled until the camera
+moves enough to uncover it in a frame drawn without it, that is the test lags a frame behind.
+*/
+
+/**
+ * Creates the instance buffers of each frame in flight and, with GPU culling, the culling pipelines.
+ * @param context A pointer to the vulkan context.
+ * @param compute A pointer to the compute state the passes are recorded with.
+ * @param draws A pointer to the indirect draws, GPU culling is enabled if they are gpu_culled.
+ * @param frame_count The number of frames in flight.
+ * @param instance_capacity The maximum number of instances.
+ * @param cull_shader The module of cull_instances.comp, unused without GPU culling.
+ * @param compact_shader The module of compact_draws.comp, unused without GPU culling.
+ * @param out_culling A pointer to the culling to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_culling_create(
+    vulkan_context *context, const vulkan_compute *compute, const vulkan_indirect_draws *draws,
+    u32 frame_count, u32 instance_capacity, VkShaderModule cull_shader, VkShaderModule compact_shader,
+    vulkan_culling *out_culling);
+
+/**
+ * Destroys the buffers and pipelines. The GPU should be done with them.
+ */
+void vulkan_culling_destroy(vulkan_context *context, vulkan_culling *culling);
+
+/**
+ * Replaces the instances, taking effect from the next frame.
+ * @param culling A pointer to the culling.
+ * @param geometry The geometry the meshes of the instances belong to.
+ * @param instances The instances.
+ * @param instance_count The number of instances.
+ * @returns True if all instances were set; false if some were dropped (unknown mesh, or out of capacity).
+ */
+b8 vulkan_culling_set_instances(vulkan_culling *culling, const vulkan_geometry *geometry, const renderer_instance *instances, u32 instance_count);
+
+/**
+ * Writes the instances into the buffers of the frame slot if they changed, and the indirect commands of the frame.
+ * @param culling A pointer to the culling.
+ * @param draws A pointer to the indirect draws.
+ * @param geometry The geometry the meshes of the instances belong to.
+ * @param pipeline The graphics pipeline the instances are drawn with. VK_NULL_HANDLE draws nothing.
+ * @param frame_slot The index of the frame in flight. The GPU should be done with its previous use.
+ */
+void vulkan_culling_begin_frame(
+    vulkan_culling *culling, vulkan_indirect_draws *draws, const vulkan_geometry *geometry,
+    VkPipeline pipeline, u32 frame_slot);
+
+/**
+ * Records the culling passes of the frame through the compute state. Does nothing without GPU culling.
+ * @param context A pointer to the vulkan context.
+ * @param culling A pointer to the culling.
+ * @param compute A pointer to the compute state, with its frame begun.
+ * @param draws A pointer to the indirect draws of the frame.
+ * @param pyramid A pointer to the depth pyramid built by the previous frame, NULL without occlusion culling.
+ * @param graphics_command_buffer The command buffer of the frame, outside of a render pass.
+ * @param view_projection The column major matrix the instances are drawn with.
+ */
+void vulkan_culling_record(
+    vulkan_context *context, vulkan_culling *culling, vulkan_compute *compute, const vulkan_indirect_draws *draws,
+    vulkan_depth_pyramid *pyramid, VkCommandBuffer graphics_command_buffer, const f32 *view_projection);
+
+#endif
@@ -0,0 +1,98 @@
+#include "vulkan_deletion_queue.h"
+#include "vulkan_memory.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+static void destroy_resource(vulkan_context *context, const vulkan_deferred_deletion *deletion)
+{
+    VkDevice device = context->device.logical_device;
+    switch (deletion->type)
+    {
+    case VULKAN_DELETION_IMAGE:
+        vkDestroyImage(device, (VkImage)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_IMAGE_VIEW:
+        vkDestroyImageView(device, (VkImageView)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_FRAMEBUFFER:
+        vkDestroyFramebuffer(device, (VkFramebuffer)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_DEVICE_MEMORY:
+        vkFreeMemory(device, (VkDeviceMemory)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_SWAPCHAIN:
+        vkDestroySwapchainKHR(device, (VkSwapchainKHR)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_PIPELINE:
+        vkDestroyPipeline(device, (VkPipeline)deletion->handle, context->allocator);
+        break;
+    case VULKAN_DELETION_ALLOCATION:
+    {
+        vulkan_allocation allocation = deletion->allocation;
+        vulkan_memory_free(context, &context->memory, &allocation);
+        break;
+    }
+    }
+}
+
+static vulkan_deferred_deletion *push_entry(vulkan_deletion_queue *queue)
+{
+    if (queue->count == queue->capacity)
+    {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : 16;
+        queue->entries = (vulkan_deferred_deletion *)realloc(queue->entries, sizeof(vulkan_deferred_deletion) * queue->capacity);
+    }
+
+    vulkan_deferred_deletion *deletion = &queue->entries[queue->count++];
+    memset(deletion, 0, sizeof(vulkan_deferred_deletion));
+    return deletion;
+}
+
+void vulkan_deletion_queue_push(vulkan_deletion_queue *queue, vulkan_deletion_type type, u64 handle, u64 retire_value)
+{
+    if (!handle)
+        return;
+
+    vulkan_deferred_deletion *deletion = push_entry(queue);
+    deletion->type = type;
+    deletion->handle = handle;
+    deletion->retire_value = retire_value;
+}
+
+void vulkan_deletion_queue_push_allocation(vulkan_deletion_queue *queue, const vulkan_allocation *allocation, u64 retire_value)
+{
+    if (!allocation->memory)
+        return;
+
+    vulkan_deferred_deletion *deletion = push_entry(queue);
+    deletion->type = VULKAN_DELETION_ALLOCATION;
+    deletion->allocation = *allocation;
+    deletion->retire_value = retire_value;
+}
+
+void vulkan_deletion_queue_flush(vulkan_context *context, vulkan_deletion_queue *queue, u64 completed_value)
+{
+    // Entries are in retire order, so the ones to destroy are at the front
+    u32 destroyed = 0;
+    while (destroyed < queue->count && queue->entries[destroyed].retire_value <= completed_value)
+    {
+        destroy_resource(context, &queue->entries[destroyed]);
+        ++destroyed;
+    }
+
+    if (destroyed)
+    {
+        queue->count -= destroyed;
+        memmove(queue->entries, queue->entries + destroyed, sizeof(vulkan_deferred_deletion) * queue->count);
+    }
+}
+
+void vulkan_deletion_queue_destroy(vulkan_context *context, vulkan_deletion_queue *queue)
+{
+    for (u32 i = 0; i < queue->count; ++i)
+        destroy_resource(context, &queue->entries[i]);
+
+    free(queue->entries);
+    memset(queue, 0, sizeof(vulkan_deletion_queue));
+}
@@ -0,0 +1,47 @@
+#ifndef VULKAN_NOTES_1703854460_VULKAN_DELETION_QUEUE_H
+#define VULKAN_NOTES_1703854460_VULKAN_DELETION_QUEUE_H
+
+#include "vulkan_types.h"
+
+/*
+Resources which may still be used by frames in flight are pushed to the queue instead of being destroyed,
+together with a retire value: the number of frames submitted at the time they were retired.
+Every frame which could have used them has a lower frame number, so they are destroyed once that many
+frames have completed on the GPU (the graphics timeline has reached the value, or the fences of those frames
+have signaled). Nothing waits for the device to be idle.
+*/
+
+/**
+ * Pushes a resource to be destroyed once retire_value frames have completed.
+ * Retire values should be pushed in increasing order.
+ * @param queue A pointer to the deletion queue.
+ * @param type The type of the handle.
+ * @param handle The handle (any non-dispatchable Vulkan handle fits in 64 bits).
+ * @param retire_value The number of frames which have to complete before the resource can be destroyed.
+ */
+void vulkan_deletion_queue_push(vulkan_deletion_queue *queue, vulkan_deletion_type type, u64 handle, u64 retire_value);
+
+/**
+ * Pushes memory of the context's memory allocator to be freed once retire_value frames have completed.
+ * @param queue A pointer to the deletion queue.
+ * @param allocation The allocation, copied into the queue.
+ * @param retire_value The number of frames which have to complete before the memory can be freed.
+ */
+void vulkan_deletion_queue_push_allocation(vulkan_deletion_queue *queue, const vulkan_allocation *allocation, u64 retire_value);
+
+/**
+ * Destroys the resources retired at or before completed_value.
+ * @param context A pointer to the vulkan context.
+ * @param queue A pointer to the deletion queue.
+ * @param completed_value The number of frames known to be completed on the GPU.
+ */
+void vulkan_deletion_queue_flush(vulkan_context *context, vulkan_deletion_queue *queue, u64 completed_value);
+
+/**
+ * Destroys every resource of the queue and releases its memory. The device should be idle.
+ * @param context A pointer to the vulkan context.
+ * @param queue A pointer to the deletion queue.
+ */
+void vulkan_deletion_queue_destroy(vulkan_context *context, vulkan_deletion_queue *queue);
+
+#endif
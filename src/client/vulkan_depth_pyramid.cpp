@@ -0,0 +1,373 @@
+#include "vulkan_depth_pyramid.h"
+#include "vulkan_compute.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_image.h"
+#include "vulkan_memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// local_size_x and local_size_y of depth_pyramid.comp
+#define PYRAMID_GROUP_SIZE 8
+
+// Push constants of depth_pyramid.comp
+typedef struct pyramid_constants
+{
+    u32 source_size[2];
+    u32 destination_size[2];
+} pyramid_constants;
+
+static b8 create_descriptors(vulkan_context *context, vulkan_depth_pyramid *pyramid)
+{
+    // The depth (or the previous level) is read, the level written
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 2;
+    layout_create_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(context->device.logical_device, &layout_create_info, context->allocator, &pyramid->set_layout) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_depth_pyramid_create - Failed to create descriptor set layout.\n");
+        return BC_FALSE;
+    }
+
+    u32 set_count = VULKAN_DEPTH_PYRAMID_MAX_LEVELS * pyramid->frame_count;
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = set_count;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pool_sizes[1].descriptorCount = set_count;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = set_count;
+    pool_create_info.poolSizeCount = 2;
+    pool_create_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(context->device.logical_device, &pool_create_info, context->allocator, &pyramid->descriptor_pool) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_depth_pyramid_create - Failed to create descriptor pool.\n");
+        return BC_FALSE;
+    }
+
+    // Written once the image exists, see update_descriptors
+    VkDescriptorSetLayout set_layouts[VULKAN_DEPTH_PYRAMID_MAX_LEVELS];
+    for (u32 i = 0; i < VULKAN_DEPTH_PYRAMID_MAX_LEVELS; ++i)
+        set_layouts[i] = pyramid->set_layout;
+    for (u32 i = 0; i < pyramid->frame_count; ++i)
+    {
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = pyramid->descriptor_pool;
+        allocate_info.descriptorSetCount = VULKAN_DEPTH_PYRAMID_MAX_LEVELS;
+        allocate_info.pSetLayouts = set_layouts;
+        if (vkAllocateDescriptorSets(context->device.logical_device, &allocate_info, pyramid->frames[i].descriptor_sets) != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_depth_pyramid_create - Failed to allocate descriptor sets.\n");
+            return BC_FALSE;
+        }
+    }
+
+    return BC_TRUE;
+}
+
+// Points the descriptor sets of a frame slot at the current image. The slot should be free.
+static void update_descriptors(vulkan_context *context, vulkan_depth_pyramid *pyramid, vulkan_depth_pyramid_frame *frame)
+{
+    VkDescriptorImageInfo image_infos[VULKAN_DEPTH_PYRAMID_MAX_LEVELS][2] = {};
+    VkWriteDescriptorSet writes[VULKAN_DEPTH_PYRAMID_MAX_LEVELS * 2] = {};
+    u32 write_count = 0;
+    for (u32 level = 0; level < pyramid->level_count; ++level)
+    {
+        image_infos[level][0].sampler = pyramid->sampler;
+        image_infos[level][0].imageView = level ? pyramid->level_views[level - 1] : pyramid->depth_view;
+        image_infos[level][0].imageLayout = level ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        image_infos[level][1].imageView = pyramid->level_views[level];
+        image_infos[level][1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        for (u32 b = 0; b < 2; ++b)
+        {
+            VkWriteDescriptorSet *write = &writes[write_count++];
+            write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write->dstSet = frame->descriptor_sets[level];
+            write->dstBinding = b;
+            write->descriptorCount = 1;
+            write->descriptorType = b ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write->pImageInfo = &image_infos[level][b];
+        }
+    }
+    vkUpdateDescriptorSets(context->device.logical_device, write_count, writes, 0, NULL);
+    frame->generation = pyramid->generation;
+}
+
+static VkImageView create_view(vulkan_context *context, VkImage image, VkFormat format, VkImageAspectFlags aspect, u32 base_level, u32 level_count)
+{
+    VkImageViewCreateInfo view_create_info = {};
+    view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_create_info.image = image;
+    view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_create_info.format = format;
+    view_create_info.subresourceRange.aspectMask = aspect;
+    view_create_info.subresourceRange.baseMipLevel = base_level;
+    view_create_info.subresourceRange.levelCount = level_count;
+    view_create_info.subresourceRange.baseArrayLayer = 0;
+    view_create_info.subresourceRange.layerCount = 1;
+
+    VkImageView view = VK_NULL_HANDLE;
+    if (vkCreateImageView(context->device.logical_device, &view_create_info, context->allocator, &view) != VK_SUCCESS)
+        printf("ERROR: vulkan_depth_pyramid_resize - Failed to create image view.\n");
+    return view;
+}
+
+b8 vulkan_depth_pyramid_create(
+    vulkan_context *context, const vulkan_compute *compute, u32 frame_count, VkShaderModule shader,
+    vulkan_depth_pyramid *out_pyramid)
+{
+    memset(out_pyramid, 0, sizeof(vulkan_depth_pyramid));
+    out_pyramid->frame_count = frame_count;
+    out_pyramid->async = compute->async;
+    out_pyramid->queue_families[0] = (u32)context->device.graphics_queue_index;
+    out_pyramid->queue_families[1] = compute->queue_family_index;
+
+    // Only read with texelFetch
+    VkSamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_NEAREST;
+    sampler_create_info.minFilter = VK_FILTER_NEAREST;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(context->device.logical_device, &sampler_create_info, context->allocator, &out_pyramid->sampler) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_depth_pyramid_create - Failed to create sampler.\n");
+        return BC_FALSE;
+    }
+
+    if (out_pyramid->async)
+    {
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &out_pyramid->built_semaphore) != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_depth_pyramid_create - Failed to create semaphore.\n");
+            return BC_FALSE;
+        }
+    }
+
+    return create_descriptors(context, out_pyramid) &&
+           vulkan_compute_pipeline_create(context, shader, 1, &out_pyramid->set_layout, sizeof(pyramid_constants), &out_pyramid->pipeline);
+}
+
+void vulkan_depth_pyramid_destroy(vulkan_context *context, vulkan_depth_pyramid *pyramid)
+{
+    VkDevice device = context->device.logical_device;
+    for (u32 i = 0; i < pyramid->level_count; ++i)
+        vkDestroyImageView(device, pyramid->level_views[i], context->allocator);
+    if (pyramid->view)
+        vkDestroyImageView(device, pyramid->view, context->allocator);
+    if (pyramid->depth_view)
+        vkDestroyImageView(device, pyramid->depth_view, context->allocator);
+    if (pyramid->image)
+        vkDestroyImage(device, pyramid->image, context->allocator);
+    vulkan_memory_free(context, &context->memory, &pyramid->allocation);
+
+    vulkan_compute_pipeline_destroy(context, &pyramid->pipeline);
+    if (pyramid->descriptor_pool)
+        vkDestroyDescriptorPool(device, pyramid->descriptor_pool, context->allocator);
+    if (pyramid->set_layout)
+        vkDestroyDescriptorSetLayout(device, pyramid->set_layout, context->allocator);
+    if (pyramid->sampler)
+        vkDestroySampler(device, pyramid->sampler, context->allocator);
+    if (pyramid->built_semaphore)
+        vkDestroySemaphore(device, pyramid->built_semaphore, context->allocator);
+
+    memset(pyramid, 0, sizeof(vulkan_depth_pyramid));
+}
+
+b8 vulkan_depth_pyramid_resize(vulkan_context *context, vulkan_depth_pyramid *pyramid, const vulkan_image *depth, u64 retire_value)
+{
+    // The frames in flight may still build or read the previous one
+    vulkan_deletion_queue *deletion_queue = &context->deletion_queue;
+    for (u32 i = 0; i < pyramid->level_count; ++i)
+        vulkan_deletion_queue_push(deletion_queue, VULKAN_DELETION_IMAGE_VIEW, (u64)pyramid->level_views[i], retire_value);
+    if (pyramid->view)
+        vulkan_deletion_queue_push(deletion_queue, VULKAN_DELETION_IMAGE_VIEW, (u64)pyramid->view, retire_value);
+    if (pyramid->depth_view)
+        vulkan_deletion_queue_push(deletion_queue, VULKAN_DELETION_IMAGE_VIEW, (u64)pyramid->depth_view, retire_value);
+    if (pyramid->image)
+    {
+        vulkan_deletion_queue_push(deletion_queue, VULKAN_DELETION_IMAGE, (u64)pyramid->image, retire_value);
+        vulkan_deletion_queue_push_allocation(deletion_queue, &pyramid->allocation, retire_value);
+    }
+    memset(pyramid->level_views, 0, sizeof(pyramid->level_views));
+    memset(&pyramid->allocation, 0, sizeof(vulkan_allocation));
+    pyramid->view = VK_NULL_HANDLE;
+    pyramid->depth_view = VK_NULL_HANDLE;
+    pyramid->image = VK_NULL_HANDLE;
+    pyramid->level_count = 0;
+    pyramid->built = BC_FALSE;
+    pyramid->generation++;
+
+    pyramid->depth_image = depth->handle;
+    pyramid->depth_aspect = depth->aspect;
+    pyramid->depth_width = depth->width;
+    pyramid->depth_height = depth->height;
+    // Rounded up, the last texel of an odd row (or column) covers a single one of the level above
+    pyramid->width = (depth->width + 1) / 2;
+    pyramid->height = (depth->height + 1) / 2;
+    u32 level_count = 1;
+    for (u32 w = pyramid->width, h = pyramid->height; (w > 1 || h > 1) && level_count < VULKAN_DEPTH_PYRAMID_MAX_LEVELS; ++level_count)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+
+    VkImageCreateInfo image_create_info = {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = VK_FORMAT_R32_SFLOAT;
+    image_create_info.extent = {pyramid->width, pyramid->height, 1};
+    image_create_info.mipLevels = level_count;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Read by the culling on the compute queue with async compute, like the buffers of vulkan_compute_buffer_create
+    if (pyramid->async && pyramid->queue_families[0] != pyramid->queue_families[1])
+    {
+        image_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        image_create_info.queueFamilyIndexCount = 2;
+        image_create_info.pQueueFamilyIndices = pyramid->queue_families;
+    }
+    if (vkCreateImage(context->device.logical_device, &image_create_info, context->allocator, &pyramid->image) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_depth_pyramid_resize - Failed to create image.\n");
+        return BC_FALSE;
+    }
+    if (!vulkan_memory_allocate_image(context, &context->memory, pyramid->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pyramid->allocation))
+    {
+        printf("ERROR: vulkan_depth_pyramid_resize - Failed to allocate image memory.\n");
+        return BC_FALSE;
+    }
+
+    pyramid->view = create_view(context, pyramid->image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count);
+    b8 created = pyramid->view != VK_NULL_HANDLE;
+    for (u32 i = 0; i < level_count; ++i)
+    {
+        pyramid->level_views[i] = create_view(context, pyramid->image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+        created &= pyramid->level_views[i] != VK_NULL_HANDLE;
+    }
+    pyramid->level_count = level_count;
+    // Only the depth can be sampled of a depth stencil format
+    pyramid->depth_view = create_view(context, depth->handle, depth->format, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+    return created && pyramid->depth_view != VK_NULL_HANDLE;
+}
+
+void vulkan_depth_pyramid_record(
+    vulkan_context *context, vulkan_depth_pyramid *pyramid, VkCommandBuffer command_buffer, u32 frame_slot,
+    const f32 *view_projection)
+{
+    // The culling has not waited on the previous build yet, see vulkan_depth_pyramid.h
+    if (!pyramid->level_count || pyramid->wait_pending)
+        return;
+
+    vulkan_depth_pyramid_frame *frame = &pyramid->frames[frame_slot];
+    if (frame->generation != pyramid->generation)
+        update_descriptors(context, pyramid, frame);
+
+    // The depth writes of the render pass are done, and so is the culling of this frame reading the levels.
+    // A depth resolve writes as a colour attachment does.
+    VkImageMemoryBarrier image_barriers[2] = {};
+    image_barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    image_barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    image_barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barriers[0].image = pyramid->depth_image;
+    image_barriers[0].subresourceRange.aspectMask = pyramid->depth_aspect;
+    image_barriers[0].subresourceRange.levelCount = 1;
+    image_barriers[0].subresourceRange.layerCount = 1;
+    // Every level is written again, so the previous contents are discarded
+    image_barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barriers[1].srcAccessMask = 0;
+    image_barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    image_barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image_barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barriers[1].image = pyramid->image;
+    image_barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_barriers[1].subresourceRange.levelCount = pyramid->level_count;
+    image_barriers[1].subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 2, image_barriers);
+
+    // Each level is read by the next one, the last one by the culling of the next frame
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    pyramid_constants constants = {};
+    constants.source_size[0] = pyramid->depth_width;
+    constants.source_size[1] = pyramid->depth_height;
+    constants.destination_size[0] = pyramid->width;
+    constants.destination_size[1] = pyramid->height;
+    for (u32 level = 0; level < pyramid->level_count; ++level)
+    {
+        vulkan_compute_dispatch(
+            command_buffer, &pyramid->pipeline, 1, &frame->descriptor_sets[level], &constants, sizeof(constants),
+            (constants.destination_size[0] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+            (constants.destination_size[1] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+        vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &barrier, 0, NULL, 0, NULL);
+
+        constants.source_size[0] = constants.destination_size[0];
+        constants.source_size[1] = constants.destination_size[1];
+        constants.destination_size[0] = (constants.destination_size[0] + 1) / 2;
+        constants.destination_size[1] = (constants.destination_size[1] + 1) / 2;
+    }
+
+    pyramid->built = BC_TRUE;
+    memcpy(pyramid->view_projection, view_projection, sizeof(pyramid->view_projection));
+    pyramid->signal = pyramid->async;
+}
+
+b8 vulkan_depth_pyramid_take_signal(vulkan_depth_pyramid *pyramid, VkSemaphore *out_semaphore)
+{
+    if (!pyramid->signal)
+        return BC_FALSE;
+
+    *out_semaphore = pyramid->built_semaphore;
+    pyramid->signal = BC_FALSE;
+    pyramid->wait_pending = BC_TRUE;
+    return BC_TRUE;
+}
+
+b8 vulkan_depth_pyramid_take_wait(vulkan_depth_pyramid *pyramid, VkSemaphore *out_semaphore)
+{
+    if (!pyramid->wait_pending)
+        return BC_FALSE;
+
+    *out_semaphore = pyramid->built_semaphore;
+    pyramid->wait_pending = BC_FALSE;
+    return BC_TRUE;
+}
@@ -0,0 +1,78 @@
+#ifndef VULKAN_NOTES_1704376920_VULKAN_DEPTH_PYRAMID_H
+#define VULKAN_NOTES_1704376920_VULKAN_DEPTH_PYRAMID_H
+
+#include "vulkan_types.h"
+
+/*
+Hierarchical depth the GPU culling tests the instances against (see vulkan_culling.h).
+
+After the render pass, the single sample depth of the frame (the depth attachment itself, or the one it is resolved
+into with MSAA) is reduced level by level into a mip chain, one dispatch of depth_pyramid.comp per level. Each texel
+of level 0 holds the farthest depth of 2x2 pixels, each texel of level n the farthest depth of 2x2 texels of level
+n - 1, so a texel of level n covers the (2 << n) x (2 << n) pixels from its coordinates times (2 << n) on.
+The depth is reversed, so the farthest depth is the smallest one.
+
+The next frame culls with it before its own render pass: an instance whose bounds are farther than the farthest depth
+of the texels covering them was hidden in the previous frame. The pyramid stays in VK_IMAGE_LAYOUT_GENERAL.
+
+The build is recorded into the graphics command buffer, so on the same queue the barriers order it with the culling.
+With async compute the culling of the next frame runs on the compute queue instead: the graphics submission signals
+built_semaphore, which the culling dispatches wait on. A binary semaphore can't be signaled again before it is
+waited on, so while no dispatch has waited on it (nothing was culled) the pyramid is not rebuilt.
+*/
+
+/**
+ * Creates the build pipeline, its descriptor sets and the sampler. The image is created by vulkan_depth_pyramid_resize.
+ * @param context A pointer to the vulkan context.
+ * @param compute A pointer to the compute state the culling is recorded with.
+ * @param frame_count The number of frames in flight.
+ * @param shader The module of depth_pyramid.comp.
+ * @param out_pyramid A pointer to the pyramid to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_depth_pyramid_create(
+    vulkan_context *context, const vulkan_compute *compute, u32 frame_count, VkShaderModule shader,
+    vulkan_depth_pyramid *out_pyramid);
+
+/**
+ * Destroys the image, the pipeline and the descriptor sets. The GPU should be done with them.
+ */
+void vulkan_depth_pyramid_destroy(vulkan_context *context, vulkan_depth_pyramid *pyramid);
+
+/**
+ * (Re)creates the image for the size of a depth image, i.e. along with the swapchain. The previous one is retired.
+ * The pyramid is empty until it is built again.
+ * @param context A pointer to the vulkan context.
+ * @param pyramid A pointer to the pyramid.
+ * @param depth The single sample depth image it is built from, with VK_IMAGE_USAGE_SAMPLED_BIT.
+ * @param retire_value The number of frames which have to complete before the previous image can be destroyed.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_depth_pyramid_resize(vulkan_context *context, vulkan_depth_pyramid *pyramid, const vulkan_image *depth, u64 retire_value);
+
+/**
+ * Records the build of the pyramid from the depth of the frame. Should be recorded after the render pass, with the
+ * depth in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL. It is left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+ * @param context A pointer to the vulkan context.
+ * @param pyramid A pointer to the pyramid.
+ * @param command_buffer The command buffer of the frame, outside of a render pass.
+ * @param frame_slot The index of the frame in flight. The GPU should be done with its previous use.
+ * @param view_projection The column major matrix the frame was drawn with.
+ */
+void vulkan_depth_pyramid_record(
+    vulkan_context *context, vulkan_depth_pyramid *pyramid, VkCommandBuffer command_buffer, u32 frame_slot,
+    const f32 *view_projection);
+
+/**
+ * Gets the semaphore the graphics submission of the current frame signals for the culling (async compute), and clears it.
+ * @returns True if the submission has to signal it; otherwise false.
+ */
+b8 vulkan_depth_pyramid_take_signal(vulkan_depth_pyramid *pyramid, VkSemaphore *out_semaphore);
+
+/**
+ * Gets the semaphore the culling dispatches of the current frame wait on (async compute), and clears it.
+ * @returns True if the dispatches have to wait on it; otherwise false.
+ */
+b8 vulkan_depth_pyramid_take_wait(vulkan_depth_pyramid *pyramid, VkSemaphore *out_semaphore);
+
+#endif
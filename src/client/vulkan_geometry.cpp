@@ -0,0 +1,117 @@
+#include "vulkan_geometry.h"
+#include "vulkan_buffer.h"
+#include "vulkan_upload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Sphere centered on the bounding box of the vertices, loose but cheap
+static void compute_bounding_sphere(const renderer_vertex *vertices, u32 vertex_count, f32 *out_sphere)
+{
+    f32 min[3] = {0, 0, 0}, max[3] = {0, 0, 0};
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            f32 value = vertices[i].position[axis];
+            if (i == 0 || value < min[axis])
+                min[axis] = value;
+            if (i == 0 || value > max[axis])
+                max[axis] = value;
+        }
+    }
+
+    f32 radius_squared = 0;
+    for (u32 axis = 0; axis < 3; ++axis)
+        out_sphere[axis] = (min[axis] + max[axis]) * 0.5f;
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+        f32 dx = vertices[i].position[0] - out_sphere[0];
+        f32 dy = vertices[i].position[1] - out_sphere[1];
+        f32 dz = vertices[i].position[2] - out_sphere[2];
+        f32 distance_squared = dx * dx + dy * dy + dz * dz;
+        if (distance_squared > radius_squared)
+            radius_squared = distance_squared;
+    }
+    out_sphere[3] = sqrtf(radius_squared);
+}
+
+b8 vulkan_geometry_create(vulkan_context *context, u32 vertex_capacity, u32 index_capacity, vulkan_geometry *out_geometry)
+{
+    memset(out_geometry, 0, sizeof(vulkan_geometry));
+
+    if (!vulkan_buffer_create(
+            context, (VkDeviceSize)vertex_capacity * sizeof(renderer_vertex),
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &out_geometry->vertex_buffer))
+        return BC_FALSE;
+
+    if (!vulkan_buffer_create(
+            context, (VkDeviceSize)index_capacity * sizeof(u32),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &out_geometry->index_buffer))
+    {
+        vulkan_buffer_destroy(context, &out_geometry->vertex_buffer);
+        return BC_FALSE;
+    }
+
+    out_geometry->vertex_capacity = vertex_capacity;
+    out_geometry->index_capacity = index_capacity;
+    return BC_TRUE;
+}
+
+void vulkan_geometry_destroy(vulkan_context *context, vulkan_geometry *geometry)
+{
+    vulkan_buffer_destroy(context, &geometry->vertex_buffer);
+    vulkan_buffer_destroy(context, &geometry->index_buffer);
+    free(geometry->meshes);
+
+    memset(geometry, 0, sizeof(vulkan_geometry));
+}
+
+i32 vulkan_geometry_add_mesh(
+    vulkan_context *context, vulkan_geometry *geometry, vulkan_uploader *uploader,
+    const renderer_vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+    if (geometry->vertex_count + vertex_count > geometry->vertex_capacity ||
+        geometry->index_count + index_count > geometry->index_capacity)
+    {
+        printf("ERROR: vulkan_geometry_add_mesh - Out of geometry buffer space.\n");
+        return -1;
+    }
+
+    if (!vulkan_uploader_upload_buffer(
+            context, uploader, &geometry->vertex_buffer,
+            (VkDeviceSize)geometry->vertex_count * sizeof(renderer_vertex), vertices, (VkDeviceSize)vertex_count * sizeof(renderer_vertex),
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT) ||
+        !vulkan_uploader_upload_buffer(
+            context, uploader, &geometry->index_buffer,
+            (VkDeviceSize)geometry->index_count * sizeof(u32), indices, (VkDeviceSize)index_count * sizeof(u32),
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT))
+        return -1;
+
+    if (geometry->mesh_count == geometry->mesh_capacity)
+    {
+        geometry->mesh_capacity = geometry->mesh_capacity ? geometry->mesh_capacity * 2 : 16;
+        geometry->meshes = (vulkan_mesh *)realloc(geometry->meshes, sizeof(vulkan_mesh) * geometry->mesh_capacity);
+    }
+
+    vulkan_mesh *mesh = &geometry->meshes[geometry->mesh_count];
+    mesh->first_index = geometry->index_count;
+    mesh->index_count = index_count;
+    mesh->vertex_offset = (i32)geometry->vertex_count;
+    compute_bounding_sphere(vertices, vertex_count, mesh->bounding_sphere);
+
+    geometry->vertex_count += vertex_count;
+    geometry->index_count += index_count;
+    return (i32)geometry->mesh_count++;
+}
+
+void vulkan_geometry_bind(const vulkan_geometry *geometry, VkCommandBuffer command_buffer)
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &geometry->vertex_buffer.handle, &offset);
+    vkCmdBindIndexBuffer(command_buffer, geometry->index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
+}
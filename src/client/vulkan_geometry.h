@@ -0,0 +1,47 @@
+#ifndef VULKAN_NOTES_1704030356_VULKAN_GEOMETRY_H
+#define VULKAN_NOTES_1704030356_VULKAN_GEOMETRY_H
+
+#include "vulkan_types.h"
+
+/*
+Meshes are sub-allocated linearly from a device local vertex buffer and index buffer shared by all
+of them. Their data is written through the uploader, so a mesh can be drawn once the uploader has
+been flushed to the graphics queue, which the renderer does before submitting each frame.
+*/
+
+/**
+ * Creates the shared vertex and index buffers.
+ * @param context A pointer to the vulkan context.
+ * @param vertex_capacity The maximum number of renderer_vertex of all meshes.
+ * @param index_capacity The maximum number of (u32) indices of all meshes.
+ * @param out_geometry A pointer to the geometry to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_geometry_create(vulkan_context *context, u32 vertex_capacity, u32 index_capacity, vulkan_geometry *out_geometry);
+
+/**
+ * Destroys the buffers. The GPU should be done with them.
+ */
+void vulkan_geometry_destroy(vulkan_context *context, vulkan_geometry *geometry);
+
+/**
+ * Allocates a mesh and queues the upload of its data.
+ * @param context A pointer to the vulkan context.
+ * @param geometry A pointer to the geometry.
+ * @param uploader A pointer to the uploader used to copy the data.
+ * @param vertices The vertices of the mesh.
+ * @param vertex_count The number of vertices.
+ * @param indices The indices of the mesh, relative to its first vertex.
+ * @param index_count The number of indices.
+ * @returns The index of the mesh or -1 if the buffers are full or the upload failed.
+ */
+i32 vulkan_geometry_add_mesh(
+    vulkan_context *context, vulkan_geometry *geometry, vulkan_uploader *uploader,
+    const renderer_vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
+
+/**
+ * Binds the shared vertex and index buffers.
+ */
+void vulkan_geometry_bind(const vulkan_geometry *geometry, VkCommandBuffer command_buffer);
+
+#endif
@@ -0,0 +1,259 @@
+#include "vulkan_gpu_timer.h"
+#include "log_assert.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define TIMESTAMP_FRAME_BEGIN 0
+#define TIMESTAMP_PRE_RENDER_PASS_END 1
+#define TIMESTAMP_RENDER_PASS_BEGIN 2
+#define TIMESTAMP_RENDER_PASS_END 3
+#define TIMESTAMP_FRAME_END 4
+#define TIMESTAMP_FIRST_DRAW 5
+#define TIMESTAMPS_PER_FRAME (TIMESTAMP_FIRST_DRAW + 2 * RENDERER_MAX_TIMED_DRAWS)
+
+// The order of the results follows the order of the bits
+#define PIPELINE_STATISTIC_COUNT 6
+static const VkQueryPipelineStatisticFlags pipeline_statistic_flags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+void vulkan_gpu_timer_create(vulkan_context *context, u32 frame_count, vulkan_gpu_timer *out_timer)
+{
+    memset(out_timer, 0, sizeof(vulkan_gpu_timer));
+
+    // Timestamps are only supported if the queue reports valid bits
+    u32 queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(context->device.physical_device, &queue_family_count, NULL);
+    VkQueueFamilyProperties *queue_families = (VkQueueFamilyProperties *)(malloc(sizeof(VkQueueFamilyProperties) * queue_family_count));
+    vkGetPhysicalDeviceQueueFamilyProperties(context->device.physical_device, &queue_family_count, queue_families);
+    u32 valid_bits = queue_families[context->device.graphics_queue_index].timestampValidBits;
+    free(queue_families);
+
+    if (!valid_bits)
+    {
+        printf("WARNING: Graphics queue does not support timestamps, GPU timings are disabled.\n");
+        return;
+    }
+
+    out_timer->enabled = BC_TRUE;
+    out_timer->statistics_enabled = context->device.features.pipelineStatisticsQuery;
+    out_timer->statistic_flags = pipeline_statistic_flags;
+    out_timer->timestamp_period = context->device.properties.limits.timestampPeriod;
+    out_timer->timestamp_mask = valid_bits >= 64 ? UINT64_MAX : ((1ULL << valid_bits) - 1);
+
+    out_timer->frame_count = frame_count;
+    out_timer->frames = (vulkan_gpu_timer_frame *)(malloc(sizeof(vulkan_gpu_timer_frame) * frame_count));
+    memset(out_timer->frames, 0, sizeof(vulkan_gpu_timer_frame) * frame_count);
+
+    for (u32 i = 0; i < frame_count; ++i)
+    {
+        VkQueryPoolCreateInfo pool_create_info = {};
+        pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_create_info.queryCount = TIMESTAMPS_PER_FRAME;
+        VkResult result = vkCreateQueryPool(context->device.logical_device, &pool_create_info, context->allocator, &out_timer->frames[i].timestamp_pool);
+        if (result != VK_SUCCESS)
+            ERR_EXIT("Failed to create timestamp query pool.\n", "vulkan_gpu_timer_create::vkCreateQueryPool");
+
+        if (out_timer->statistics_enabled)
+        {
+            pool_create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            pool_create_info.queryCount = 1;
+            pool_create_info.pipelineStatistics = pipeline_statistic_flags;
+            result = vkCreateQueryPool(context->device.logical_device, &pool_create_info, context->allocator, &out_timer->frames[i].statistics_pool);
+            if (result != VK_SUCCESS)
+                ERR_EXIT("Failed to create pipeline statistics query pool.\n", "vulkan_gpu_timer_create::vkCreateQueryPool");
+        }
+    }
+
+    out_timer->history = (renderer_gpu_frame_timings *)(malloc(sizeof(renderer_gpu_frame_timings) * RENDERER_GPU_TIMING_HISTORY));
+    memset(out_timer->history, 0, sizeof(renderer_gpu_frame_timings) * RENDERER_GPU_TIMING_HISTORY);
+}
+
+void vulkan_gpu_timer_destroy(vulkan_context *context, vulkan_gpu_timer *timer)
+{
+    for (u32 i = 0; i < timer->frame_count; ++i)
+    {
+        if (timer->frames[i].timestamp_pool)
+            vkDestroyQueryPool(context->device.logical_device, timer->frames[i].timestamp_pool, context->allocator);
+        if (timer->frames[i].statistics_pool)
+            vkDestroyQueryPool(context->device.logical_device, timer->frames[i].statistics_pool, context->allocator);
+    }
+
+    free(timer->frames);
+    free(timer->history);
+    memset(timer, 0, sizeof(vulkan_gpu_timer));
+}
+
+static f64 ticks_to_ms(const vulkan_gpu_timer *timer, u64 begin, u64 end)
+{
+    u64 ticks = ((end & timer->timestamp_mask) - (begin & timer->timestamp_mask)) & timer->timestamp_mask;
+    return (f64)ticks * timer->timestamp_period / 1000000.0;
+}
+
+// Reads the results of the slot without waiting. Returns false if any of them is not available yet.
+static b8 collect_results(vulkan_context *context, vulkan_gpu_timer *timer, vulkan_gpu_timer_frame *frame)
+{
+    // The render pass never ended in this slot
+    if (!frame->timestamp_count)
+        return BC_FALSE;
+
+    // Each result is followed by its availability value
+    u64 timestamps[TIMESTAMPS_PER_FRAME * 2];
+    VkResult result = vkGetQueryPoolResults(
+        context->device.logical_device, frame->timestamp_pool,
+        0, frame->timestamp_count,
+        sizeof(u64) * 2 * frame->timestamp_count, timestamps, sizeof(u64) * 2,
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+        return BC_FALSE;
+
+    for (u32 i = 0; i < TIMESTAMP_FIRST_DRAW; ++i)
+    {
+        if (!timestamps[i * 2 + 1])
+            return BC_FALSE;
+    }
+
+    renderer_gpu_frame_timings *entry = &timer->history[timer->history_head];
+    memset(entry, 0, sizeof(renderer_gpu_frame_timings));
+    entry->frame_number = frame->frame_number;
+    entry->frame_ms = ticks_to_ms(timer, timestamps[TIMESTAMP_FRAME_BEGIN * 2], timestamps[TIMESTAMP_FRAME_END * 2]);
+    entry->pre_render_pass_ms = ticks_to_ms(timer, timestamps[TIMESTAMP_FRAME_BEGIN * 2], timestamps[TIMESTAMP_PRE_RENDER_PASS_END * 2]);
+    entry->render_pass_ms = ticks_to_ms(timer, timestamps[TIMESTAMP_RENDER_PASS_BEGIN * 2], timestamps[TIMESTAMP_RENDER_PASS_END * 2]);
+
+    for (u32 i = 0; i < frame->timed_draw_count; ++i)
+    {
+        u32 begin = (TIMESTAMP_FIRST_DRAW + 2 * i) * 2;
+        u32 end = begin + 2;
+        if (!timestamps[begin + 1] || !timestamps[end + 1])
+            break;
+        entry->draw_ms[i] = ticks_to_ms(timer, timestamps[begin], timestamps[end]);
+        entry->timed_draw_count = i + 1;
+    }
+
+    if (frame->statistics_written)
+    {
+        u64 statistics[PIPELINE_STATISTIC_COUNT + 1];
+        result = vkGetQueryPoolResults(
+            context->device.logical_device, frame->statistics_pool,
+            0, 1, sizeof(statistics), statistics, sizeof(statistics),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result == VK_SUCCESS && statistics[PIPELINE_STATISTIC_COUNT])
+        {
+            entry->has_pipeline_statistics = BC_TRUE;
+            entry->input_assembly_vertices = statistics[0];
+            entry->input_assembly_primitives = statistics[1];
+            entry->vertex_shader_invocations = statistics[2];
+            entry->clipping_invocations = statistics[3];
+            entry->clipping_primitives = statistics[4];
+            entry->fragment_shader_invocations = statistics[5];
+        }
+    }
+
+    timer->history_head = (timer->history_head + 1) % RENDERER_GPU_TIMING_HISTORY;
+    if (timer->history_count < RENDERER_GPU_TIMING_HISTORY)
+        ++timer->history_count;
+
+    return BC_TRUE;
+}
+
+void vulkan_gpu_timer_begin_frame(vulkan_context *context, vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u64 frame_number)
+{
+    if (!timer->enabled)
+        return;
+
+    vulkan_gpu_timer_frame *frame = &timer->frames[frame_slot];
+    // The slot's fence has been waited on at this point so the results should be there,
+    // if they are not, the frame is dropped rather than stalling.
+    if (frame->pending && !collect_results(context, timer, frame))
+        printf("WARNING: GPU timings of frame %llu are not available, skipping.\n", (unsigned long long)frame->frame_number);
+
+    // Reset has to be recorded outside of a render pass
+    vkCmdResetQueryPool(command_buffer, frame->timestamp_pool, 0, TIMESTAMPS_PER_FRAME);
+    if (timer->statistics_enabled)
+        vkCmdResetQueryPool(command_buffer, frame->statistics_pool, 0, 1);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestamp_pool, TIMESTAMP_FRAME_BEGIN);
+
+    frame->pending = BC_TRUE;
+    frame->frame_number = frame_number;
+    frame->timestamp_count = 0;
+    frame->timed_draw_count = 0;
+    frame->statistics_written = BC_FALSE;
+}
+
+void vulkan_gpu_timer_render_pass_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot)
+{
+    if (!timer->enabled)
+        return;
+
+    // Bottom of pipe: written once the dispatches and barriers recorded so far are done
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->frames[frame_slot].timestamp_pool, TIMESTAMP_PRE_RENDER_PASS_END);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer->frames[frame_slot].timestamp_pool, TIMESTAMP_RENDER_PASS_BEGIN);
+}
+
+void vulkan_gpu_timer_render_pass_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_count)
+{
+    if (!timer->enabled)
+        return;
+
+    vulkan_gpu_timer_frame *frame = &timer->frames[frame_slot];
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestamp_pool, TIMESTAMP_RENDER_PASS_END);
+    // Only read back what was written
+    frame->timed_draw_count = draw_count < RENDERER_MAX_TIMED_DRAWS ? draw_count : RENDERER_MAX_TIMED_DRAWS;
+    frame->timestamp_count = TIMESTAMP_FIRST_DRAW + 2 * frame->timed_draw_count;
+}
+
+void vulkan_gpu_timer_end_frame(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot)
+{
+    if (!timer->enabled)
+        return;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->frames[frame_slot].timestamp_pool, TIMESTAMP_FRAME_END);
+}
+
+void vulkan_gpu_timer_statistics_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot)
+{
+    if (!timer->enabled || !timer->statistics_enabled)
+        return;
+
+    vkCmdBeginQuery(command_buffer, timer->frames[frame_slot].statistics_pool, 0, 0);
+}
+
+void vulkan_gpu_timer_statistics_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot)
+{
+    if (!timer->enabled || !timer->statistics_enabled)
+        return;
+
+    vkCmdEndQuery(command_buffer, timer->frames[frame_slot].statistics_pool, 0);
+    timer->frames[frame_slot].statistics_written = BC_TRUE;
+}
+
+void vulkan_gpu_timer_draw_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_index)
+{
+    if (!timer->enabled || draw_index >= RENDERER_MAX_TIMED_DRAWS)
+        return;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer->frames[frame_slot].timestamp_pool, TIMESTAMP_FIRST_DRAW + 2 * draw_index);
+}
+
+void vulkan_gpu_timer_draw_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_index)
+{
+    if (!timer->enabled || draw_index >= RENDERER_MAX_TIMED_DRAWS)
+        return;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->frames[frame_slot].timestamp_pool, TIMESTAMP_FIRST_DRAW + 2 * draw_index + 1);
+}
+
+const renderer_gpu_frame_timings *vulkan_gpu_timer_get(const vulkan_gpu_timer *timer, u32 frames_ago)
+{
+    if (!timer->enabled || frames_ago >= timer->history_count)
+        return NULL;
+
+    u32 index = (timer->history_head + RENDERER_GPU_TIMING_HISTORY - 1 - frames_ago) % RENDERER_GPU_TIMING_HISTORY;
+    return &timer->history[index];
+}
@@ -0,0 +1,87 @@
+#ifndef VULKAN_NOTES_1703512218_VULKAN_GPU_TIMER_H
+#define VULKAN_NOTES_1703512218_VULKAN_GPU_TIMER_H
+
+#include "vulkan_types.h"
+
+/*
+Each frame in flight owns a timestamp query pool (and a pipeline statistics one if supported).
+The results of a slot are read back the next time the slot is recorded, that is after its fence
+has been waited on, so they are always at least one frame late and are read without VK_QUERY_RESULT_WAIT_BIT.
+
+Timestamp layout of a frame:
+    0             : frame begin, right after the queries are reset
+    1             : end of the work recorded ahead of the render pass (upload acquires, culling dispatches)
+    2             : render pass begin
+    3             : render pass end
+    4             : frame end, after the work recorded past the render pass (depth pyramid build)
+    5 + 2 * i     : draw i begin
+    5 + 2 * i + 1 : draw i end
+Only the graphics queue is timed: with async compute the culling dispatches run on the compute queue, and are
+neither in the frame nor in the work ahead of the render pass.
+*/
+
+/**
+ * Creates the query pools for each frame in flight.
+ * @param context A pointer to the vulkan context. The logical device should be created.
+ * @param frame_count The number of frames in flight.
+ * @param out_timer A pointer to the timer to be created.
+ */
+void vulkan_gpu_timer_create(vulkan_context *context, u32 frame_count, vulkan_gpu_timer *out_timer);
+
+/**
+ * Destroys the query pools and the history of the timer.
+ * @param context A pointer to the vulkan context.
+ * @param timer A pointer to the timer to be destroyed.
+ */
+void vulkan_gpu_timer_destroy(vulkan_context *context, vulkan_gpu_timer *timer);
+
+/**
+ * Collects the results of the previous use of the frame slot into the history (if they are available),
+ * resets its query pools and writes the frame begin timestamp. Should be called outside of a render pass, right
+ * after the command buffer begins, before anything else is recorded.
+ * @param context A pointer to the vulkan context.
+ * @param timer A pointer to the timer.
+ * @param command_buffer The command buffer of the frame being recorded.
+ * @param frame_slot The index of the frame in flight.
+ * @param frame_number The number of the frame being recorded.
+ */
+void vulkan_gpu_timer_begin_frame(vulkan_context *context, vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u64 frame_number);
+
+/**
+ * Writes the timestamp ending the work recorded since the frame began, once it is complete, then the begin
+ * timestamp of the render pass. Should be recorded right before the render pass begins.
+ */
+void vulkan_gpu_timer_render_pass_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot);
+/**
+ * Writes the end timestamp of the render pass. Should be recorded by the primary command buffer.
+ * @param draw_count The number of draws recorded in the render pass, the first RENDERER_MAX_TIMED_DRAWS of them are read back.
+ */
+void vulkan_gpu_timer_render_pass_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_count);
+/**
+ * Writes the end timestamp of the frame. Should be recorded last, right before the command buffer ends.
+ */
+void vulkan_gpu_timer_end_frame(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot);
+
+/**
+ * Pipeline statistics are collected around the render pass, outside of it, so that they also cover
+ * secondary command buffers executed in it (requires the inheritedQueries feature).
+ */
+void vulkan_gpu_timer_statistics_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot);
+void vulkan_gpu_timer_statistics_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot);
+
+/**
+ * Writes the begin/end timestamp of a draw. Draws beyond RENDERER_MAX_TIMED_DRAWS are not timed.
+ * Can be recorded into secondary command buffers from any thread.
+ * @param draw_index The index of the draw within the frame.
+ */
+void vulkan_gpu_timer_draw_begin(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_index);
+void vulkan_gpu_timer_draw_end(vulkan_gpu_timer *timer, VkCommandBuffer command_buffer, u32 frame_slot, u32 draw_index);
+
+/**
+ * Gets an entry from the rolling history.
+ * @param frames_ago 0 for the most recent entry.
+ * @returns A pointer to the entry or NULL if it is not in the history.
+ */
+const renderer_gpu_frame_timings *vulkan_gpu_timer_get(const vulkan_gpu_timer *timer, u32 frames_ago);
+
+#endif
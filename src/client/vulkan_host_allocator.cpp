@@ -0,0 +1,340 @@
+#include "vulkan_host_allocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#define HEADER_SIZE 16
+// Smallest chunk is 1 << MIN_CLASS_SHIFT bytes, header included
+#define MIN_CLASS_SHIFT 5
+#define SIZE_CLASS_COUNT 8
+#define MAX_POOLED_SIZE ((size_t)1 << (MIN_CLASS_SHIFT + SIZE_CLASS_COUNT - 1))
+#define PAGE_SIZE (64 * 1024)
+#define LARGE_CLASS 0xFFFF
+
+// Sits right in front of the pointer returned to the driver
+typedef struct allocation_header
+{
+    u64 size;
+    u16 size_class;
+    u16 scope;
+    // Distance from the malloc'd pointer to the user pointer, large allocations only
+    u32 offset;
+} allocation_header;
+
+typedef struct size_class_pool
+{
+    std::mutex mutex;
+    // Free chunks, linked through their first bytes
+    void *free_list;
+    void **pages;
+    u32 page_count, page_capacity;
+} size_class_pool;
+
+typedef struct scope_counters
+{
+    std::atomic<u64> bytes;
+    std::atomic<u64> peak_bytes;
+    std::atomic<u64> allocation_count;
+    std::atomic<u64> total_calls;
+    std::atomic<u64> internal_bytes;
+    // total_calls at the beginning of the current frame and the calls of the previous one
+    u64 frame_start_calls;
+    std::atomic<u32> calls_last_frame;
+} scope_counters;
+
+typedef struct host_allocator_state
+{
+    VkAllocationCallbacks callbacks;
+    size_class_pool pools[SIZE_CLASS_COUNT];
+    scope_counters scopes[RENDERER_HOST_ALLOCATION_SCOPE_COUNT];
+    std::atomic<u64> pooled_bytes;
+} host_allocator_state;
+
+static host_allocator_state *state;
+
+static inline allocation_header *get_header(void *memory)
+{
+    return (allocation_header *)((u8 *)memory - HEADER_SIZE);
+}
+
+static inline u32 get_scope_index(VkSystemAllocationScope scope)
+{
+    return (u32)scope < RENDERER_HOST_ALLOCATION_SCOPE_COUNT ? (u32)scope : RENDERER_HOST_ALLOCATION_SCOPE_OBJECT;
+}
+
+// Size class of a chunk holding size bytes and the header, SIZE_CLASS_COUNT if too big to be pooled
+static u32 get_size_class(size_t size, size_t alignment)
+{
+    size_t total = size + HEADER_SIZE;
+    if (alignment > HEADER_SIZE || total > MAX_POOLED_SIZE)
+        return SIZE_CLASS_COUNT;
+
+    u32 size_class = 0;
+    while (((size_t)1 << (MIN_CLASS_SHIFT + size_class)) < total)
+        ++size_class;
+    return size_class;
+}
+
+static void count_call(u32 scope)
+{
+    state->scopes[scope].total_calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void count_allocation(u32 scope, u64 size)
+{
+    scope_counters *counters = &state->scopes[scope];
+    counters->allocation_count.fetch_add(1, std::memory_order_relaxed);
+    u64 bytes = counters->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+    u64 peak = counters->peak_bytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !counters->peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        ;
+}
+
+static void count_free(u32 scope, u64 size)
+{
+    state->scopes[scope].allocation_count.fetch_sub(1, std::memory_order_relaxed);
+    state->scopes[scope].bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static void *pool_allocate(u32 size_class)
+{
+    size_class_pool *pool = &state->pools[size_class];
+    std::lock_guard<std::mutex> lock(pool->mutex);
+
+    if (!pool->free_list)
+    {
+        u8 *page = (u8 *)malloc(PAGE_SIZE);
+        if (!page)
+            return NULL;
+
+        if (pool->page_count == pool->page_capacity)
+        {
+            pool->page_capacity = pool->page_capacity ? pool->page_capacity * 2 : 16;
+            pool->pages = (void **)realloc(pool->pages, sizeof(void *) * pool->page_capacity);
+        }
+        pool->pages[pool->page_count++] = page;
+        state->pooled_bytes.fetch_add(PAGE_SIZE, std::memory_order_relaxed);
+
+        // Thread the chunks of the new page into the free list
+        size_t chunk_size = (size_t)1 << (MIN_CLASS_SHIFT + size_class);
+        for (size_t offset = PAGE_SIZE; offset >= chunk_size; offset -= chunk_size)
+        {
+            void *chunk = page + offset - chunk_size;
+            *(void **)chunk = pool->free_list;
+            pool->free_list = chunk;
+        }
+    }
+
+    void *chunk = pool->free_list;
+    pool->free_list = *(void **)chunk;
+    return chunk;
+}
+
+static void pool_free(u32 size_class, void *chunk)
+{
+    size_class_pool *pool = &state->pools[size_class];
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    *(void **)chunk = pool->free_list;
+    pool->free_list = chunk;
+}
+
+static void *allocate(size_t size, size_t alignment, u32 scope)
+{
+    u32 size_class = get_size_class(size, alignment);
+    u8 *memory;
+    u32 offset = 0;
+    if (size_class < SIZE_CLASS_COUNT)
+    {
+        u8 *chunk = (u8 *)pool_allocate(size_class);
+        if (!chunk)
+            return NULL;
+        memory = chunk + HEADER_SIZE;
+    }
+    else
+    {
+        if (alignment < HEADER_SIZE)
+            alignment = HEADER_SIZE;
+        u8 *raw = (u8 *)malloc(size + HEADER_SIZE + alignment);
+        if (!raw)
+            return NULL;
+        memory = (u8 *)(((uintptr_t)raw + HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        offset = (u32)(memory - raw);
+        size_class = LARGE_CLASS;
+    }
+
+    allocation_header *header = get_header(memory);
+    header->size = size;
+    header->size_class = (u16)size_class;
+    header->scope = (u16)scope;
+    header->offset = offset;
+
+    count_allocation(scope, size);
+    return memory;
+}
+
+static void release(void *memory)
+{
+    allocation_header *header = get_header(memory);
+    count_free(header->scope, header->size);
+
+    if (header->size_class == LARGE_CLASS)
+        free((u8 *)memory - header->offset);
+    else
+        pool_free(header->size_class, header);
+}
+
+//--------------
+// Callbacks
+//--------------
+static void *VKAPI_PTR allocation_callback(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope allocation_scope)
+{
+    u32 scope = get_scope_index(allocation_scope);
+    count_call(scope);
+    if (!size)
+        return NULL;
+    return allocate(size, alignment, scope);
+}
+
+static void *VKAPI_PTR reallocation_callback(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope allocation_scope)
+{
+    u32 scope = get_scope_index(allocation_scope);
+    count_call(scope);
+
+    if (!original)
+        return size ? allocate(size, alignment, scope) : NULL;
+    if (!size)
+    {
+        release(original);
+        return NULL;
+    }
+
+    allocation_header *header = get_header(original);
+    // Still fits its chunk, only the bookkeeping changes
+    if (header->size_class != LARGE_CLASS && get_size_class(size, alignment) <= header->size_class)
+    {
+        count_free(header->scope, header->size);
+        count_allocation(scope, size);
+        header->size = size;
+        header->scope = (u16)scope;
+        return original;
+    }
+
+    void *memory = allocate(size, alignment, scope);
+    if (!memory)
+        return NULL; // The original stays valid
+    memcpy(memory, original, header->size < size ? header->size : size);
+    release(original);
+    return memory;
+}
+
+static void VKAPI_PTR free_callback(void *user_data, void *memory)
+{
+    if (!memory)
+        return;
+
+    allocation_header *header = get_header(memory);
+    count_call(header->scope);
+    release(memory);
+}
+
+static void VKAPI_PTR internal_allocation_callback(void *user_data, size_t size, VkInternalAllocationType allocation_type, VkSystemAllocationScope allocation_scope)
+{
+    state->scopes[get_scope_index(allocation_scope)].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void VKAPI_PTR internal_free_callback(void *user_data, size_t size, VkInternalAllocationType allocation_type, VkSystemAllocationScope allocation_scope)
+{
+    state->scopes[get_scope_index(allocation_scope)].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+//--------------
+// Public
+//--------------
+void vulkan_host_allocator_create()
+{
+    if (state)
+        return;
+
+    // Value initialized, the atomics start at 0
+    state = new host_allocator_state();
+    state->callbacks.pUserData = state;
+    state->callbacks.pfnAllocation = allocation_callback;
+    state->callbacks.pfnReallocation = reallocation_callback;
+    state->callbacks.pfnFree = free_callback;
+    state->callbacks.pfnInternalAllocation = internal_allocation_callback;
+    state->callbacks.pfnInternalFree = internal_free_callback;
+}
+
+void vulkan_host_allocator_destroy()
+{
+    if (!state)
+        return;
+
+    for (u32 i = 0; i < RENDERER_HOST_ALLOCATION_SCOPE_COUNT; ++i)
+    {
+        u64 count = state->scopes[i].allocation_count.load();
+        if (count)
+            printf("WARNING: vulkan_host_allocator - %llu allocations (%llu bytes) of scope %u were not freed.\n",
+                   (unsigned long long)count, (unsigned long long)state->scopes[i].bytes.load(), i);
+    }
+
+    for (u32 i = 0; i < SIZE_CLASS_COUNT; ++i)
+    {
+        size_class_pool *pool = &state->pools[i];
+        for (u32 j = 0; j < pool->page_count; ++j)
+            free(pool->pages[j]);
+        free(pool->pages);
+    }
+
+    delete state;
+    state = NULL;
+}
+
+VkAllocationCallbacks *vulkan_host_allocator_callbacks()
+{
+    return state ? &state->callbacks : NULL;
+}
+
+u32 vulkan_host_allocator_begin_frame()
+{
+    if (!state)
+        return 0;
+
+    u32 total = 0;
+    for (u32 i = 0; i < RENDERER_HOST_ALLOCATION_SCOPE_COUNT; ++i)
+    {
+        scope_counters *counters = &state->scopes[i];
+        u64 calls = counters->total_calls.load(std::memory_order_relaxed);
+        u32 calls_last_frame = (u32)(calls - counters->frame_start_calls);
+        counters->calls_last_frame.store(calls_last_frame, std::memory_order_relaxed);
+        counters->frame_start_calls = calls;
+        total += calls_last_frame;
+    }
+    return total;
+}
+
+b8 vulkan_host_allocator_get_stats(renderer_host_memory_stats *out_stats)
+{
+    memset(out_stats, 0, sizeof(renderer_host_memory_stats));
+    if (!state)
+        return BC_FALSE;
+
+    for (u32 i = 0; i < RENDERER_HOST_ALLOCATION_SCOPE_COUNT; ++i)
+    {
+        scope_counters *counters = &state->scopes[i];
+        renderer_host_allocation_stats *stats = &out_stats->scopes[i];
+        stats->bytes = counters->bytes.load(std::memory_order_relaxed);
+        stats->peak_bytes = counters->peak_bytes.load(std::memory_order_relaxed);
+        stats->allocation_count = counters->allocation_count.load(std::memory_order_relaxed);
+        stats->total_calls = counters->total_calls.load(std::memory_order_relaxed);
+        stats->calls_last_frame = counters->calls_last_frame.load(std::memory_order_relaxed);
+        stats->internal_bytes = counters->internal_bytes.load(std::memory_order_relaxed);
+    }
+    out_stats->pooled_bytes = state->pooled_bytes.load(std::memory_order_relaxed);
+    return BC_TRUE;
+}
@@ -0,0 +1,47 @@
+#ifndef VULKAN_NOTES_1704115530_VULKAN_HOST_ALLOCATOR_H
+#define VULKAN_NOTES_1704115530_VULKAN_HOST_ALLOCATOR_H
+
+#include "vulkan_types.h"
+
+/*
+VkAllocationCallbacks for the host memory of the driver.
+Small allocations (up to 4 KiB with the header, at most 16 byte aligned) come from size class pools:
+power of two chunks carved from 64 KiB pages and recycled through a free list per class, so the
+allocations the driver makes over and over (i.e. while creating pipelines or recreating the swapchain)
+stop hitting malloc once the pools are warm. Pages are kept until the allocator is destroyed.
+Bigger or more aligned allocations go to malloc.
+
+Every allocation has a 16 byte header in front of it with its size, class and scope, so frees and
+reallocations know where it came from and the stats are kept per VkSystemAllocationScope.
+The callbacks can be called from any thread.
+*/
+
+/**
+ * Creates the allocator. The callbacks should be passed to every Vulkan call from vkCreateInstance
+ * to vkDestroyInstance.
+ */
+void vulkan_host_allocator_create();
+
+/**
+ * Destroys the allocator and its pages. Reports allocations the driver did not free.
+ */
+void vulkan_host_allocator_destroy();
+
+/**
+ * @returns The allocation callbacks or NULL if the allocator is not created.
+ */
+VkAllocationCallbacks *vulkan_host_allocator_callbacks();
+
+/**
+ * Closes the per frame call counters of the previous frame. Should be called once at the start of each frame.
+ * @returns The number of calls made during the previous frame, all scopes together.
+ */
+u32 vulkan_host_allocator_begin_frame();
+
+/**
+ * Gets the current stats.
+ * @returns True if the allocator is created; otherwise false.
+ */
+b8 vulkan_host_allocator_get_stats(renderer_host_memory_stats *out_stats);
+
+#endif
@@ -0,0 +1,128 @@
+#include "vulkan_image.h"
+#include "vulkan_memory.h"
+#include "vulkan_deletion_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Mostly tile based GPUs have such memory
+static b8 has_lazily_allocated_memory(vulkan_context *context)
+{
+    const VkPhysicalDeviceMemoryProperties *memory_properties = &context->device.memory_properties;
+    for (u32 i = 0; i < memory_properties->memoryTypeCount; ++i)
+    {
+        if (memory_properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+            return BC_TRUE;
+    }
+    return BC_FALSE;
+}
+
+b8 vulkan_image_create(
+    vulkan_context *context, u32 width, u32 height, VkFormat format, VkSampleCountFlagBits samples,
+    VkImageUsageFlags usage, VkImageAspectFlags aspect, vulkan_image *out_image)
+{
+    memset(out_image, 0, sizeof(vulkan_image));
+    out_image->format = format;
+    out_image->aspect = aspect;
+    out_image->width = width;
+    out_image->height = height;
+
+    VkImageCreateInfo image_create_info = {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = format;
+    image_create_info.extent = {width, height, 1};
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = samples;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = usage;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(context->device.logical_device, &image_create_info, context->allocator, &out_image->handle) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_image_create - Failed to create image.\n");
+        return BC_FALSE;
+    }
+
+    // Not every device has lazily allocated memory, or enough of it
+    b8 allocated = BC_FALSE;
+    if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && has_lazily_allocated_memory(context))
+        allocated = vulkan_memory_allocate_image(
+            context, &context->memory, out_image->handle,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &out_image->allocation);
+    if (!allocated)
+        allocated = vulkan_memory_allocate_image(context, &context->memory, out_image->handle, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &out_image->allocation);
+    if (!allocated)
+    {
+        printf("ERROR: vulkan_image_create - Failed to allocate image memory.\n");
+        vulkan_image_destroy(context, out_image);
+        return BC_FALSE;
+    }
+
+    VkImageViewCreateInfo view_create_info = {};
+    view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_create_info.image = out_image->handle;
+    view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_create_info.format = format;
+    view_create_info.subresourceRange.aspectMask = aspect;
+    view_create_info.subresourceRange.baseMipLevel = 0;
+    view_create_info.subresourceRange.levelCount = 1;
+    view_create_info.subresourceRange.baseArrayLayer = 0;
+    view_create_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(context->device.logical_device, &view_create_info, context->allocator, &out_image->view) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_image_create - Failed to create image view.\n");
+        vulkan_image_destroy(context, out_image);
+        return BC_FALSE;
+    }
+
+    return BC_TRUE;
+}
+
+void vulkan_image_destroy(vulkan_context *context, vulkan_image *image)
+{
+    if (image->view)
+        vkDestroyImageView(context->device.logical_device, image->view, context->allocator);
+    if (image->handle)
+        vkDestroyImage(context->device.logical_device, image->handle, context->allocator);
+    vulkan_memory_free(context, &context->memory, &image->allocation);
+
+    memset(image, 0, sizeof(vulkan_image));
+}
+
+void vulkan_image_retire(vulkan_context *context, vulkan_image *image, u64 retire_value)
+{
+    if (image->view)
+        vulkan_deletion_queue_push(&context->deletion_queue, VULKAN_DELETION_IMAGE_VIEW, (u64)image->view, retire_value);
+    if (image->handle)
+    {
+        vulkan_deletion_queue_push(&context->deletion_queue, VULKAN_DELETION_IMAGE, (u64)image->handle, retire_value);
+        vulkan_deletion_queue_push_allocation(&context->deletion_queue, &image->allocation, retire_value);
+    }
+
+    memset(image, 0, sizeof(vulkan_image));
+}
+
+void vulkan_image_barrier(
+    VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
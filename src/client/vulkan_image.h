@@ -0,0 +1,59 @@
+#ifndef VULKAN_NOTES_1704540312_VULKAN_IMAGE_H
+#define VULKAN_NOTES_1704540312_VULKAN_IMAGE_H
+
+#include "vulkan_types.h"
+
+/*
+Render targets owned by the renderer (depth buffer and the like): a 2D optimal tiling image with device local
+memory from the context's memory allocator and a view over all of it. They are sized after the swapchain, so
+they are retired to the deletion queue and created anew whenever it is recreated.
+
+Transient attachments (VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT: never loaded nor stored, i.e. multisampled
+targets resolved in the pass) get lazily allocated memory when the device has some. On tile based GPUs they
+then live in tile memory only, and take no memory at all.
+*/
+
+/**
+ * Creates a 2D image, one mip level and one layer, and its view.
+ * @param context A pointer to the vulkan context.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param format The format of the image.
+ * @param samples The number of samples per pixel.
+ * @param usage The usage flags of the image. Lazily allocated memory is used for transient attachments if possible.
+ * @param aspect The aspects of the view, i.e. VK_IMAGE_ASPECT_DEPTH_BIT.
+ * @param out_image A pointer to the image to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_image_create(
+    vulkan_context *context, u32 width, u32 height, VkFormat format, VkSampleCountFlagBits samples,
+    VkImageUsageFlags usage, VkImageAspectFlags aspect, vulkan_image *out_image);
+
+/**
+ * Destroys the view and the image and frees its memory right away. The GPU should be done with it.
+ */
+void vulkan_image_destroy(vulkan_context *context, vulkan_image *image);
+
+/**
+ * Hands the view, the image and its memory over to the context's deletion queue, frames in flight may still use them.
+ * @param retire_value The number of frames which have to complete before they can be destroyed.
+ */
+void vulkan_image_retire(vulkan_context *context, vulkan_image *image, u64 retire_value);
+
+/**
+ * Records a layout transition of the whole image.
+ * @param command_buffer The command buffer.
+ * @param image The image.
+ * @param aspect The aspects of the image.
+ * @param old_layout The current layout, VK_IMAGE_LAYOUT_UNDEFINED to discard the contents.
+ * @param new_layout The layout to transition to.
+ * @param src_access The accesses to make available.
+ * @param dst_access The accesses to make visible.
+ * @param src_stages The stages to wait for.
+ * @param dst_stages The stages which wait.
+ */
+void vulkan_image_barrier(
+    VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages);
+
+#endif
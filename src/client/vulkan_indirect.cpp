@@ -0,0 +1,155 @@
+#include "vulkan_indirect.h"
+#include "vulkan_buffer.h"
+#include "vulkan_compute.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+b8 vulkan_indirect_create(
+    vulkan_context *context, const vulkan_compute *compute, u32 frame_count, u32 command_capacity, u32 batch_capacity,
+    b8 gpu_culled, vulkan_indirect_draws *out_draws)
+{
+    memset(out_draws, 0, sizeof(vulkan_indirect_draws));
+    out_draws->frame_count = frame_count;
+    out_draws->command_capacity = command_capacity;
+    out_draws->batch_capacity = batch_capacity;
+    out_draws->batches = (vulkan_draw_batch *)(malloc(sizeof(vulkan_draw_batch) * batch_capacity));
+
+    out_draws->multi_draw = context->device.features.multiDrawIndirect;
+    out_draws->use_draw_count = out_draws->multi_draw && context->device.features12.drawIndirectCount;
+    out_draws->use_first_instance = context->device.features.drawIndirectFirstInstance;
+    out_draws->gpu_culled = gpu_culled && out_draws->use_first_instance;
+
+    VkDeviceSize commands_size = sizeof(VkDrawIndexedIndirectCommand) * command_capacity;
+    VkDeviceSize counts_size = sizeof(u32) * batch_capacity;
+    // Also read by the culling passes, possibly on the compute queue
+    VkBufferUsageFlags commands_usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | (out_draws->gpu_culled ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+    for (u32 i = 0; i < frame_count; ++i)
+    {
+        vulkan_indirect_frame *frame = &out_draws->frames[i];
+        if (!vulkan_compute_buffer_create(
+                context, compute, commands_size, commands_usage,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->commands) ||
+            !vulkan_buffer_create(
+                context, counts_size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->counts))
+        {
+            printf("ERROR: vulkan_indirect_create - Failed to create the indirect buffers.\n");
+            return BC_FALSE;
+        }
+
+        if (!out_draws->gpu_culled)
+            continue;
+        // The counts are cleared before each culling
+        if (!vulkan_compute_buffer_create(
+                context, compute, commands_size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->culled_commands) ||
+            !vulkan_compute_buffer_create(
+                context, compute, counts_size,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->culled_counts))
+        {
+            printf("ERROR: vulkan_indirect_create - Failed to create the culled indirect buffers.\n");
+            return BC_FALSE;
+        }
+    }
+
+    return BC_TRUE;
+}
+
+void vulkan_indirect_destroy(vulkan_context *context, vulkan_indirect_draws *draws)
+{
+    for (u32 i = 0; i < draws->frame_count; ++i)
+    {
+        vulkan_buffer_destroy(context, &draws->frames[i].commands);
+        vulkan_buffer_destroy(context, &draws->frames[i].counts);
+        vulkan_buffer_destroy(context, &draws->frames[i].culled_commands);
+        vulkan_buffer_destroy(context, &draws->frames[i].culled_counts);
+    }
+    free(draws->batches);
+
+    memset(draws, 0, sizeof(vulkan_indirect_draws));
+}
+
+void vulkan_indirect_begin_frame(vulkan_indirect_draws *draws, u32 frame_slot)
+{
+    draws->current_frame = frame_slot;
+    draws->command_count = 0;
+    draws->batch_count = 0;
+}
+
+i32 vulkan_indirect_begin_batch(vulkan_indirect_draws *draws, VkPipeline pipeline)
+{
+    if (draws->batch_count == draws->batch_capacity)
+        return -1;
+
+    vulkan_draw_batch *batch = &draws->batches[draws->batch_count];
+    batch->pipeline = pipeline;
+    batch->first_command = draws->command_count;
+    batch->command_count = 0;
+
+    u32 *counts = (u32 *)draws->frames[draws->current_frame].counts.mapped;
+    counts[draws->batch_count] = 0;
+    return (i32)draws->batch_count++;
+}
+
+b8 vulkan_indirect_add_draw(vulkan_indirect_draws *draws, const vulkan_mesh *mesh, u32 instance_count, u32 first_instance)
+{
+    if (!draws->batch_count || draws->command_count == draws->command_capacity)
+        return BC_FALSE;
+
+    vulkan_indirect_frame *frame = &draws->frames[draws->current_frame];
+    VkDrawIndexedIndirectCommand *command = (VkDrawIndexedIndirectCommand *)frame->commands.mapped + draws->command_count++;
+    command->indexCount = mesh->index_count;
+    command->instanceCount = instance_count;
+    command->firstIndex = mesh->first_index;
+    command->vertexOffset = mesh->vertex_offset;
+    command->firstInstance = first_instance;
+
+    u32 batch_index = draws->batch_count - 1;
+    u32 *counts = (u32 *)frame->counts.mapped;
+    counts[batch_index] = ++draws->batches[batch_index].command_count;
+    return BC_TRUE;
+}
+
+void vulkan_indirect_draw_batch(const vulkan_indirect_draws *draws, VkCommandBuffer command_buffer, u32 batch_index)
+{
+    vulkan_indirect_draw_batch_with_pipeline(draws, command_buffer, batch_index, draws->batches[batch_index].pipeline);
+}
+
+void vulkan_indirect_draw_batch_with_pipeline(
+    const vulkan_indirect_draws *draws, VkCommandBuffer command_buffer, u32 batch_index, VkPipeline pipeline)
+{
+    const vulkan_draw_batch *batch = &draws->batches[batch_index];
+    const vulkan_indirect_frame *frame = &draws->frames[draws->current_frame];
+    if (!batch->command_count)
+        return;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    const u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize offset = (VkDeviceSize)batch->first_command * stride;
+    VkBuffer commands = draws->gpu_culled ? frame->culled_commands.handle : frame->commands.handle;
+    VkBuffer counts = draws->gpu_culled ? frame->culled_counts.handle : frame->counts.handle;
+    if (!draws->use_first_instance)
+    {
+        // Rare (mostly older mobile GPUs), the mapped commands are read back once per batch
+        const VkDrawIndexedIndirectCommand *mapped = (const VkDrawIndexedIndirectCommand *)frame->commands.mapped + batch->first_command;
+        for (u32 i = 0; i < batch->command_count; ++i)
+            vkCmdDrawIndexed(
+                command_buffer, mapped[i].indexCount, mapped[i].instanceCount,
+                mapped[i].firstIndex, mapped[i].vertexOffset, mapped[i].firstInstance);
+    }
+    else if (draws->use_draw_count)
+        vkCmdDrawIndexedIndirectCount(
+            command_buffer, commands, offset,
+            counts, sizeof(u32) * batch_index, batch->command_count, stride);
+    else if (draws->multi_draw)
+        vkCmdDrawIndexedIndirect(command_buffer, commands, offset, batch->command_count, stride);
+    else
+    {
+        for (u32 i = 0; i < batch->command_count; ++i)
+            vkCmdDrawIndexedIndirect(command_buffer, commands, offset + (VkDeviceSize)i * stride, 1, stride);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef VULKAN_NOTES_1704201867_VULKAN_INDIRECT_H
+#define VULKAN_NOTES_1704201867_VULKAN_INDIRECT_H
+
+#include "vulkan_types.h"
+
+/*
+The draws of a frame are written into the frame's indirect command buffer, one instanced
+VkDrawIndexedIndirectCommand per mesh, and grouped into batches by pipeline. Each batch is then recorded
+with a single vkCmdDrawIndexedIndirectCount (or vkCmdDrawIndexedIndirect) call, whatever the number of
+objects it draws.
+
+The draw count of each batch is also written into the counts buffer. With GPU culling the commands are
+only the input of the culling passes, which write the visible instance count of each command into
+culled_commands (compacted, with the draw count of each batch in culled_counts), and those are drawn instead.
+
+Devices without multiDrawIndirect get one indirect call per command, and devices without
+drawIndirectFirstInstance get the same instanced draws recorded directly from the mapped commands.
+*/
+
+/**
+ * Creates the indirect buffers of each frame in flight.
+ * @param context A pointer to the vulkan context.
+ * @param compute A pointer to the compute state, the buffers are shared with its queue.
+ * @param frame_count The number of frames in flight.
+ * @param command_capacity The maximum number of indirect commands per frame.
+ * @param batch_capacity The maximum number of batches (pipelines) per frame.
+ * @param gpu_culled Create the buffers written by the GPU culling and draw from them. Requires drawIndirectFirstInstance.
+ * @param out_draws A pointer to the draws to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_indirect_create(
+    vulkan_context *context, const vulkan_compute *compute, u32 frame_count, u32 command_capacity, u32 batch_capacity,
+    b8 gpu_culled, vulkan_indirect_draws *out_draws);
+
+/**
+ * Destroys the buffers. The GPU should be done with them.
+ */
+void vulkan_indirect_destroy(vulkan_context *context, vulkan_indirect_draws *draws);
+
+/**
+ * Clears the draws to write the ones of the frame slot. The GPU should be done with the previous use of the slot.
+ * @param frame_slot The index of the frame in flight.
+ */
+void vulkan_indirect_begin_frame(vulkan_indirect_draws *draws, u32 frame_slot);
+
+/**
+ * Starts a batch, the next draws are drawn with pipeline.
+ * @returns The index of the batch or -1 if there is no room for it.
+ */
+i32 vulkan_indirect_begin_batch(vulkan_indirect_draws *draws, VkPipeline pipeline);
+
+/**
+ * Adds an instanced draw of a mesh to the current batch.
+ * @param draws A pointer to the draws.
+ * @param mesh The mesh to draw, from the geometry bound while drawing.
+ * @param instance_count The number of instances.
+ * @param first_instance The instance index of the first instance (gl_InstanceIndex).
+ * @returns True if added; false if there is no batch or no room for the command.
+ */
+b8 vulkan_indirect_add_draw(vulkan_indirect_draws *draws, const vulkan_mesh *mesh, u32 instance_count, u32 first_instance);
+
+/**
+ * Binds the pipeline of a batch and records its draws. Can be called from any thread.
+ * @param draws A pointer to the draws.
+ * @param command_buffer The command buffer, in the render pass, with the geometry bound.
+ * @param batch_index The index of the batch.
+ */
+void vulkan_indirect_draw_batch(const vulkan_indirect_draws *draws, VkCommandBuffer command_buffer, u32 batch_index);
+
+/**
+ * Records the draws of a batch with another pipeline than its own, i.e. a depth only one. Can be called from any thread.
+ * @param pipeline The pipeline, with the same vertex inputs and layout as the one of the batch.
+ */
+void vulkan_indirect_draw_batch_with_pipeline(
+    const vulkan_indirect_draws *draws, VkCommandBuffer command_buffer, u32 batch_index, VkPipeline pipeline);
+
+#endif
@@ -0,0 +1,590 @@
+#include "vulkan_memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define MEMORY_ALIGNMENT ((VkDeviceSize)1 << VULKAN_MEMORY_ALIGN_SHIFT)
+#define SMALL_SIZE ((VkDeviceSize)1 << VULKAN_MEMORY_FL_SHIFT)
+// Upper bound of the block size, smaller heaps get blocks of an eighth of their size
+#define DEFAULT_BLOCK_SIZE ((VkDeviceSize)64 << 20)
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Index of the lowest set bit, value should not be 0
+static inline u32 bit_scan_forward(u64 value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(value);
+#endif
+}
+
+// Index of the highest set bit, value should not be 0
+static inline u32 bit_scan_reverse(u64 value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#else
+    return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+i32 vulkan_memory_find_type_index(vulkan_context *context, u32 type_filter, VkMemoryPropertyFlags property_flags)
+{
+    const VkPhysicalDeviceMemoryProperties *memory_properties = &context->device.memory_properties;
+    for (u32 i = 0; i < memory_properties->memoryTypeCount; ++i)
+    {
+        // Check each memory type to see if its bit is set to 1.
+        if (type_filter & (1 << i) && (memory_properties->memoryTypes[i].propertyFlags & property_flags) == property_flags)
+            return (i32)i;
+    }
+
+    printf("WARNING: Unable to find suitable memory type!\n");
+    return -1;
+}
+
+//--------------
+// TLSF
+//--------------
+// Size class of a free range of the given size
+static void mapping_insert(VkDeviceSize size, u32 *out_fl, u32 *out_sl)
+{
+    if (size < SMALL_SIZE)
+    {
+        // Classes of the small sizes are exact
+        *out_fl = 0;
+        *out_sl = (u32)(size >> VULKAN_MEMORY_ALIGN_SHIFT);
+        return;
+    }
+
+    u32 msb = bit_scan_reverse(size);
+    *out_sl = (u32)(size >> (msb - VULKAN_MEMORY_SL_BITS)) ^ VULKAN_MEMORY_SL_COUNT;
+    *out_fl = msb - VULKAN_MEMORY_FL_SHIFT + 1;
+}
+
+// Smallest size class whose free ranges all fit size
+static void mapping_search(VkDeviceSize size, u32 *out_fl, u32 *out_sl)
+{
+    if (size >= SMALL_SIZE)
+        size += ((VkDeviceSize)1 << (bit_scan_reverse(size) - VULKAN_MEMORY_SL_BITS)) - 1;
+    mapping_insert(size, out_fl, out_sl);
+}
+
+static u32 node_acquire(vulkan_memory_block *block)
+{
+    if (block->first_unused_node != VULKAN_MEMORY_NIL)
+    {
+        u32 index = block->first_unused_node;
+        block->first_unused_node = block->nodes[index].next_free;
+        return index;
+    }
+
+    if (block->node_count == block->node_capacity)
+    {
+        block->node_capacity = block->node_capacity ? block->node_capacity * 2 : 64;
+        block->nodes = (vulkan_memory_node *)realloc(block->nodes, sizeof(vulkan_memory_node) * block->node_capacity);
+    }
+    return block->node_count++;
+}
+
+static void node_release(vulkan_memory_block *block, u32 index)
+{
+    block->nodes[index].next_free = block->first_unused_node;
+    block->first_unused_node = index;
+}
+
+static void insert_free(vulkan_memory_block *block, u32 index)
+{
+    vulkan_memory_node *node = &block->nodes[index];
+    u32 fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+
+    u32 head = block->free_heads[fl][sl];
+    node->free = BC_TRUE;
+    node->prev_free = VULKAN_MEMORY_NIL;
+    node->next_free = head;
+    if (head != VULKAN_MEMORY_NIL)
+        block->nodes[head].prev_free = index;
+    block->free_heads[fl][sl] = index;
+
+    block->fl_bitmap |= (u64)1 << fl;
+    block->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void remove_free(vulkan_memory_block *block, u32 index)
+{
+    vulkan_memory_node *node = &block->nodes[index];
+    u32 fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+
+    if (node->prev_free != VULKAN_MEMORY_NIL)
+        block->nodes[node->prev_free].next_free = node->next_free;
+    else
+        block->free_heads[fl][sl] = node->next_free;
+    if (node->next_free != VULKAN_MEMORY_NIL)
+        block->nodes[node->next_free].prev_free = node->prev_free;
+
+    if (block->free_heads[fl][sl] == VULKAN_MEMORY_NIL)
+    {
+        block->sl_bitmap[fl] &= ~(1u << sl);
+        if (!block->sl_bitmap[fl])
+            block->fl_bitmap &= ~((u64)1 << fl);
+    }
+    node->free = BC_FALSE;
+}
+
+// A free node of at least the size of the class, VULKAN_MEMORY_NIL if there is none
+static u32 find_suitable(vulkan_memory_block *block, u32 fl, u32 sl)
+{
+    u32 sl_map = block->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map)
+    {
+        if (fl + 1 >= VULKAN_MEMORY_FL_COUNT)
+            return VULKAN_MEMORY_NIL;
+        u64 fl_map = block->fl_bitmap & (~(u64)0 << (fl + 1));
+        if (!fl_map)
+            return VULKAN_MEMORY_NIL;
+        fl = bit_scan_forward(fl_map);
+        sl_map = block->sl_bitmap[fl];
+    }
+    return block->free_heads[fl][bit_scan_forward(sl_map)];
+}
+
+// Splits size bytes starting at offset off the back of the node, the rest becomes a free node after it
+static void split_back(vulkan_memory_block *block, u32 index, VkDeviceSize size)
+{
+    u32 rest = node_acquire(block);
+    vulkan_memory_node *node = &block->nodes[index];
+    vulkan_memory_node *rest_node = &block->nodes[rest];
+
+    rest_node->offset = node->offset + size;
+    rest_node->size = node->size - size;
+    rest_node->prev_physical = index;
+    rest_node->next_physical = node->next_physical;
+    if (node->next_physical != VULKAN_MEMORY_NIL)
+        block->nodes[node->next_physical].prev_physical = rest;
+    node->next_physical = rest;
+    node->size = size;
+
+    insert_free(block, rest);
+}
+
+static b8 block_allocate(vulkan_memory_block *block, VkDeviceSize size, VkDeviceSize alignment, u32 *out_node)
+{
+    // Offsets are always MEMORY_ALIGNMENT aligned, bigger alignments need room for the padding
+    VkDeviceSize search_size = size + (alignment > MEMORY_ALIGNMENT ? alignment - MEMORY_ALIGNMENT : 0);
+    if (search_size > block->size - block->used)
+        return BC_FALSE;
+
+    u32 fl, sl;
+    mapping_search(search_size, &fl, &sl);
+    if (fl >= VULKAN_MEMORY_FL_COUNT)
+        return BC_FALSE;
+    u32 index = find_suitable(block, fl, sl);
+    if (index == VULKAN_MEMORY_NIL)
+        return BC_FALSE;
+    remove_free(block, index);
+
+    // The padding becomes a free node of its own. The previous node is in use, free neighbours are always merged.
+    VkDeviceSize padding = align_up(block->nodes[index].offset, alignment) - block->nodes[index].offset;
+    if (padding)
+    {
+        split_back(block, index, padding);
+        u32 front = index;
+        index = block->nodes[front].next_physical;
+        remove_free(block, index);
+        insert_free(block, front);
+    }
+
+    if (block->nodes[index].size - size >= MEMORY_ALIGNMENT)
+        split_back(block, index, size);
+
+    block->used += block->nodes[index].size;
+    *out_node = index;
+    return BC_TRUE;
+}
+
+static void block_free(vulkan_memory_block *block, u32 index)
+{
+    vulkan_memory_node *node = &block->nodes[index];
+    block->used -= node->size;
+
+    u32 prev = node->prev_physical;
+    if (prev != VULKAN_MEMORY_NIL && block->nodes[prev].free)
+    {
+        remove_free(block, prev);
+        vulkan_memory_node *prev_node = &block->nodes[prev];
+        prev_node->size += node->size;
+        prev_node->next_physical = node->next_physical;
+        if (node->next_physical != VULKAN_MEMORY_NIL)
+            block->nodes[node->next_physical].prev_physical = prev;
+        node_release(block, index);
+        index = prev;
+        node = prev_node;
+    }
+
+    u32 next = node->next_physical;
+    if (next != VULKAN_MEMORY_NIL && block->nodes[next].free)
+    {
+        remove_free(block, next);
+        vulkan_memory_node *next_node = &block->nodes[next];
+        node->size += next_node->size;
+        node->next_physical = next_node->next_physical;
+        if (next_node->next_physical != VULKAN_MEMORY_NIL)
+            block->nodes[next_node->next_physical].prev_physical = index;
+        node_release(block, next);
+    }
+
+    insert_free(block, index);
+}
+
+//--------------
+// Device memory
+//--------------
+static b8 allocate_device_memory(
+    vulkan_context *context, vulkan_memory_allocator *allocator, VkDeviceSize size, u32 memory_type_index,
+    const void *next, VkDeviceMemory *out_memory, void **out_mapped)
+{
+    if (allocator->device_allocation_count >= context->device.properties.limits.maxMemoryAllocationCount)
+    {
+        printf("ERROR: vulkan_memory - maxMemoryAllocationCount reached.\n");
+        return BC_FALSE;
+    }
+
+    VkMemoryAllocateInfo memory_allocate_info = {};
+    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_allocate_info.pNext = next;
+    memory_allocate_info.allocationSize = size;
+    memory_allocate_info.memoryTypeIndex = memory_type_index;
+
+    VkResult result = vkAllocateMemory(context->device.logical_device, &memory_allocate_info, context->allocator, out_memory);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_memory - Failed to allocate %llu bytes of device memory.\n", (unsigned long long)size);
+        return BC_FALSE;
+    }
+
+    *out_mapped = NULL;
+    if (context->device.memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        result = vkMapMemory(context->device.logical_device, *out_memory, 0, VK_WHOLE_SIZE, 0, out_mapped);
+        if (result != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_memory - Failed to map device memory.\n");
+            vkFreeMemory(context->device.logical_device, *out_memory, context->allocator);
+            return BC_FALSE;
+        }
+    }
+
+    ++allocator->device_allocation_count;
+    return BC_TRUE;
+}
+
+static void free_device_memory(vulkan_context *context, vulkan_memory_allocator *allocator, VkDeviceMemory memory)
+{
+    // Freeing the memory unmaps it
+    vkFreeMemory(context->device.logical_device, memory, context->allocator);
+    --allocator->device_allocation_count;
+}
+
+static b8 pool_add_block(vulkan_context *context, vulkan_memory_allocator *allocator, vulkan_memory_pool *pool)
+{
+    vulkan_memory_block block = {};
+    if (!allocate_device_memory(context, allocator, pool->block_size, pool->memory_type_index, NULL, &block.memory, &block.mapped))
+        return BC_FALSE;
+
+    block.size = pool->block_size;
+    block.first_unused_node = VULKAN_MEMORY_NIL;
+    memset(block.free_heads, 0xFF, sizeof(block.free_heads));
+
+    u32 index = node_acquire(&block);
+    vulkan_memory_node *node = &block.nodes[index];
+    node->offset = 0;
+    node->size = block.size;
+    node->prev_physical = node->next_physical = VULKAN_MEMORY_NIL;
+    insert_free(&block, index);
+
+    if (pool->block_count == pool->block_capacity)
+    {
+        pool->block_capacity = pool->block_capacity ? pool->block_capacity * 2 : 4;
+        pool->blocks = (vulkan_memory_block *)realloc(pool->blocks, sizeof(vulkan_memory_block) * pool->block_capacity);
+    }
+    pool->blocks[pool->block_count++] = block;
+    return BC_TRUE;
+}
+
+static b8 allocate_dedicated(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    u32 memory_type_index, VkBuffer buffer, VkImage image, vulkan_allocation *out_allocation)
+{
+    // Lets the driver optimize for the resource, core since Vulkan 1.1
+    VkMemoryDedicatedAllocateInfo dedicated_info = {};
+    dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicated_info.buffer = buffer;
+    dedicated_info.image = image;
+    b8 use_dedicated_info = (buffer || image) && context->device.properties.apiVersion >= VK_API_VERSION_1_1;
+
+    if (!allocate_device_memory(context, allocator, requirements->size, memory_type_index,
+                                use_dedicated_info ? &dedicated_info : NULL, &out_allocation->memory, &out_allocation->mapped))
+        return BC_FALSE;
+
+    out_allocation->offset = 0;
+    out_allocation->size = requirements->size;
+    out_allocation->dedicated = BC_TRUE;
+    out_allocation->pool = out_allocation->block = out_allocation->node = VULKAN_MEMORY_NIL;
+    return BC_TRUE;
+}
+
+static b8 allocate_internal(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags property_flags, b8 optimal_tiling, b8 dedicated, VkBuffer buffer, VkImage image,
+    vulkan_allocation *out_allocation)
+{
+    memset(out_allocation, 0, sizeof(vulkan_allocation));
+
+    i32 memory_type_index = vulkan_memory_find_type_index(context, requirements->memoryTypeBits, property_flags);
+    if (memory_type_index == -1)
+        return BC_FALSE;
+
+    u32 pool_index = (u32)memory_type_index * 2 + (optimal_tiling ? 1 : 0);
+    vulkan_memory_pool *pool = &allocator->pools[pool_index];
+    // Lazily allocated memory is committed as the tiles need it, a block shared by several images would defeat it
+    if (property_flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+        dedicated = BC_TRUE;
+    if (dedicated || requirements->size >= allocator->dedicated_threshold || requirements->size > pool->block_size / 2)
+        return allocate_dedicated(context, allocator, requirements, (u32)memory_type_index, buffer, image, out_allocation);
+
+    VkDeviceSize size = align_up(requirements->size, MEMORY_ALIGNMENT);
+    VkDeviceSize alignment = requirements->alignment > MEMORY_ALIGNMENT ? requirements->alignment : MEMORY_ALIGNMENT;
+
+    u32 node = VULKAN_MEMORY_NIL;
+    u32 block_index = 0;
+    for (; block_index < pool->block_count; ++block_index)
+    {
+        if (block_allocate(&pool->blocks[block_index], size, alignment, &node))
+            break;
+    }
+    if (node == VULKAN_MEMORY_NIL)
+    {
+        if (!pool_add_block(context, allocator, pool))
+            return BC_FALSE;
+        block_index = pool->block_count - 1;
+        if (!block_allocate(&pool->blocks[block_index], size, alignment, &node))
+            return BC_FALSE;
+    }
+
+    vulkan_memory_block *block = &pool->blocks[block_index];
+    out_allocation->memory = block->memory;
+    out_allocation->offset = block->nodes[node].offset;
+    out_allocation->size = size;
+    out_allocation->mapped = block->mapped ? (u8 *)block->mapped + out_allocation->offset : NULL;
+    out_allocation->dedicated = BC_FALSE;
+    out_allocation->pool = pool_index;
+    out_allocation->block = block_index;
+    out_allocation->node = node;
+    return BC_TRUE;
+}
+
+void vulkan_memory_allocator_create(vulkan_context *context, vulkan_memory_allocator *out_allocator)
+{
+    memset(out_allocator, 0, sizeof(vulkan_memory_allocator));
+    out_allocator->dedicated_threshold = DEFAULT_BLOCK_SIZE / 2;
+
+    const VkPhysicalDeviceMemoryProperties *memory_properties = &context->device.memory_properties;
+    for (u32 i = 0; i < memory_properties->memoryTypeCount; ++i)
+    {
+        VkDeviceSize heap_size = memory_properties->memoryHeaps[memory_properties->memoryTypes[i].heapIndex].size;
+        VkDeviceSize block_size = heap_size / 8 < DEFAULT_BLOCK_SIZE ? align_up(heap_size / 8, MEMORY_ALIGNMENT) : DEFAULT_BLOCK_SIZE;
+        for (u32 tiling = 0; tiling < 2; ++tiling)
+        {
+            vulkan_memory_pool *pool = &out_allocator->pools[i * 2 + tiling];
+            pool->memory_type_index = i;
+            pool->optimal_tiling = tiling;
+            pool->block_size = block_size;
+        }
+    }
+}
+
+void vulkan_memory_allocator_destroy(vulkan_context *context, vulkan_memory_allocator *allocator)
+{
+    for (u32 i = 0; i < VK_MAX_MEMORY_TYPES * 2; ++i)
+    {
+        vulkan_memory_pool *pool = &allocator->pools[i];
+        for (u32 j = 0; j < pool->block_count; ++j)
+        {
+            if (pool->blocks[j].used)
+                printf("WARNING: vulkan_memory - %llu bytes still allocated from memory type %u.\n",
+                       (unsigned long long)pool->blocks[j].used, pool->memory_type_index);
+            free_device_memory(context, allocator, pool->blocks[j].memory);
+            free(pool->blocks[j].nodes);
+        }
+        free(pool->blocks);
+    }
+
+    if (allocator->device_allocation_count)
+        printf("WARNING: vulkan_memory - %u dedicated allocations were not freed.\n", allocator->device_allocation_count);
+    memset(allocator, 0, sizeof(vulkan_memory_allocator));
+}
+
+b8 vulkan_memory_allocate(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags property_flags, b8 optimal_tiling, b8 dedicated, vulkan_allocation *out_allocation)
+{
+    return allocate_internal(context, allocator, requirements, property_flags, optimal_tiling, dedicated,
+                             VK_NULL_HANDLE, VK_NULL_HANDLE, out_allocation);
+}
+
+void vulkan_memory_free(vulkan_context *context, vulkan_memory_allocator *allocator, vulkan_allocation *allocation)
+{
+    if (!allocation->memory)
+        return;
+
+    if (allocation->dedicated)
+        free_device_memory(context, allocator, allocation->memory);
+    else if (allocation->pool != VULKAN_MEMORY_NIL) // Linear allocations are reclaimed with their frame
+        block_free(&allocator->pools[allocation->pool].blocks[allocation->block], allocation->node);
+
+    memset(allocation, 0, sizeof(vulkan_allocation));
+}
+
+b8 vulkan_memory_allocate_buffer(
+    vulkan_context *context, vulkan_memory_allocator *allocator, VkBuffer buffer,
+    VkMemoryPropertyFlags property_flags, vulkan_allocation *out_allocation)
+{
+    VkMemoryRequirements requirements;
+    b8 prefers_dedicated = BC_FALSE;
+    if (context->device.properties.apiVersion >= VK_API_VERSION_1_1)
+    {
+        VkMemoryDedicatedRequirements dedicated_requirements = {};
+        dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements2 = {};
+        requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements2.pNext = &dedicated_requirements;
+        VkBufferMemoryRequirementsInfo2 info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        info.buffer = buffer;
+        vkGetBufferMemoryRequirements2(context->device.logical_device, &info, &requirements2);
+
+        requirements = requirements2.memoryRequirements;
+        prefers_dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+    }
+    else
+        vkGetBufferMemoryRequirements(context->device.logical_device, buffer, &requirements);
+
+    if (!allocate_internal(context, allocator, &requirements, property_flags, BC_FALSE, prefers_dedicated,
+                           buffer, VK_NULL_HANDLE, out_allocation))
+        return BC_FALSE;
+
+    VkResult result = vkBindBufferMemory(context->device.logical_device, buffer, out_allocation->memory, out_allocation->offset);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_memory_allocate_buffer - Failed to bind buffer memory.\n");
+        vulkan_memory_free(context, allocator, out_allocation);
+        return BC_FALSE;
+    }
+    return BC_TRUE;
+}
+
+b8 vulkan_memory_allocate_image(
+    vulkan_context *context, vulkan_memory_allocator *allocator, VkImage image,
+    VkMemoryPropertyFlags property_flags, vulkan_allocation *out_allocation)
+{
+    VkMemoryRequirements requirements;
+    b8 prefers_dedicated = BC_FALSE;
+    if (context->device.properties.apiVersion >= VK_API_VERSION_1_1)
+    {
+        VkMemoryDedicatedRequirements dedicated_requirements = {};
+        dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 requirements2 = {};
+        requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements2.pNext = &dedicated_requirements;
+        VkImageMemoryRequirementsInfo2 info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        info.image = image;
+        vkGetImageMemoryRequirements2(context->device.logical_device, &info, &requirements2);
+
+        requirements = requirements2.memoryRequirements;
+        prefers_dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+    }
+    else
+        vkGetImageMemoryRequirements(context->device.logical_device, image, &requirements);
+
+    if (!allocate_internal(context, allocator, &requirements, property_flags, BC_TRUE, prefers_dedicated,
+                           VK_NULL_HANDLE, image, out_allocation))
+        return BC_FALSE;
+
+    VkResult result = vkBindImageMemory(context->device.logical_device, image, out_allocation->memory, out_allocation->offset);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_memory_allocate_image - Failed to bind image memory.\n");
+        vulkan_memory_free(context, allocator, out_allocation);
+        return BC_FALSE;
+    }
+    return BC_TRUE;
+}
+
+//--------------
+// Linear
+//--------------
+b8 vulkan_linear_allocator_create(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags property_flags, VkDeviceSize frame_size, u32 frame_count, VkDeviceSize padding_size,
+    vulkan_linear_allocator *out_linear)
+{
+    memset(out_linear, 0, sizeof(vulkan_linear_allocator));
+
+    VkMemoryRequirements memory_requirements = *requirements;
+    memory_requirements.size = frame_size * frame_count + padding_size;
+    if (memory_requirements.alignment < context->device.properties.limits.nonCoherentAtomSize)
+        memory_requirements.alignment = context->device.properties.limits.nonCoherentAtomSize;
+    if (!vulkan_memory_allocate(context, allocator, &memory_requirements, property_flags, BC_FALSE, BC_FALSE, &out_linear->allocation))
+        return BC_FALSE;
+
+    out_linear->frame_size = frame_size;
+    out_linear->frame_count = frame_count;
+    return BC_TRUE;
+}
+
+void vulkan_linear_allocator_destroy(vulkan_context *context, vulkan_memory_allocator *allocator, vulkan_linear_allocator *linear)
+{
+    vulkan_memory_free(context, allocator, &linear->allocation);
+    memset(linear, 0, sizeof(vulkan_linear_allocator));
+}
+
+void vulkan_linear_allocator_begin_frame(vulkan_linear_allocator *linear, u32 frame_slot)
+{
+    linear->frame_slot = frame_slot % linear->frame_count;
+    linear->head = 0;
+}
+
+b8 vulkan_linear_allocator_allocate(vulkan_linear_allocator *linear, VkDeviceSize size, VkDeviceSize alignment, vulkan_allocation *out_allocation)
+{
+    VkDeviceSize frame_offset = linear->frame_slot * linear->frame_size;
+    VkDeviceSize offset = align_up(frame_offset + linear->head, alignment ? alignment : 1);
+    if (offset + size > frame_offset + linear->frame_size)
+        return BC_FALSE;
+
+    memset(out_allocation, 0, sizeof(vulkan_allocation));
+    out_allocation->memory = linear->allocation.memory;
+    out_allocation->offset = linear->allocation.offset + offset;
+    out_allocation->size = size;
+    if (linear->allocation.mapped)
+        out_allocation->mapped = (u8 *)linear->allocation.mapped + offset;
+    out_allocation->pool = out_allocation->block = out_allocation->node = VULKAN_MEMORY_NIL;
+
+    linear->head = offset + size - frame_offset;
+    return BC_TRUE;
+}
@@ -0,0 +1,111 @@
+#ifndef VULKAN_NOTES_1704028133_VULKAN_MEMORY_H
+#define VULKAN_NOTES_1704028133_VULKAN_MEMORY_H
+
+#include "vulkan_types.h"
+
+/*
+Device memory is reserved in big blocks per memory type and sub-allocated, so resources do not
+count against maxMemoryAllocationCount and creating or destroying them does not call the driver
+once the blocks exist.
+
+Long lived allocations use a TLSF allocator per block: free ranges are kept in segregated lists
+indexed by a two level bitmap, so finding a fit, splitting and merging with the physical neighbours
+are all O(1). Per frame allocations (i.e. the uniform ring) use vulkan_linear_allocator, a bump pointer per frame in flight.
+Requests of at least dedicated_threshold bytes, or which the driver prefers to be dedicated (i.e. big
+render targets), get their own VkDeviceMemory.
+
+Blocks are kept until the allocator is destroyed, even when they become empty.
+*/
+
+/**
+ * Finds a memory type allowed by type_filter which has all of the given properties.
+ * @param context A pointer to the vulkan context. The physical device should be selected.
+ * @param type_filter VkMemoryRequirements::memoryTypeBits of the resource.
+ * @param property_flags The required memory properties.
+ * @returns The index of the memory type or -1 if there is none.
+ */
+i32 vulkan_memory_find_type_index(vulkan_context *context, u32 type_filter, VkMemoryPropertyFlags property_flags);
+
+/**
+ * Initializes the allocator. No memory is allocated until the first request.
+ * @param context A pointer to the vulkan context. The logical device should be created.
+ * @param out_allocator A pointer to the allocator to be initialized.
+ */
+void vulkan_memory_allocator_create(vulkan_context *context, vulkan_memory_allocator *out_allocator);
+
+/**
+ * Frees every block of the allocator. The allocations should be freed already.
+ */
+void vulkan_memory_allocator_destroy(vulkan_context *context, vulkan_memory_allocator *allocator);
+
+/**
+ * Allocates memory for a resource.
+ * @param context A pointer to the vulkan context.
+ * @param allocator A pointer to the allocator.
+ * @param requirements The memory requirements of the resource.
+ * @param property_flags The required memory properties.
+ * @param optimal_tiling True for optimal tiling images, false for buffers and linear images.
+ * @param dedicated Forces a dedicated VkDeviceMemory.
+ * @param out_allocation A pointer to the allocation to be populated.
+ * @returns True if allocated successfully; otherwise false.
+ */
+b8 vulkan_memory_allocate(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags property_flags, b8 optimal_tiling, b8 dedicated, vulkan_allocation *out_allocation);
+
+/**
+ * Returns the allocation to its block (or frees its memory if dedicated). The GPU should be done with it.
+ */
+void vulkan_memory_free(vulkan_context *context, vulkan_memory_allocator *allocator, vulkan_allocation *allocation);
+
+/**
+ * Allocates and binds memory for a buffer.
+ * @returns True if successful; otherwise false.
+ */
+b8 vulkan_memory_allocate_buffer(
+    vulkan_context *context, vulkan_memory_allocator *allocator, VkBuffer buffer,
+    VkMemoryPropertyFlags property_flags, vulkan_allocation *out_allocation);
+
+/**
+ * Allocates and binds memory for an optimal tiling image. The allocation is dedicated if the driver
+ * prefers it to be.
+ * @returns True if successful; otherwise false.
+ */
+b8 vulkan_memory_allocate_image(
+    vulkan_context *context, vulkan_memory_allocator *allocator, VkImage image,
+    VkMemoryPropertyFlags property_flags, vulkan_allocation *out_allocation);
+
+/**
+ * Creates a per frame linear allocator.
+ * @param context A pointer to the vulkan context.
+ * @param allocator A pointer to the allocator the memory comes from.
+ * @param requirements The memory types allowed and the alignment of the memory, i.e. the requirements of the buffer
+ *        bound to it. The size is ignored.
+ * @param property_flags The required memory properties.
+ * @param frame_size The number of bytes of each frame in flight.
+ * @param frame_count The number of frames in flight.
+ * @param padding_size The number of bytes reserved after the last frame slot, never allocated from (i.e. for
+ *        descriptor ranges reaching past their offset).
+ * @param out_linear A pointer to the linear allocator to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_linear_allocator_create(
+    vulkan_context *context, vulkan_memory_allocator *allocator, const VkMemoryRequirements *requirements,
+    VkMemoryPropertyFlags property_flags, VkDeviceSize frame_size, u32 frame_count, VkDeviceSize padding_size,
+    vulkan_linear_allocator *out_linear);
+
+void vulkan_linear_allocator_destroy(vulkan_context *context, vulkan_memory_allocator *allocator, vulkan_linear_allocator *linear);
+
+/**
+ * Switches to the range of a frame slot and reclaims it. The previous frame using the slot should be complete.
+ */
+void vulkan_linear_allocator_begin_frame(vulkan_linear_allocator *linear, u32 frame_slot);
+
+/**
+ * Bumps an allocation from the range of the current frame slot. It is valid until the slot is begun again.
+ * @param alignment The alignment of the offset, relative to the start of the memory of the linear allocator.
+ * @returns True if it fits; otherwise false.
+ */
+b8 vulkan_linear_allocator_allocate(vulkan_linear_allocator *linear, VkDeviceSize size, VkDeviceSize alignment, vulkan_allocation *out_allocation);
+
+#endif
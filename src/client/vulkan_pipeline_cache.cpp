@@ -0,0 +1,118 @@
+#include "vulkan_pipeline_cache.h"
+#include "file_system.h"
+#include "log_assert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PIPELINE_CACHE_HEADER_SIZE (4 * sizeof(u32) + VK_UUID_SIZE)
+
+static u32 read_u32(const u8 *bytes)
+{
+    // Header fields are stored little endian
+    return (u32)bytes[0] | ((u32)bytes[1] << 8) | ((u32)bytes[2] << 16) | ((u32)bytes[3] << 24);
+}
+
+static b8 is_cache_compatible(vulkan_context *context, const u8 *data, u64 size)
+{
+    if (size < PIPELINE_CACHE_HEADER_SIZE)
+        return BC_FALSE;
+
+    u32 header_size = read_u32(data);
+    u32 header_version = read_u32(data + 4);
+    u32 vendor_id = read_u32(data + 8);
+    u32 device_id = read_u32(data + 12);
+    const u8 *uuid = data + 16;
+
+    const VkPhysicalDeviceProperties *properties = &context->device.properties;
+    return header_size >= PIPELINE_CACHE_HEADER_SIZE && header_size <= size &&
+           header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vendor_id == properties->vendorID &&
+           device_id == properties->deviceID &&
+           memcmp(uuid, properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void vulkan_pipeline_cache_create(vulkan_context *context, const char *path, VkPipelineCache *out_cache)
+{
+    u8 *data = NULL;
+    u64 size = 0;
+
+    file_handle file;
+    if (path && filesystem_exists(path) && filesystem_open(path, FILE_MODE_READ, BC_TRUE, &file))
+    {
+        if (!filesystem_read_all_bytes(&file, &data, &size) || !is_cache_compatible(context, data, size))
+        {
+            printf("Pipeline cache '%s' is invalid or was created by another device/driver. Ignoring it.\n", path);
+            free(data);
+            data = NULL;
+            size = 0;
+        }
+        filesystem_close(&file);
+    }
+
+    VkPipelineCacheCreateInfo create_info = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    create_info.initialDataSize = size;
+    create_info.pInitialData = data;
+
+    VkResult result = vkCreatePipelineCache(context->device.logical_device, &create_info, context->allocator, out_cache);
+    if (result != VK_SUCCESS && data)
+    {
+        // The driver may still reject a blob that passed the header check
+        printf("Failed to create the pipeline cache from '%s'. Starting with an empty one.\n", path);
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = NULL;
+        result = vkCreatePipelineCache(context->device.logical_device, &create_info, context->allocator, out_cache);
+    }
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to create the pipeline cache!\n", "vulkan_pipeline_cache_create::vkCreatePipelineCache");
+
+    free(data);
+}
+
+b8 vulkan_pipeline_cache_save(vulkan_context *context, VkPipelineCache cache, const char *path)
+{
+    if (!path || cache == VK_NULL_HANDLE)
+        return BC_FALSE;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(context->device.logical_device, cache, &size, NULL) != VK_SUCCESS || size == 0)
+        return BC_FALSE;
+
+    u8 *data = (u8 *)malloc(size);
+    if (vkGetPipelineCacheData(context->device.logical_device, cache, &size, data) != VK_SUCCESS)
+    {
+        free(data);
+        return BC_FALSE;
+    }
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    b8 written = BC_FALSE;
+    file_handle file;
+    if (filesystem_open(temp_path, FILE_MODE_WRITE, BC_TRUE, &file))
+    {
+        u64 bytes_written = 0;
+        written = filesystem_write(&file, size, data, &bytes_written);
+        filesystem_close(&file);
+    }
+    free(data);
+
+    if (!written || !filesystem_rename(temp_path, path))
+    {
+        printf("Failed to save the pipeline cache to '%s'.\n", path);
+        filesystem_remove(temp_path);
+        return BC_FALSE;
+    }
+    return BC_TRUE;
+}
+
+void vulkan_pipeline_cache_destroy(vulkan_context *context, VkPipelineCache *cache)
+{
+    if (*cache)
+    {
+        vkDestroyPipelineCache(context->device.logical_device, *cache, context->allocator);
+        *cache = VK_NULL_HANDLE;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef VULKAN_NOTES_1703598618_VULKAN_PIPELINE_CACHE_H
+#define VULKAN_NOTES_1703598618_VULKAN_PIPELINE_CACHE_H
+
+#include "vulkan_types.h"
+
+/*
+The pipeline cache blob starts with a VkPipelineCacheHeaderVersionOne:
+    u32 header size (32), u32 header version, u32 vendor ID, u32 device ID, u8 pipelineCacheUUID[VK_UUID_SIZE]
+A blob written by another driver, driver version or GPU is discarded instead of being handed to the driver.
+*/
+
+/**
+ * Creates the pipeline cache, seeded with the blob at path if it exists and matches the device.
+ * @param context A pointer to the vulkan context. The logical device should be created.
+ * @param path The path of the cache file. Can be NULL to create an empty cache which is not persisted.
+ * @param out_cache A pointer to the pipeline cache to be created.
+ */
+void vulkan_pipeline_cache_create(vulkan_context *context, const char *path, VkPipelineCache *out_cache);
+
+/**
+ * Writes the pipeline cache to path. The blob is written to a temporary file first and then
+ * renamed over path, so an interrupted write never leaves a truncated cache behind.
+ * @param context A pointer to the vulkan context.
+ * @param cache The pipeline cache to be saved.
+ * @param path The path of the cache file.
+ * @returns True if saved successfully; otherwise false.
+ */
+b8 vulkan_pipeline_cache_save(vulkan_context *context, VkPipelineCache cache, const char *path);
+
+void vulkan_pipeline_cache_destroy(vulkan_context *context, VkPipelineCache *cache);
+
+#endif
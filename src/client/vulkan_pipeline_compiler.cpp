@@ -0,0 +1,522 @@
+#include "vulkan_pipeline_compiler.h"
+#include "file_system.h"
+#include "vulkan_deletion_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Rebuild of a compiled pipeline after its shaders changed
+typedef enum pipeline_reload_status
+{
+    PIPELINE_RELOAD_NONE,
+    PIPELINE_RELOAD_QUEUED,
+    // reloaded is written, to be swapped in by the main thread
+    PIPELINE_RELOAD_DONE
+} pipeline_reload_status;
+
+typedef struct pipeline_entry
+{
+    // The shader paths are owned by the entry
+    vulkan_graphics_pipeline_desc desc;
+    // Written by the worker before status is released
+    VkPipeline pipeline;
+    std::atomic<u32> status;
+
+    // Hot reload: the rebuilt pipeline, VK_NULL_HANDLE if it failed to compile
+    VkPipeline reloaded;
+    std::atomic<u32> reload_status;
+    // The shaders changed again during the rebuild, or during the first compilation. Main thread only.
+    b8 reload_again;
+} pipeline_entry;
+
+typedef struct pipeline_compiler_state
+{
+    vulkan_context *context;
+    std::thread *workers;
+    u32 worker_count;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    // Entries never move, so the frames read them without locking
+    pipeline_entry entries[VULKAN_PIPELINE_COMPILER_CAPACITY];
+    // Submitted entries, [next_entry, entry_count) are still queued
+    std::atomic<u32> entry_count;
+    u32 next_entry;
+    u32 completed_count;
+    // Ring of the entries to rebuild, taken after the queued entries
+    u32 reload_queue[VULKAN_PIPELINE_COMPILER_CAPACITY];
+    u32 reload_head;
+    u32 reload_count;
+    // Entries with PIPELINE_RELOAD_DONE
+    std::atomic<u32> pending_swap_count;
+    // Entries whose shaders changed during their first compilation, rebuilt once compiled. Main thread only.
+    u32 deferred_reload_count;
+
+    b8 is_running;
+} pipeline_compiler_state;
+
+static pipeline_compiler_state *state;
+
+static char *copy_string(const char *string)
+{
+    return string ? strdup(string) : NULL;
+}
+
+static VkShaderModule load_shader_module(vulkan_context *context, const char *path)
+{
+    file_handle handle;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &handle))
+    {
+        printf("ERROR: load_shader_module - Unable to open %s.\n", path);
+        return VK_NULL_HANDLE;
+    }
+
+    u64 size = 0;
+    u8 *code = 0;
+    b8 read = filesystem_read_all_bytes(&handle, &code, &size);
+    filesystem_close(&handle);
+    if (!read)
+    {
+        printf("ERROR: load_shader_module - Unable to read %s.\n", path);
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = size;
+    create_info.pCode = (u32 *)code;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(context->device.logical_device, &create_info, context->allocator, &module) != VK_SUCCESS)
+        printf("ERROR: load_shader_module - Failed to create the shader module of %s.\n", path);
+    free(code);
+    return module;
+}
+
+static VkPipeline compile_graphics_pipeline(vulkan_context *context, const vulkan_graphics_pipeline_desc *desc)
+{
+    VkShaderModule vertex_module = load_shader_module(context, desc->vertex_shader_path);
+    VkShaderModule fragment_module = desc->fragment_shader_path ? load_shader_module(context, desc->fragment_shader_path) : VK_NULL_HANDLE;
+    if (!vertex_module || (desc->fragment_shader_path && !fragment_module))
+    {
+        if (vertex_module)
+            vkDestroyShaderModule(context->device.logical_device, vertex_module, context->allocator);
+        if (fragment_module)
+            vkDestroyShaderModule(context->device.logical_device, fragment_module, context->allocator);
+        return VK_NULL_HANDLE;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertex_module;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragment_module;
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription vertex_binding = {};
+    vertex_binding.binding = 0;
+    vertex_binding.stride = sizeof(renderer_vertex);
+    vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription vertex_attributes[2] = {};
+    vertex_attributes[0].location = 0;
+    vertex_attributes[0].binding = 0;
+    vertex_attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertex_attributes[0].offset = offsetof(renderer_vertex, position);
+    vertex_attributes[1].location = 1;
+    vertex_attributes[1].binding = 0;
+    vertex_attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertex_attributes[1].offset = offsetof(renderer_vertex, color);
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &vertex_binding;
+    vertex_input.vertexAttributeDescriptionCount = 2;
+    vertex_input.pVertexAttributeDescriptions = vertex_attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    // Set while recording, so the pipelines don't depend on the framebuffer size
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = desc->cull_mode;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = desc->samples;
+
+    // (src alpha * new colour) + ((1 - src alpha) * old colour), the new alpha is kept
+    VkPipelineColorBlendAttachmentState colour_state = {};
+    if (desc->colour_write)
+        colour_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colour_state.blendEnable = desc->colour_write && desc->blend ? VK_TRUE : VK_FALSE;
+    colour_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colour_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colour_state.colorBlendOp = VK_BLEND_OP_ADD;
+    colour_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colour_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colour_state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colour_blending = {};
+    colour_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colour_blending.logicOpEnable = VK_FALSE;
+    colour_blending.attachmentCount = 1;
+    colour_blending.pAttachments = &colour_state;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = desc->depth_write ? VK_TRUE : VK_FALSE;
+    depth_stencil.depthCompareOp = desc->depth_compare_op;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable = VK_FALSE;
+
+    VkGraphicsPipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.stageCount = fragment_module ? 2 : 1;
+    create_info.pStages = stages;
+    create_info.pVertexInputState = &vertex_input;
+    create_info.pInputAssemblyState = &input_assembly;
+    create_info.pViewportState = &viewport_state;
+    create_info.pDynamicState = &dynamic_state;
+    create_info.pRasterizationState = &rasterizer;
+    create_info.pMultisampleState = &multisampling;
+    create_info.pColorBlendState = &colour_blending;
+    create_info.pDepthStencilState = &depth_stencil;
+    create_info.layout = desc->layout;
+    create_info.renderPass = desc->render_pass;
+    create_info.subpass = 0;
+    create_info.basePipelineHandle = VK_NULL_HANDLE;
+    create_info.basePipelineIndex = -1;
+
+    // Without a render pass the formats of the attachments are given instead
+    VkPipelineRenderingCreateInfo rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &desc->colour_format;
+    rendering_info.depthAttachmentFormat = desc->depth_format;
+    if (!desc->render_pass)
+        create_info.pNext = &rendering_info;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(context->device.logical_device, context->pipeline_cache, 1, &create_info, context->allocator, &pipeline);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: compile_graphics_pipeline - Failed to create the pipeline of %s (%d).\n", desc->vertex_shader_path, result);
+        pipeline = VK_NULL_HANDLE;
+    }
+
+    vkDestroyShaderModule(context->device.logical_device, vertex_module, context->allocator);
+    if (fragment_module)
+        vkDestroyShaderModule(context->device.logical_device, fragment_module, context->allocator);
+    return pipeline;
+}
+
+static void compile_entry(pipeline_entry *entry)
+{
+    entry->pipeline = compile_graphics_pipeline(state->context, &entry->desc);
+    entry->status.store(entry->pipeline ? VULKAN_PIPELINE_STATUS_READY : VULKAN_PIPELINE_STATUS_FAILED, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        ++state->completed_count;
+    }
+    state->work_done.notify_all();
+}
+
+static void reload_entry(pipeline_entry *entry)
+{
+    entry->reloaded = compile_graphics_pipeline(state->context, &entry->desc);
+    entry->reload_status.store(PIPELINE_RELOAD_DONE, std::memory_order_release);
+    state->pending_swap_count.fetch_add(1, std::memory_order_release);
+}
+
+static void worker_main()
+{
+    for (;;)
+    {
+        pipeline_entry *entry;
+        b8 reload = BC_FALSE;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->work_available.wait(lock, []
+                                       { return state->next_entry < state->entry_count.load(std::memory_order_relaxed) ||
+                                                state->reload_count > 0 || !state->is_running; });
+            // Queued pipelines are dropped when quitting
+            if (!state->is_running)
+                return;
+            if (state->next_entry < state->entry_count.load(std::memory_order_relaxed))
+                entry = &state->entries[state->next_entry++];
+            else
+            {
+                entry = &state->entries[state->reload_queue[state->reload_head]];
+                state->reload_head = (state->reload_head + 1) % VULKAN_PIPELINE_COMPILER_CAPACITY;
+                --state->reload_count;
+                reload = BC_TRUE;
+            }
+        }
+        if (reload)
+            reload_entry(entry);
+        else
+            compile_entry(entry);
+    }
+}
+
+// Main thread only
+static void queue_reload(u32 index)
+{
+    pipeline_entry *entry = &state->entries[index];
+    entry->reload_status.store(PIPELINE_RELOAD_QUEUED, std::memory_order_relaxed);
+    if (!state->worker_count)
+    {
+        reload_entry(entry);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        // An entry is queued at most once, so the ring can't overflow
+        state->reload_queue[(state->reload_head + state->reload_count) % VULKAN_PIPELINE_COMPILER_CAPACITY] = index;
+        ++state->reload_count;
+    }
+    state->work_available.notify_one();
+}
+
+b8 vulkan_pipeline_compiler_create(vulkan_context *context, u32 worker_count)
+{
+    if (state)
+    {
+        printf("vulkan_pipeline_compiler_create is called when already created.\n");
+        return BC_FALSE;
+    }
+
+    state = new pipeline_compiler_state();
+    state->context = context;
+    state->worker_count = worker_count;
+    state->is_running = BC_TRUE;
+    state->workers = worker_count ? new std::thread[worker_count] : NULL;
+    for (u32 i = 0; i < worker_count; ++i)
+        state->workers[i] = std::thread(worker_main);
+
+    return BC_TRUE;
+}
+
+void vulkan_pipeline_compiler_destroy()
+{
+    if (!state)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->is_running = BC_FALSE;
+    }
+    state->work_available.notify_all();
+    for (u32 i = 0; i < state->worker_count; ++i)
+        state->workers[i].join();
+
+    vulkan_context *context = state->context;
+    u32 entry_count = state->entry_count.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < entry_count; ++i)
+    {
+        pipeline_entry *entry = &state->entries[i];
+        if (entry->pipeline)
+            vkDestroyPipeline(context->device.logical_device, entry->pipeline, context->allocator);
+        if (entry->reloaded)
+            vkDestroyPipeline(context->device.logical_device, entry->reloaded, context->allocator);
+        free((void *)entry->desc.vertex_shader_path);
+        free((void *)entry->desc.fragment_shader_path);
+    }
+
+    delete[] state->workers;
+    delete state;
+    state = NULL;
+}
+
+vulkan_pipeline_handle vulkan_pipeline_compiler_submit(const vulkan_graphics_pipeline_desc *desc)
+{
+    u32 index = state->entry_count.load(std::memory_order_relaxed);
+    if (index >= VULKAN_PIPELINE_COMPILER_CAPACITY)
+    {
+        printf("WARN: vulkan_pipeline_compiler_submit - The pipeline compiler is full.\n");
+        return VULKAN_PIPELINE_INVALID_HANDLE;
+    }
+
+    // Only the submitting thread writes entries past entry_count
+    pipeline_entry *entry = &state->entries[index];
+    entry->desc = *desc;
+    entry->desc.vertex_shader_path = copy_string(desc->vertex_shader_path);
+    entry->desc.fragment_shader_path = copy_string(desc->fragment_shader_path);
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->status.store(VULKAN_PIPELINE_STATUS_PENDING, std::memory_order_relaxed);
+    entry->reloaded = VK_NULL_HANDLE;
+    entry->reload_status.store(PIPELINE_RELOAD_NONE, std::memory_order_relaxed);
+    entry->reload_again = BC_FALSE;
+
+    if (!state->worker_count)
+    {
+        state->next_entry = index + 1;
+        state->entry_count.store(index + 1, std::memory_order_release);
+        compile_entry(entry);
+        return index;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->entry_count.store(index + 1, std::memory_order_release);
+    }
+    state->work_available.notify_one();
+    return index;
+}
+
+vulkan_pipeline_status vulkan_pipeline_compiler_status(vulkan_pipeline_handle handle)
+{
+    if (handle >= state->entry_count.load(std::memory_order_acquire))
+        return VULKAN_PIPELINE_STATUS_FAILED;
+    return (vulkan_pipeline_status)state->entries[handle].status.load(std::memory_order_acquire);
+}
+
+VkPipeline vulkan_pipeline_compiler_get(vulkan_pipeline_handle handle)
+{
+    // Follows the fallbacks, which were submitted before the pipelines falling back on them
+    while (handle < state->entry_count.load(std::memory_order_acquire))
+    {
+        const pipeline_entry *entry = &state->entries[handle];
+        if (entry->status.load(std::memory_order_acquire) == VULKAN_PIPELINE_STATUS_READY)
+            return entry->pipeline;
+        if (entry->desc.fallback >= handle)
+            break;
+        handle = entry->desc.fallback;
+    }
+    return VK_NULL_HANDLE;
+}
+
+void vulkan_pipeline_compiler_wait_all()
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->work_done.wait(lock, []
+                          { return state->completed_count == state->entry_count.load(std::memory_order_relaxed); });
+}
+
+u32 vulkan_pipeline_compiler_reload(const char *shader_path)
+{
+    // Entries before next_entry have been taken by a worker
+    u32 started_count;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        started_count = state->next_entry;
+    }
+
+    u32 reload_count = 0;
+    u32 entry_count = state->entry_count.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < entry_count; ++i)
+    {
+        pipeline_entry *entry = &state->entries[i];
+        b8 uses_shader = !strcmp(entry->desc.vertex_shader_path, shader_path) ||
+                         (entry->desc.fragment_shader_path && !strcmp(entry->desc.fragment_shader_path, shader_path));
+        if (!uses_shader)
+            continue;
+        ++reload_count;
+
+        // A pipeline still queued reads its shaders when it gets compiled. One being compiled may have read the
+        // previous ones already, it is rebuilt once compiled (see vulkan_pipeline_compiler_begin_frame).
+        if (entry->status.load(std::memory_order_acquire) == VULKAN_PIPELINE_STATUS_PENDING)
+        {
+            if (i < started_count && !entry->reload_again)
+            {
+                entry->reload_again = BC_TRUE;
+                ++state->deferred_reload_count;
+            }
+        }
+        else if (entry->reload_status.load(std::memory_order_relaxed) == PIPELINE_RELOAD_NONE)
+            queue_reload(i);
+        else
+            entry->reload_again = BC_TRUE;
+    }
+    return reload_count;
+}
+
+// Queues the rebuild of the entries whose shaders changed while they were first compiled, once they are
+static void queue_deferred_reloads()
+{
+    u32 entry_count = state->entry_count.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < entry_count && state->deferred_reload_count; ++i)
+    {
+        pipeline_entry *entry = &state->entries[i];
+        if (!entry->reload_again || entry->reload_status.load(std::memory_order_relaxed) != PIPELINE_RELOAD_NONE ||
+            entry->status.load(std::memory_order_acquire) == VULKAN_PIPELINE_STATUS_PENDING)
+            continue;
+
+        entry->reload_again = BC_FALSE;
+        --state->deferred_reload_count;
+        queue_reload(i);
+    }
+}
+
+void vulkan_pipeline_compiler_begin_frame(u64 retire_value)
+{
+    if (state->deferred_reload_count)
+        queue_deferred_reloads();
+    if (!state->pending_swap_count.load(std::memory_order_acquire))
+        return;
+
+    vulkan_context *context = state->context;
+    u32 entry_count = state->entry_count.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < entry_count; ++i)
+    {
+        pipeline_entry *entry = &state->entries[i];
+        if (entry->reload_status.load(std::memory_order_acquire) != PIPELINE_RELOAD_DONE)
+            continue;
+
+        if (entry->reloaded)
+        {
+            // The previous pipeline may still be used by the frames in flight
+            if (entry->pipeline)
+                vulkan_deletion_queue_push(&context->deletion_queue, VULKAN_DELETION_PIPELINE, (u64)entry->pipeline, retire_value);
+            entry->pipeline = entry->reloaded;
+            entry->reloaded = VK_NULL_HANDLE;
+            entry->status.store(VULKAN_PIPELINE_STATUS_READY, std::memory_order_release);
+            printf("Reloaded the pipeline of %s.\n", entry->desc.fragment_shader_path ? entry->desc.fragment_shader_path : entry->desc.vertex_shader_path);
+        }
+        else
+            printf("WARN: vulkan_pipeline_compiler_begin_frame - Failed to rebuild the pipeline of %s, the previous one is kept.\n", entry->desc.vertex_shader_path);
+
+        entry->reload_status.store(PIPELINE_RELOAD_NONE, std::memory_order_relaxed);
+        state->pending_swap_count.fetch_sub(1, std::memory_order_relaxed);
+        if (entry->reload_again)
+        {
+            entry->reload_again = BC_FALSE;
+            queue_reload(i);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef VULKAN_NOTES_1704627341_VULKAN_PIPELINE_COMPILER_H
+#define VULKAN_NOTES_1704627341_VULKAN_PIPELINE_COMPILER_H
+
+#include "vulkan_types.h"
+
+/*
+Compiles graphics pipelines on worker threads of its own, so neither the startup nor the frames wait for the
+driver. A pipeline is submitted as a description and gets a handle right away; the frames ask for the pipeline
+of the handle whenever they draw with it, and get VK_NULL_HANDLE (or the pipeline of its fallback) until it is
+compiled, in which case the draws are skipped. Pipelines are compiled in the order they were submitted.
+
+The workers share the pipeline cache of the context, which is internally synchronized, so the permutations
+compiled in a previous run are only fetched from it. They are separate from the job system: a compilation takes
+from a millisecond to hundreds of them, and would hold up the recording jobs of the frames queued behind it
+(or the main thread, which runs queued jobs while waiting on its own).
+
+Pipelines can be rebuilt when their shaders change (hot reload). The rebuilt pipeline is compiled on the workers
+like any other while the frames keep drawing with the previous one, and is swapped in at the start of a frame,
+so a frame never records with two versions. The previous one is retired to the deletion queue, and destroyed once
+the frames in flight which may use it are done: nothing waits for the device.
+*/
+
+// Returned when the compiler is full
+#define VULKAN_PIPELINE_INVALID_HANDLE 0xFFFFFFFFu
+
+#define VULKAN_PIPELINE_COMPILER_CAPACITY 1024
+
+typedef enum vulkan_pipeline_status
+{
+    VULKAN_PIPELINE_STATUS_PENDING,
+    VULKAN_PIPELINE_STATUS_READY,
+    VULKAN_PIPELINE_STATUS_FAILED
+} vulkan_pipeline_status;
+
+/**
+ * Starts the worker threads.
+ * @param context A pointer to the vulkan context, with the logical device and the pipeline cache created.
+ * @param worker_count The number of worker threads. Can be 0, then pipelines are compiled when submitted.
+ * @returns True if started successfully; otherwise false.
+ */
+b8 vulkan_pipeline_compiler_create(vulkan_context *context, u32 worker_count);
+
+/**
+ * Drops the pipelines not compiled yet, waits for the ones being compiled and destroys every pipeline.
+ * The GPU should be done with them.
+ */
+void vulkan_pipeline_compiler_destroy();
+
+/**
+ * Queues the compilation of a graphics pipeline. Should be called from the main thread.
+ * @param desc The description of the pipeline. The layout and render pass must outlive the compiler.
+ * @returns The handle of the pipeline or VULKAN_PIPELINE_INVALID_HANDLE if the compiler is full.
+ */
+vulkan_pipeline_handle vulkan_pipeline_compiler_submit(const vulkan_graphics_pipeline_desc *desc);
+
+/**
+ * Gets a pipeline to draw with. Can be called from any thread.
+ * @param handle The handle returned by vulkan_pipeline_compiler_submit.
+ * @returns The pipeline if compiled, else the one of its fallback if compiled, else VK_NULL_HANDLE.
+ */
+VkPipeline vulkan_pipeline_compiler_get(vulkan_pipeline_handle handle);
+
+/**
+ * @returns Whether the pipeline is still pending, compiled or failed to compile.
+ */
+vulkan_pipeline_status vulkan_pipeline_compiler_status(vulkan_pipeline_handle handle);
+
+/**
+ * Blocks until every submitted pipeline is compiled (or failed to).
+ */
+void vulkan_pipeline_compiler_wait_all();
+
+/**
+ * Queues the rebuild of the compiled pipelines using a shader. Should be called from the main thread.
+ * @param shader_path The path of the SPIR-V file, as given in the descriptions.
+ * @returns The number of pipelines using the shader.
+ */
+u32 vulkan_pipeline_compiler_reload(const char *shader_path);
+
+/**
+ * Swaps in the rebuilt pipelines, and queues the rebuild of the pipelines whose shaders changed while they were
+ * first compiled. Should be called from the main thread at the start of a frame, before anything
+ * is recorded with the pipelines.
+ * @param retire_value The number of frames which have to complete before the replaced pipelines can be destroyed.
+ */
+void vulkan_pipeline_compiler_begin_frame(u64 retire_value);
+
+#endif
@@ -2,7 +2,30 @@
 #include "log_assert.h"
 #include "utils.h"
 #include "file_system.h"
+#include "platform.h"
+// volk function definitions live in this translation unit
+#define VOLK_IMPLEMENTATION
 #include "vulkan_types.h"
+#include "vulkan_gpu_timer.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_pipeline_compiler.h"
+#include "shader_watcher.h"
+#include "vulkan_command_pool.h"
+#include "job_system.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_timeline.h"
+#include "vulkan_memory.h"
+#include "vulkan_buffer.h"
+#include "vulkan_image.h"
+#include "vulkan_upload.h"
+#include "vulkan_geometry.h"
+#include "vulkan_compute.h"
+#include "vulkan_indirect.h"
+#include "vulkan_culling.h"
+#include "vulkan_depth_pyramid.h"
+#include "vulkan_bindless.h"
+#include "vulkan_uniform_ring.h"
+#include "vulkan_host_allocator.h"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -11,8 +34,16 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <math.h>
 
 #define OBJECT_SHADER_STAGE_COUNT 2
+// Pipelines the draws of a frame can be grouped by
+#define MAX_DRAW_BATCHES 16
+// Compared with the paths of the shaders recompiled by the watcher
+#define CULL_INSTANCES_SHADER_PATH "assets/shaders/cull_instances.comp.spv"
+#define COMPACT_DRAWS_SHADER_PATH "assets/shaders/compact_draws.comp.spv"
+#define DEPTH_PYRAMID_SHADER_PATH "assets/shaders/depth_pyramid.comp.spv"
 char stage_type_strs[OBJECT_SHADER_STAGE_COUNT][5] = {"vert", "frag"};
 VkShaderStageFlagBits stage_types[OBJECT_SHADER_STAGE_COUNT] = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT};
 
@@ -159,9 +190,31 @@ b8 vulkan_result_is_success(VkResult result)
 static vulkan_context context;
 static u32 cached_framebuffer_width = 0;
 static u32 cached_framebuffer_height = 0;
+// Submitted to the pipeline compiler by create_graphics_pipeline
+static vulkan_pipeline_handle graphicsPipelineHandle;
+// Depth only version of graphicsPipeline, VULKAN_PIPELINE_INVALID_HANDLE without the depth pre-pass
+static vulkan_pipeline_handle depthPrepassPipelineHandle;
+// Opaque version of graphicsPipeline which draws with or without the pre-pass, until the others are compiled
+static vulkan_pipeline_handle fallbackPipelineHandle;
+// Pipelines of the current frame, VK_NULL_HANDLE while compiling (or without the depth pre-pass)
 static VkPipeline graphicsPipeline;
+static VkPipeline depthPrepassPipeline;
 static VkPipelineLayout pipelineLayout;
 
+// Push constants of shader_base.vert.glsl
+typedef struct object_push_constants
+{
+    // Global set indices of the instance buffers of the frame
+    u32 instance_buffer_index;
+    u32 visible_instance_buffer_index;
+} object_push_constants;
+
+// Uniform block of the frame (set 1), std140
+typedef struct global_uniforms
+{
+    f32 view_projection[16];
+} global_uniforms;
+
 // Extensions
 static const char *requested_device_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 static uint32_t requested_device_ext_count = 1;
@@ -376,8 +429,12 @@ vulkan_physical_device_queue_family_info get_queue_families(VkPhysicalDevice dev
             indices.graphics_family_index = i;
 
         // Check if Queue Family supports presentation
+        // There is no surface to present to in headless mode so the graphics family does the job.
         VkBool32 presentation_support = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentation_support);
+        if (context.headless)
+            presentation_support = (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        else
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, context.surface, &presentation_support);
         // Check if queue is presentation type (can be both graphics and presentation)
         if (queue_families[i].queueCount > 0 && presentation_support)
             indices.presentation_family_index = i;
@@ -387,6 +444,34 @@ vulkan_physical_device_queue_family_info get_queue_families(VkPhysicalDevice dev
             break;
     }
 
+    // Transfer queue for uploads (optional). A family with neither graphics nor compute is usually backed
+    // by dedicated copy engines, otherwise any family without graphics does.
+    for (i = 0; i < queue_family_count; i++)
+    {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if (!queue_families[i].queueCount || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+
+        if (!(flags & VK_QUEUE_COMPUTE_BIT))
+        {
+            indices.transfer_family_index = i;
+            break;
+        }
+        if (indices.transfer_family_index < 0)
+            indices.transfer_family_index = i;
+    }
+
+    // Compute queue for async compute (optional), without graphics so it runs alongside the graphics queue
+    for (i = 0; i < queue_family_count; i++)
+    {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if (queue_families[i].queueCount && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.compute_family_index = i;
+            break;
+        }
+    }
+
     return indices;
 }
 
@@ -447,16 +532,32 @@ VkSurfaceFormatKHR choose_best_surface_format(VkSurfaceFormatKHR *formats, uint3
     return formats[0];
 }
 
-VkPresentModeKHR choose_best_presentation_mode(VkPresentModeKHR *presentation_modes, uint32_t presentation_modes_count)
+// First mode of the policy's preference list the surface supports, see renderer_present_policy
+VkPresentModeKHR choose_best_presentation_mode(VkPresentModeKHR *presentation_modes, uint32_t presentation_modes_count, renderer_present_policy policy)
 {
-    if (presentation_modes == NULL || !presentation_modes_count)
-        return VK_PRESENT_MODE_FIFO_KHR;
+    static const VkPresentModeKHR low_latency[] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+    static const VkPresentModeKHR uncapped[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
 
-    uint32_t i;
-    for (i = 0; i < presentation_modes_count; ++i)
+    const VkPresentModeKHR *preferred = NULL;
+    uint32_t preferred_count = 0;
+    if (policy == RENDERER_PRESENT_POLICY_LOW_LATENCY)
+    {
+        preferred = low_latency;
+        preferred_count = sizeof(low_latency) / sizeof(low_latency[0]);
+    }
+    else if (policy == RENDERER_PRESENT_POLICY_UNCAPPED)
     {
-        if (presentation_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
-            return presentation_modes[i];
+        preferred = uncapped;
+        preferred_count = sizeof(uncapped) / sizeof(uncapped[0]);
+    }
+
+    for (uint32_t p = 0; p < preferred_count && presentation_modes; ++p)
+    {
+        for (uint32_t i = 0; i < presentation_modes_count; ++i)
+        {
+            if (presentation_modes[i] == preferred[p])
+                return presentation_modes[i];
+        }
     }
 
     // If can't find, use FIFO as Vulkan spec says it must be present
@@ -519,8 +620,9 @@ VkBool32 check_device_suitable(VkPhysicalDevice device, SwapChainDetails *detail
     VkBool32 extensions_supported = check_device_extension_support(device);
 
     // Check swapchain capabilities
-    VkBool32 swap_chain_adequate = VK_FALSE;
-    if (extensions_supported)
+    // Headless mode renders into its own images so there is no surface to query.
+    VkBool32 swap_chain_adequate = context.headless ? VK_TRUE : VK_FALSE;
+    if (extensions_supported && !context.headless)
     {
         *details = get_swap_chain_details(device);
         swap_chain_adequate = details->format_count && details->presentation_mode_count;
@@ -659,15 +761,25 @@ void create_instance()
     // glfw may require multiple extensions
     uint32_t required_extension_count = 0;
     const char **required_extensions = NULL;
-    required_extensions = glfwGetRequiredInstanceExtensions(&required_extension_count);
-    // This list already includes VK_KHR_surface extension for surface
-
-    if (enable_validation_layers)
+    if (context.headless)
     {
-        // doing c tricks to append string to array
-        const char *extra_extensions[] = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
-        required_extensions = append_strs_to_str_arr(required_extensions, required_extension_count, extra_extensions, 1);
-        ++required_extension_count;
+        // No window system integration (VK_KHR_surface etc.) is required to render offscreen
+        static const char *headless_extensions[] = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        required_extensions = headless_extensions;
+        required_extension_count = enable_validation_layers ? 1 : 0;
+    }
+    else
+    {
+        required_extensions = glfwGetRequiredInstanceExtensions(&required_extension_count);
+        // This list already includes VK_KHR_surface extension for surface
+
+        if (enable_validation_layers)
+        {
+            // doing c tricks to append string to array
+            const char *extra_extensions[] = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
+            required_extensions = append_strs_to_str_arr(required_extensions, required_extension_count, extra_extensions, 1);
+            ++required_extension_count;
+        }
     }
 
 // MoltenVK VK_ERROR_INCOMPATIBLE_DRIVER error:
@@ -724,8 +836,7 @@ void create_instance()
 #endif
 
     // Create instance
-    // TODO: custom allocator.
-    context.allocator = 0;
+    // context.allocator is set by init_renderer_with_config, NULL unless host allocations are tracked
     VkResult res = vkCreateInstance(&createInfo, context.allocator, &context.instance);
     if (res == VK_ERROR_INCOMPATIBLE_DRIVER)
     {
@@ -783,28 +894,144 @@ void get_physical_device()
     if (context.device.physical_device == VK_NULL_HANDLE)
         ERR_EXIT("Failed to find a suitable GPU.\n", "get_physical_device");
 
+    vkGetPhysicalDeviceProperties(context.device.physical_device, &context.device.properties);
+    vkGetPhysicalDeviceFeatures(context.device.physical_device, &context.device.features);
+    vkGetPhysicalDeviceMemoryProperties(context.device.physical_device, &context.device.memory_properties);
+
+    // Optional Vulkan 1.2 and 1.3 features
+    memset(&context.device.properties12, 0, sizeof(VkPhysicalDeviceVulkan12Properties));
+    context.device.properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    memset(&context.device.features12, 0, sizeof(VkPhysicalDeviceVulkan12Features));
+    context.device.features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    memset(&context.device.features13, 0, sizeof(VkPhysicalDeviceVulkan13Features));
+    context.device.features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    if (context.device.properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &context.device.features12;
+        if (context.device.properties.apiVersion >= VK_API_VERSION_1_3)
+            context.device.features12.pNext = &context.device.features13;
+        vkGetPhysicalDeviceFeatures2(context.device.physical_device, &features2);
+        context.device.features12.pNext = NULL;
+        context.device.features13.pNext = NULL;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &context.device.properties12;
+        vkGetPhysicalDeviceProperties2(context.device.physical_device, &properties2);
+        context.device.properties12.pNext = NULL;
+    }
+
     // Get the queue family indices for the chosen Physical Device
     vulkan_physical_device_queue_family_info indices = get_queue_families(context.device.physical_device);
     context.device.graphics_queue_index = indices.graphics_family_index;
     context.device.present_queue_index = indices.presentation_family_index;
+    context.device.transfer_queue_index = indices.transfer_family_index;
+    context.device.compute_queue_index = indices.compute_family_index;
 }
 
-void create_logical_device()
+b8 format_has_stencil(VkFormat format)
+{
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT;
+}
+
+/**
+ * @brief Picks the depth attachment format. A float format keeps the most precision with reverse-Z,
+ * the other ones are only there for devices without it.
+ */
+void detect_depth_format()
+{
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D24_UNORM_S8_UINT,
+        VK_FORMAT_D16_UNORM};
+    const u32 candidate_count = sizeof(candidates) / sizeof(candidates[0]);
+
+    context.device.depth_format = VK_FORMAT_UNDEFINED;
+    for (u32 i = 0; i < candidate_count; ++i)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(context.device.physical_device, candidates[i], &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            context.device.depth_format = candidates[i];
+            return;
+        }
+    }
+
+    ERR_EXIT("Failed to find a supported depth format.\n", "detect_depth_format");
+}
+
+// Highest sample count up to requested_samples both the colour and the depth attachments support
+VkSampleCountFlagBits choose_msaa_samples(u32 requested_samples)
 {
-    b8 present_shares_graphics_queue = context.device.graphics_queue_index == context.device.present_queue_index;
+    const VkPhysicalDeviceLimits *limits = &context.device.properties.limits;
+    VkSampleCountFlags supported = limits->framebufferColorSampleCounts & limits->framebufferDepthSampleCounts;
+    for (u32 samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1)
+    {
+        if (samples <= requested_samples && (supported & samples))
+            return (VkSampleCountFlagBits)samples;
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+/**
+ * @brief Keeps the depth after the render pass for the depth pyramid the GPU culling tests occlusion against
+ * (see vulkan_depth_pyramid.h), if it culls (same requirement as vulkan_indirect_create) and the depth can be sampled.
+ * With MSAA the samples are resolved to the farthest one (the smallest, the depth is reversed) when the device can,
+ * otherwise to the first one, which may cull an instance only seen by the other samples for a frame.
+ * Should be called once the depth format and the sample count are picked.
+ */
+void choose_occlusion_culling(b8 gpu_culling)
+{
+    context.occlusion_culling = BC_FALSE;
+    context.depth_resolve_mode = VK_RESOLVE_MODE_NONE;
+    context.stencil_resolve_mode = VK_RESOLVE_MODE_NONE;
+    if (!gpu_culling || !context.device.features.drawIndirectFirstInstance)
+        return;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context.device.physical_device, context.device.depth_format, &properties);
+    if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        printf("WARNING: The depth format can't be sampled, instances are only frustum culled.\n");
+        return;
+    }
+    context.occlusion_culling = BC_TRUE;
+    if (context.msaa_samples == VK_SAMPLE_COUNT_1_BIT)
+        return;
+
+    const VkPhysicalDeviceVulkan12Properties *properties12 = &context.device.properties12;
+    context.depth_resolve_mode = (properties12->supportedDepthResolveModes & VK_RESOLVE_MODE_MIN_BIT) ? VK_RESOLVE_MODE_MIN_BIT : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+    // The stencil is not needed, but can only be left unresolved if the device resolves the aspects independently
+    if (format_has_stencil(context.device.depth_format) && !properties12->independentResolveNone)
+    {
+        if (!(properties12->supportedStencilResolveModes & context.depth_resolve_mode))
+            context.depth_resolve_mode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+        context.stencil_resolve_mode = context.depth_resolve_mode;
+    }
+}
 
+void create_logical_device()
+{
     // For each indices, it requires a queue ->std::unordered_set can be used here
     // No duplicate indices should be alive
     // TODO: We don't have hash_set impl yet so use this manual approach
-    size_t indices_count = present_shares_graphics_queue ? 1 : 2;
-
-    i32 *unique_queue_families = (i32 *)(malloc(sizeof(i32) * indices_count));
-    if (indices_count == 1)
-        unique_queue_families[0] = context.device.graphics_queue_index;
-    else if (indices_count == 2)
+    // The transfer and compute families may be the same one (a compute family is also a transfer one)
+    const i32 queue_families[4] = {
+        context.device.graphics_queue_index, context.device.present_queue_index,
+        context.device.transfer_queue_index, context.device.compute_queue_index};
+    i32 *unique_queue_families = (i32 *)(malloc(sizeof(i32) * 4));
+    size_t indices_count = 0;
+    for (u32 i = 0; i < 4; ++i)
     {
-        unique_queue_families[0] = context.device.graphics_queue_index;
-        unique_queue_families[1] = context.device.present_queue_index;
+        b8 is_unique = queue_families[i] >= 0;
+        for (size_t j = 0; j < indices_count && is_unique; ++j)
+            is_unique = unique_queue_families[j] != queue_families[i];
+        if (is_unique)
+            unique_queue_families[indices_count++] = queue_families[i];
     }
 
     // Store queue infos
@@ -834,9 +1061,54 @@ void create_logical_device()
 
     // Physical Device Features the Logical Device will be using
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    // Optional, used by the GPU timer if available
+    deviceFeatures.pipelineStatisticsQuery = context.device.features.pipelineStatisticsQuery;
+    // Optional, lets the pipeline statistics cover the secondary command buffers
+    deviceFeatures.inheritedQueries = context.device.features.inheritedQueries;
+    // Optional, several draws per indirect call and instance offsets in indirect commands
+    deviceFeatures.multiDrawIndirect = context.device.features.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = context.device.features.drawIndirectFirstInstance;
+    // The global set is indexed with push constants (see vulkan_bindless.h), required by vulkan_bindless_create
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = context.device.features.shaderStorageBufferArrayDynamicIndexing;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = context.device.features.shaderSampledImageArrayDynamicIndexing;
 
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures; // Physical Device features Logical Device will use
 
+    // Vulkan 1.2 features
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (context.use_timeline && !context.device.features12.timelineSemaphore)
+    {
+        printf("WARNING: Timeline semaphores are not supported, frames are synchronized with fences.\n");
+        context.use_timeline = BC_FALSE;
+    }
+    // Also used by the uploader to hand resources over from the transfer queue, whatever the frames use
+    features12.timelineSemaphore = context.device.features12.timelineSemaphore;
+    // Optional, lets the draw count of the indirect batches come from a buffer
+    features12.drawIndirectCount = context.device.features12.drawIndirectCount;
+    // Descriptor indexing of the global set (see vulkan_bindless.h). Update after bind is optional.
+    features12.runtimeDescriptorArray = context.device.features12.runtimeDescriptorArray;
+    features12.descriptorBindingPartiallyBound = context.device.features12.descriptorBindingPartiallyBound;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = context.device.features12.descriptorBindingStorageBufferUpdateAfterBind;
+    features12.descriptorBindingSampledImageUpdateAfterBind = context.device.features12.descriptorBindingSampledImageUpdateAfterBind;
+    features12.descriptorBindingUpdateUnusedWhilePending = context.device.features12.descriptorBindingUpdateUnusedWhilePending;
+    features12.shaderStorageBufferArrayNonUniformIndexing = context.device.features12.shaderStorageBufferArrayNonUniformIndexing;
+    features12.shaderSampledImageArrayNonUniformIndexing = context.device.features12.shaderSampledImageArrayNonUniformIndexing;
+    if (context.device.properties.apiVersion >= VK_API_VERSION_1_2)
+        deviceCreateInfo.pNext = &features12;
+
+    // Vulkan 1.3 features
+    VkPhysicalDeviceVulkan13Features features13 = {};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    if (context.use_dynamic_rendering && !context.device.features13.dynamicRendering)
+    {
+        printf("WARNING: Dynamic rendering is not supported, rendering with a render pass and framebuffers.\n");
+        context.use_dynamic_rendering = BC_FALSE;
+    }
+    features13.dynamicRendering = context.use_dynamic_rendering;
+    if (context.device.properties.apiVersion >= VK_API_VERSION_1_3)
+        features12.pNext = &features13;
+
     uint32_t required_validation_layers_count;
     const char **required_validation_layers = get_required_validation_layers(&required_validation_layers_count);
     if (enable_validation_layers)
@@ -851,7 +1123,7 @@ void create_logical_device()
     }
 
     // Create the logical device for the given physical device
-    VkResult result = vkCreateDevice(context.device.physical_device, &deviceCreateInfo, nullptr, &context.device.logical_device);
+    VkResult result = vkCreateDevice(context.device.physical_device, &deviceCreateInfo, context.allocator, &context.device.logical_device);
     if (result != VK_SUCCESS)
         ERR_EXIT("Failed to create a Logical Device!\n", "create_logical_device");
 
@@ -860,18 +1132,145 @@ void create_logical_device()
     // From given logical device, of given Queue Family, of given Queue Index (0 since only one queue), place reference in given VkQueue
     vkGetDeviceQueue(context.device.logical_device, context.device.graphics_queue_index, 0, &context.device.graphicsQueue);
     vkGetDeviceQueue(context.device.logical_device, context.device.present_queue_index, 0, &context.device.presentQueue);
+    context.device.transferQueue = VK_NULL_HANDLE;
+    if (context.device.transfer_queue_index >= 0)
+        vkGetDeviceQueue(context.device.logical_device, context.device.transfer_queue_index, 0, &context.device.transferQueue);
+    context.device.computeQueue = VK_NULL_HANDLE;
+    if (context.device.compute_queue_index >= 0)
+        vkGetDeviceQueue(context.device.logical_device, context.device.compute_queue_index, 0, &context.device.computeQueue);
 
     free(unique_queue_families);
     free(queue_create_infos);
 }
 
+void create_swap_chain_image_views()
+{
+    // The image count may change with recreation
+    context.swap_chain.views = (VkImageView *)(realloc(context.swap_chain.views, sizeof(VkImageView) * context.swap_chain.image_count));
+
+    for (uint32_t i = 0; i < context.swap_chain.image_count; ++i)
+    {
+        VkImageViewCreateInfo viewCreateInfo = {};
+        viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewCreateInfo.image = context.swap_chain.images[i];              // Image to create view for
+        viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;                  // Type of image (1D, 2D, 3D, Cube, etc)
+        viewCreateInfo.format = context.swap_chain.surface_format.format; // Format of image data
+        // viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;      // Allows remapping of rgba components to other rgba values
+        // viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        // viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        // viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+        // Subresources allow the view to view only a part of an image
+        viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // Which aspect of image to view (e.g. COLOR_BIT for viewing colour)
+        viewCreateInfo.subresourceRange.baseMipLevel = 0;                       // Start mipmap level to view from
+        viewCreateInfo.subresourceRange.levelCount = 1;                         // Number of mipmap levels to view
+        viewCreateInfo.subresourceRange.baseArrayLayer = 0;                     // Start array level to view from
+        viewCreateInfo.subresourceRange.layerCount = 1;                         // Number of array levels to view
+
+        VkResult result = vkCreateImageView(context.device.logical_device, &viewCreateInfo, context.allocator, &context.swap_chain.views[i]);
+        if (result != VK_SUCCESS)
+            ERR_EXIT("Failed to retrieve swapchain images view.\n", "create_swapchain::vkCreateImageView");
+    }
+}
+
+/**
+ * @brief Headless replacement for the WSI swapchain. Creates a ring of images owned by
+ * the renderer itself (rather than the presentation engine) so the frame loop can run
+ * without a display, i.e. on a server node or in CI with a software ICD such as lavapipe.
+ */
+void create_headless_swap_chain(u32 width, u32 height)
+{
+    // Same depth of the ring a real surface would typically give us (minImageCount + 1),
+    // deep enough to never hold back the frames in flight
+    u32 image_count = context.frames_in_flight + 1;
+    if (image_count < 3)
+        image_count = 3;
+
+    context.swap_chain.surface_format = {VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    context.swap_chain.extent_2d = {width, height};
+    context.swap_chain.handle = VK_NULL_HANDLE;
+    context.swap_chain.image_count = image_count;
+    context.image_index = image_count - 1; // so that the first "acquire" hands out image 0
+
+    context.swap_chain.images = (VkImage *)(realloc(context.swap_chain.images, sizeof(VkImage) * image_count));
+    context.swap_chain.image_allocations = (vulkan_allocation *)(realloc(context.swap_chain.image_allocations, sizeof(vulkan_allocation) * image_count));
+
+    for (u32 i = 0; i < image_count; ++i)
+    {
+        VkImageCreateInfo image_create_info = {};
+        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_create_info.imageType = VK_IMAGE_TYPE_2D;
+        image_create_info.format = context.swap_chain.surface_format.format;
+        image_create_info.extent = {width, height, 1};
+        image_create_info.mipLevels = 1;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // Transfer source so the rendered frames can be read back (i.e. for image comparison)
+        image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkResult result = vkCreateImage(context.device.logical_device, &image_create_info, context.allocator, &context.swap_chain.images[i]);
+        if (result != VK_SUCCESS)
+            ERR_EXIT("Failed to create headless swapchain image.\n", "create_headless_swap_chain::vkCreateImage");
+
+        if (!vulkan_memory_allocate_image(&context, &context.memory, context.swap_chain.images[i],
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &context.swap_chain.image_allocations[i]))
+            ERR_EXIT("Failed to allocate memory for headless swapchain image.\n", "create_headless_swap_chain");
+    }
+
+    create_swap_chain_image_views();
+}
+
+/**
+ * @brief Creates the depth buffer, and the multisampled colour target with MSAA, at the size of the swapchain images.
+ * The depth is reversed: cleared to 0 (far) and tested with GREATER, so the float precision, the highest close to 0,
+ * makes up for what the perspective divide leaves to the far distances.
+ * Neither is loaded nor stored (the colour samples are resolved into the swapchain image in the pass), so they are
+ * transient attachments which can stay in tile memory. With occlusion culling the depth pyramid is built from the
+ * depth after the pass: the depth is then stored, or with MSAA resolved into a single sample depth_resolve.
+ */
+void create_attachments()
+{
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (format_has_stencil(context.device.depth_format))
+        aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    const VkExtent2D extent = context.swap_chain.extent_2d;
+    const b8 msaa = context.msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+    VkImageUsageFlags depth_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depth_usage |= context.occlusion_culling && !msaa ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    if (!vulkan_image_create(&context, extent.width, extent.height, context.device.depth_format, context.msaa_samples,
+                             depth_usage, aspect, &context.swap_chain.depth_attachment))
+        ERR_EXIT("Failed to create the depth attachment.\n", "create_attachments");
+
+    if (!msaa)
+        return;
+    if (context.occlusion_culling &&
+        !vulkan_image_create(&context, extent.width, extent.height, context.device.depth_format, VK_SAMPLE_COUNT_1_BIT,
+                             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                             aspect, &context.swap_chain.depth_resolve))
+        ERR_EXIT("Failed to create the depth resolve attachment.\n", "create_attachments");
+    if (!vulkan_image_create(&context, extent.width, extent.height, context.swap_chain.surface_format.format, context.msaa_samples,
+                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                             VK_IMAGE_ASPECT_COLOR_BIT, &context.swap_chain.colour_attachment))
+        ERR_EXIT("Failed to create the multisampled colour attachment.\n", "create_attachments");
+}
+
 void create_swap_chain(GLFWwindow *window, u32 width, u32 height)
 {
+    if (context.headless)
+    {
+        create_headless_swap_chain(width, height);
+        return;
+    }
+
     SwapChainDetails details = get_swap_chain_details(context.device.physical_device);
 
     // Choose the best values for the swap chain
     VkSurfaceFormatKHR surface_format = choose_best_surface_format(details.formats, details.format_count);
-    VkPresentModeKHR presentation_mode = choose_best_presentation_mode(details.presentationModes, details.presentation_mode_count);
+    VkPresentModeKHR presentation_mode = choose_best_presentation_mode(details.presentationModes, details.presentation_mode_count, context.present_policy);
     // No need for this since we are passing width and heigh explicitly
     // VkExtent2D extent = choose_swap_extent(window, &details.surfaceCapabilities);
     VkExtent2D extent = choose_swap_extent2(width, height, &details.surfaceCapabilities);
@@ -887,8 +1286,6 @@ void create_swap_chain(GLFWwindow *window, u32 width, u32 height)
     if (details.surfaceCapabilities.maxImageCount > 0 && image_count > details.surfaceCapabilities.maxImageCount)
         image_count = details.surfaceCapabilities.maxImageCount;
 
-    context.swap_chain.max_frames_in_flight = image_count - 1;
-
     // Creation information for swap chain
     VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
     swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -926,12 +1323,14 @@ void create_swap_chain(GLFWwindow *window, u32 width, u32 height)
 
     // IF old swap chain been destroyed and this one replaces it, then link old one to quickly hand over responsibilities
     // i.e. after resize, the actual swap chain must be destroyed and replaced by a new one.
-    // For now, we ignore resizing.
     /*
     With Vulkan it's possible that your swap chain becomes invalid or unoptimized while your application is running, for example because the window was resized.
     In that case the swap chain actually needs to be recreated from scratch and a reference to the old one must be specified in this field.
     */
-    swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+    // The old one is retired (can not be acquired from anymore) but its images can still be presented,
+    // so frames in flight keep running while the new one is created. VK_NULL_HANDLE on first creation.
+    VkSwapchainKHR old_swapchain = context.swap_chain.handle;
+    swapChainCreateInfo.oldSwapchain = old_swapchain;
 
     // Create Swapchain
     VkResult result = vkCreateSwapchainKHR(context.device.logical_device, &swapChainCreateInfo, context.allocator, &context.swap_chain.handle);
@@ -940,10 +1339,13 @@ void create_swap_chain(GLFWwindow *window, u32 width, u32 height)
             "Failed to create swap chain!\n",
             "create_swap_chain");
 
+    // Destroyed once the frames which used it are completed.
+    // NOTE: A fence does not cover the presentation itself, but the present of the last of these frames
+    // has been queued before the fence signals.
+    vulkan_deletion_queue_push(&context.deletion_queue, VULKAN_DELETION_SWAPCHAIN, (u64)old_swapchain, context.frame_number);
+
     context.swap_chain.surface_format = surface_format;
     context.swap_chain.extent_2d = extent;
-    // Start with a zero frame index.
-    context.current_frame = 0;
     context.swap_chain.image_count = 0;
 
     // Now we have to retrieve the handles to the images
@@ -958,39 +1360,48 @@ void create_swap_chain(GLFWwindow *window, u32 width, u32 height)
     if (!context.swap_chain.image_count)
         return; // TODO: Not sure what to return
 
-    if (!context.swap_chain.images)
-        context.swap_chain.images = (VkImage *)(malloc(sizeof(VkImage) * context.swap_chain.image_count));
+    context.swap_chain.images = (VkImage *)(realloc(context.swap_chain.images, sizeof(VkImage) * context.swap_chain.image_count));
 
     result = vkGetSwapchainImagesKHR(context.device.logical_device, context.swap_chain.handle, &context.swap_chain.image_count, context.swap_chain.images);
     if (result != VK_SUCCESS)
         ERR_EXIT("Failed to retrieve swapchain images.\n", "create_swapchain");
 
-    if (!context.swap_chain.views)
-        context.swap_chain.views = (VkImageView *)(malloc(sizeof(VkImageView) * context.swap_chain.image_count));
+    context.swap_chain.present_times = (f64 *)(realloc(context.swap_chain.present_times, sizeof(f64) * context.swap_chain.image_count));
+    memset(context.swap_chain.present_times, 0, sizeof(f64) * context.swap_chain.image_count);
 
-    for (uint32_t i = 0; i < context.swap_chain.image_count; ++i)
-    {
-        VkImageViewCreateInfo viewCreateInfo = {};
-        viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewCreateInfo.image = context.swap_chain.images[i];              // Image to create view for
-        viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;                  // Type of image (1D, 2D, 3D, Cube, etc)
-        viewCreateInfo.format = context.swap_chain.surface_format.format; // Format of image data
-        // viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;      // Allows remapping of rgba components to other rgba values
-        // viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        // viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        // viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_swap_chain_image_views();
+}
 
-        // Subresources allow the view to view only a part of an image
-        viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // Which aspect of image to view (e.g. COLOR_BIT for viewing colour)
-        viewCreateInfo.subresourceRange.baseMipLevel = 0;                       // Start mipmap level to view from
-        viewCreateInfo.subresourceRange.levelCount = 1;                         // Number of mipmap levels to view
-        viewCreateInfo.subresourceRange.baseArrayLayer = 0;                     // Start array level to view from
-        viewCreateInfo.subresourceRange.layerCount = 1;                         // Number of array levels to view
+// Hot reload counterpart of create_shader_module: a missing or broken file only fails the reload
+static VkShaderModule try_create_shader_module(const char *filename)
+{
+    file_handle handle;
+    if (!filesystem_open(filename, FILE_MODE_READ, true, &handle))
+    {
+        printf("ERROR: try_create_shader_module - Unable to open %s.\n", filename);
+        return VK_NULL_HANDLE;
+    }
 
-        result = vkCreateImageView(context.device.logical_device, &viewCreateInfo, context.allocator, &context.swap_chain.views[i]);
-        if (result != VK_SUCCESS)
-            ERR_EXIT("Failed to retrieve swapchain images view.\n", "create_swapchain::vkCreateImageView");
+    u64 size = 0;
+    u8 *file_buffer = 0;
+    b8 read = filesystem_read_all_bytes(&handle, &file_buffer, &size);
+    filesystem_close(&handle);
+    if (!read)
+    {
+        printf("ERROR: try_create_shader_module - Unable to read %s.\n", filename);
+        return VK_NULL_HANDLE;
     }
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = size;
+    shaderModuleCreateInfo.pCode = (u32 *)file_buffer;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(context.device.logical_device, &shaderModuleCreateInfo, context.allocator, &shaderModule) != VK_SUCCESS)
+        printf("ERROR: try_create_shader_module - Failed to create the shader module of %s.\n", filename);
+    free(file_buffer);
+    return shaderModule;
 }
 
 VkShaderModule create_shader_module(const char *filename)
@@ -1027,16 +1438,24 @@ VkShaderModule create_shader_module(const char *filename)
     return shaderModule;
 }
 
-VkSubpassDependency define_subpass_dep()
+VkSubpassDependency2 define_subpass_dep()
 {
 
-    VkSubpassDependency dependency{};
+    VkSubpassDependency2 dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // The depth buffer (and the multisampled colour target) are shared by the frames, their clears wait for
+    // the writes of the previous frame
+    // (depth is written in both fragment test stages, and resolved at the colour output stage), and with occlusion
+    // culling for the depth pyramid of the previous frame to be done reading it
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependency.dependencyFlags = 0;
 
     return dependency;
@@ -1081,9 +1500,26 @@ how many samples to use for each of them and how their contents should be handle
 */
 void create_render_pass()
 {
+    // Reverse-Z, see create_depth_attachment
+    context.main_renderpass.depth = 0.0f;
+    context.main_renderpass.stencil = 0;
+
+    // Rendering is described when it begins, see rendering_begin
+    if (context.use_dynamic_rendering)
+    {
+        context.main_renderpass.handle = VK_NULL_HANDLE;
+        context.main_renderpass.w = context.framebuffer_width;
+        context.main_renderpass.h = context.framebuffer_height;
+        context.main_renderpass.x = 0;
+        context.main_renderpass.y = 0;
+        return;
+    }
+
     // --- ATTACHMENT ---
+    // Render pass 2 (core in Vulkan 1.2, which the bindless set requires anyway) for the depth resolve
     // Colour attachment of render pass
-    VkAttachmentDescription colourAttachment = {};
+    VkAttachmentDescription2 colourAttachment = {};
+    colourAttachment.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
     // The format of the color attachment should match the format of the swap chain images,
     colourAttachment.format = context.swap_chain.surface_format.format; // Format to use for attachment
     colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;                   // Number of samples to write for multisampling
@@ -1112,15 +1548,87 @@ void create_render_pass()
 
     // Then, when all the subpasses are finished, when the render pass comes to an end, the attachmentreference.layout is converted to the finallayout
     colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Image data layout after render pass (to change to)
+    // Nothing is presented in headless mode; leave the image ready to be copied out instead
+    if (context.headless)
+        colourAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
     // Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
     /*
     Directly referenced from fragment shader's layout(location = 0) out vec4 outColor
     */
-    VkAttachmentReference colourAttachmentReference = {};
+    VkAttachmentReference2 colourAttachmentReference = {};
+    colourAttachmentReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
     colourAttachmentReference.attachment = 0; // (location=0)
     colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    // Depth attachment of render pass, only needed while rendering so it is not stored, unless the depth pyramid is
+    // built from it (without MSAA, see create_attachments)
+    const b8 msaa = context.msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+    VkAttachmentDescription2 depthAttachment = {};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+    depthAttachment.format = context.device.depth_format;
+    depthAttachment.samples = context.msaa_samples;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = context.occlusion_culling && !msaa ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference2 depthAttachmentReference = {};
+    depthAttachmentReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+    depthAttachmentReference.attachment = 1;
+    depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // With MSAA the subpass renders into the multisampled attachment, resolved into the swapchain image at its end.
+    // The samples are dropped once resolved, so on tile based GPUs they never leave the tile memory.
+    VkAttachmentDescription2 msaaAttachment = {};
+    msaaAttachment.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+    msaaAttachment.format = context.swap_chain.surface_format.format;
+    msaaAttachment.samples = context.msaa_samples;
+    msaaAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    msaaAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    msaaAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    msaaAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference2 resolveAttachmentReference = {};
+    resolveAttachmentReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+    resolveAttachmentReference.attachment = 0;
+    resolveAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if (msaa)
+    {
+        // The swapchain image is entirely written by the resolve
+        colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colourAttachmentReference.attachment = 2;
+    }
+
+    // With MSAA and occlusion culling the depth samples are resolved into the single sample depth the depth pyramid
+    // is built from, the only attachment stored besides the swapchain image
+    const b8 depth_resolve = msaa && context.occlusion_culling;
+    VkAttachmentDescription2 depthResolveAttachment = {};
+    depthResolveAttachment.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+    depthResolveAttachment.format = context.device.depth_format;
+    depthResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthResolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthResolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthResolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthResolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthResolveAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference2 depthResolveAttachmentReference = {};
+    depthResolveAttachmentReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+    depthResolveAttachmentReference.attachment = 3;
+    depthResolveAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescriptionDepthStencilResolve depthStencilResolve = {};
+    depthStencilResolve.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE;
+    depthStencilResolve.depthResolveMode = context.depth_resolve_mode;
+    depthStencilResolve.stencilResolveMode = context.stencil_resolve_mode;
+    depthStencilResolve.pDepthStencilResolveAttachment = &depthResolveAttachmentReference;
+
     // --- SUBPASS ---
     /*
      Subpasses are subsequent rendering operations that depend on the contents of framebuffers in previous passes,
@@ -1130,31 +1638,36 @@ void create_render_pass()
      For our very first triangle, however, we'll stick to a single subpass.
     */
     // Information about a particular subpass the Render Pass is using
-    VkSubpassDescription subpass = {};
+    VkSubpassDescription2 subpass = {};
+    subpass.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2;
+    subpass.pNext = depth_resolve ? &depthStencilResolve : NULL;
     // There might be subpasses for compute in future so be explicit about the intent
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // Pipeline type subpass is to be bound to
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colourAttachmentReference;
+    subpass.pDepthStencilAttachment = &depthAttachmentReference;
+    subpass.pResolveAttachments = msaa ? &resolveAttachmentReference : NULL;
 
     // Need to determine when layout transitions occur using subpass dependencies
-    VkSubpassDependency subpassDependency = define_subpass_dep();
+    VkSubpassDependency2 subpassDependency = define_subpass_dep();
 
     // Create info for Render Pass
-    VkRenderPassCreateInfo renderPassCreateInfo = {};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    VkRenderPassCreateInfo2 renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
     /*
     Attachments correspond to location for out vars in shaders
     i.e. in shader layout(location=0) out vec4 outColor; corresponds to first color attachment in the render pass
     sometimes attachments correspond to in data but for now we focus on out
     */
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &colourAttachment;
+    VkAttachmentDescription2 attachments[4] = {colourAttachment, depthAttachment, msaaAttachment, depthResolveAttachment};
+    renderPassCreateInfo.attachmentCount = depth_resolve ? 4 : (msaa ? 3 : 2);
+    renderPassCreateInfo.pAttachments = attachments;
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpass;
     renderPassCreateInfo.dependencyCount = 1; // subpassDependencies.size()
     renderPassCreateInfo.pDependencies = &subpassDependency;
 
-    VkResult result = vkCreateRenderPass(context.device.logical_device, &renderPassCreateInfo, context.allocator, &context.main_renderpass.handle);
+    VkResult result = vkCreateRenderPass2(context.device.logical_device, &renderPassCreateInfo, context.allocator, &context.main_renderpass.handle);
     if (result != VK_SUCCESS)
         ERR_EXIT("Failed to create a Render Pass!\n", "create_render_pass");
 
@@ -1166,224 +1679,96 @@ void create_render_pass()
 
 void create_graphics_pipeline()
 {
-    // Read in SPIR-V code of shaders
-    // char vertex_shader_code[1024 * 256];
-    // size_t vertex_shader_len;
-    // b8 res = parse_file_into_str("assets/shaders/shader_base.vert.spv", 1024 * 256, vertex_shader_code, &vertex_shader_len);
-
-    // char frag_shader_code[1024 * 256];
-    // size_t frag_shader_len;
-    // res = parse_file_into_str("assets/shaders/shader_base.frag.spv", 1024 * 256, frag_shader_code, &frag_shader_len);
-
-    // Create Shader Modules
-    VkShaderModule vertexShaderModule = create_shader_module("assets/shaders/shader_base.vert.spv");
-    VkShaderModule fragmentShaderModule = create_shader_module("assets/shaders/shader_base.frag.spv");
-
-    // -- SHADER STAGE CREATION INFORMATION --
-    // Vertex Stage creation information
-    VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-    vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT; // Shader Stage name
-    vertexShaderCreateInfo.module = vertexShaderModule;        // Shader module to be used by stage
-    vertexShaderCreateInfo.pName = "main";                     // Entry point in to shader
-
-    // Fragment Stage creation information
-    VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-    fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT; // Shader Stage name
-    fragmentShaderCreateInfo.module = fragmentShaderModule;        // Shader module to be used by stage
-    fragmentShaderCreateInfo.pName = "main";                       // Entry point in to shader
-
-    // Put shader stage creation info in to array
-    // Graphics Pipeline creation info requires array of shader stage creates
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertexShaderCreateInfo, fragmentShaderCreateInfo};
-
-    // Create Graphics Pipeline
-    // -- VERTEX INPUT (TODO: Put in vertex descriptions when resources created) --
-    /*
-    - Bindings: spacing between data and whether the data is per-vertex or per-instance (see instancing)
-    - Attribute descriptions: type of the attributes passed to the vertex shader,
-        which binding to load them from and at which offset
-    */
-    VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-    vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-    vertexInputCreateInfo.pVertexBindingDescriptions = NULL; // List of Vertex Binding Descriptions (data spacing/stride information)
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputCreateInfo.pVertexAttributeDescriptions = NULL; // List of Vertex Attribute Descriptions (data format and where to bind to/from)
-
-    // -- INPUT ASSEMBLY --
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    // OpenGL mapping-> GL_TRIANGLES etc.
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // Primitive type to assemble vertices as
-    /*
-     If you set the primitiveRestartEnable member to VK_TRUE, then
-        it's possible to break up lines and triangles in the _STRIP topology
-        modes by using a special index of 0xFFFF or 0xFFFFFFFF.
-    */
-    inputAssembly.primitiveRestartEnable = VK_FALSE; // Allow overriding of "strip" topology to start new primitives
-
-    // -- VIEWPORT & SCISSOR --
-    /*
-        Useful to generate split screen multiplayer/view
-    */
-    // Create a viewport info struct
-    VkViewport viewport = {};
-    viewport.x = 0.0f;                                            // x start coordinate
-    viewport.y = 0.0f;                                            // y start coordinate
-    viewport.width = (float)context.swap_chain.extent_2d.width;   // width of viewport (f32)context.framebuffer_width
-    viewport.height = (float)context.swap_chain.extent_2d.height; // height of viewport (f32)context.framebuffer_height
-    viewport.minDepth = 0.0f;                                     // min framebuffer depth
-    viewport.maxDepth = 1.0f;                                     // max framebuffer depth
-
-    // Create a scissor info struct
-    // Similar to cropping
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};                       // Offset to use region from
-    scissor.extent = context.swap_chain.extent_2d; // Extent to describe region to use, starting at offset
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-    /*
-    Most of the states within the graphics pipeline is immutable which requires you to recreate another pipeline for each combination of state
-    you want to change.
-    Thankfully, dynamic states come to the rescue. Some states/settings can be labeled as dynamic to be changed in runtime.
-    NOTE: Even there are some dynamic states active, you still need to recreate swapchain and/or depth buffer accordingly.
-    */
-    // -- DYNAMIC STATES --
-    // Dynamic states to enable
-    // std::vector<VkDynamicState> dynamicStateEnables;
-    // dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
-    // dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic Scissor	: Can resize in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
-
-    const u32 dynamic_state_count = 2;
-    VkDynamicState dynamic_states[dynamic_state_count] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR};
-
-    // Dynamic State creation info
-    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateCreateInfo.dynamicStateCount = dynamic_state_count;
-    dynamicStateCreateInfo.pDynamicStates = dynamic_states;
-
-    // -- RASTERIZER --
-    /*
-    converts primitives into fragments
-    */
-    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-    rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    /*
-    If depthClampEnable is set to VK_TRUE, then fragments that are beyond the near and far planes are clamped to them as opposed to discarding them.
-    Happens in minecraft
-        This is useful in some special cases like shadow maps. Using this requires enabling a GPU feature within PhysicalDeviceFeature while
-        creating logical device. --> deviceFeature.depthClamp = VK_TRUE
-    */
-    rasterizerCreateInfo.depthClampEnable = VK_FALSE; // Change if fragments beyond near/far planes are clipped (default) or clamped to plane
-    // To skip this rasterization stage (Not very common maybe required when you want to carry out some computations with the data coming from prev stages)
-    rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE; // Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
-    // How to color between points (vertices)
-    rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL; // How to handle filling points between vertices
-    rasterizerCreateInfo.lineWidth = 1.0f;                   // How thick lines should be when drawn
-    // Cull->seeing or not seeing the behind or inside of an object.
-    rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;    // Which face of a tri to cull -> do NOT show back
-    rasterizerCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE; // Winding to determine which side is front
-    rasterizerCreateInfo.depthBiasEnable = VK_FALSE;          // Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
-
-    // -- MULTISAMPLING --
-    /*
-    removing the jaggles of the edges
-    */
-    VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-    multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;               // Enable multisample shading or not
-    multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT; // Number of samples to use per fragment
-
-    // -- BLENDING --
-    // Blending decides how to blend a new colour being written to a fragment, with the old value
-
-    // Blend Attachment State (how blending is handled)
-    VkPipelineColorBlendAttachmentState colourState = {};
-    colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT // Colours to apply blending to
-                                 | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colourState.blendEnable = VK_TRUE; // Enable blending
-
-    // Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
-    colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colourState.colorBlendOp = VK_BLEND_OP_ADD;
-
-    // Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * old colour)
-    //			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
-
-    colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colourState.alphaBlendOp = VK_BLEND_OP_ADD;
-    // Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-    VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
-    colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colourBlendingCreateInfo.logicOpEnable = VK_FALSE; // Alternative to calculations is to use logical operations
-    colourBlendingCreateInfo.attachmentCount = 1;
-    colourBlendingCreateInfo.pAttachments = &colourState;
-
-    // -- PIPELINE LAYOUT (TODO: Apply Future Descriptor Set Layouts) --
+    // -- PIPELINE LAYOUT --
     /*
     Uniforms (global objects in shaders) and layouts are required to be specified during pipeline layout
     creation. Even though you are not using, you still have to specify empty(null) ones.
     */
+    // Every resource is reached through the global set, and picked with the push constants.
+    // The uniforms of the frame are bound with a dynamic offset into the uniform ring.
+    VkDescriptorSetLayout setLayouts[2] = {context.bindless.set_layout, context.uniform_ring.set_layout};
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(object_push_constants);
+
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 0;
-    pipelineLayoutCreateInfo.pSetLayouts = NULL;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = NULL;
+    pipelineLayoutCreateInfo.setLayoutCount = 2;
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
     // Create Pipeline Layout
     VkResult result = vkCreatePipelineLayout(context.device.logical_device, &pipelineLayoutCreateInfo, context.allocator, &pipelineLayout);
     if (result != VK_SUCCESS)
         ERR_EXIT("Failed to create Pipeline Layout!\n", "create_graphics_pipeline::vkCreatePipelineLayout");
 
-    // -- DEPTH STENCIL TESTING --
-    // TODO: Set up depth stencil testing
-
-    // -- GRAPHICS PIPELINE CREATION --
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount = 2;                             // Number of shader stages
-    pipelineCreateInfo.pStages = shaderStages;                     // List of shader stages
-    pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo; // All the fixed function pipeline states
-    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = NULL;
-    pipelineCreateInfo.layout = pipelineLayout; // Pipeline Layout pipeline should use
+    // The pipelines themselves are compiled on the workers of the pipeline compiler, the frames skip the draws until then
+    vulkan_graphics_pipeline_desc desc = {};
+    desc.vertex_shader_path = "assets/shaders/shader_base.vert.spv";
+    desc.fragment_shader_path = "assets/shaders/shader_base.frag.spv";
+    desc.layout = pipelineLayout;
     //  this pipeline will be used by the render pass, not that the pipeline will use the render pass.
-    pipelineCreateInfo.renderPass = context.main_renderpass.handle; // Render pass description the pipeline is compatible with
-    pipelineCreateInfo.subpass = 0;                                 // Subpass of render pass to use with pipeline
-
-    // Pipeline Derivatives : Can create multiple pipelines that derive from one another for optimisation
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Existing pipeline to derive from...
-    pipelineCreateInfo.basePipelineIndex = -1;              // or index of pipeline being created to derive from (in case creating multiple at once)
-
-    // Create Graphics Pipeline
-    // You can also use pipeline cache to avoid recreation
-    result = vkCreateGraphicsPipelines(context.device.logical_device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, context.allocator, &graphicsPipeline);
-    if (result != VK_SUCCESS)
-        ERR_EXIT("Failed to create a Graphics Pipeline!\n", "create_graphics_pipeline::vkCreateGraphicsPipelines");
+    desc.render_pass = context.use_dynamic_rendering ? VK_NULL_HANDLE : context.main_renderpass.handle;
+    desc.colour_format = context.swap_chain.surface_format.format;
+    desc.depth_format = context.device.depth_format;
+    desc.samples = context.msaa_samples;
+    desc.cull_mode = VK_CULL_MODE_BACK_BIT; // Which face of a tri to cull -> do NOT show back
+    desc.colour_write = BC_TRUE;
+    desc.blend = BC_TRUE;
+    // Reverse-Z: the nearer fragments have the greater depth. With the pre-pass the depth is already final
+    // when shading, so only the visible fragments are shaded (EQUAL) and the depth is not written again.
+    desc.depth_write = context.depth_prepass ? BC_FALSE : BC_TRUE;
+    desc.depth_compare_op = context.depth_prepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER;
+
+    // Submitted first, so compiled first: the frames draw with it while the others compile, and instead of
+    // them if they fail. It passes on the depth the pre-pass wrote as well as on a cleared depth buffer.
+    vulkan_graphics_pipeline_desc fallback_desc = desc;
+    fallback_desc.blend = BC_FALSE;
+    fallback_desc.depth_write = BC_TRUE;
+    fallback_desc.depth_compare_op = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    fallback_desc.fallback = VULKAN_PIPELINE_INVALID_HANDLE;
+    fallbackPipelineHandle = vulkan_pipeline_compiler_submit(&fallback_desc);
+    if (fallbackPipelineHandle == VULKAN_PIPELINE_INVALID_HANDLE)
+        ERR_EXIT("Failed to submit the fallback Pipeline!\n", "create_graphics_pipeline::vulkan_pipeline_compiler_submit");
+    desc.fallback = fallbackPipelineHandle;
+
+    // The depth pre-pass only runs the vertex shader, and writes the depth the shading pass is tested against.
+    // Submitted first, the shading pass draws nothing without it.
+    depthPrepassPipelineHandle = VULKAN_PIPELINE_INVALID_HANDLE;
+    if (context.depth_prepass)
+    {
+        vulkan_graphics_pipeline_desc depth_desc = desc;
+        depth_desc.fragment_shader_path = NULL;
+        depth_desc.colour_write = BC_FALSE;
+        depth_desc.blend = BC_FALSE;
+        depth_desc.depth_write = BC_TRUE;
+        depth_desc.depth_compare_op = VK_COMPARE_OP_GREATER;
+        depth_desc.fallback = VULKAN_PIPELINE_INVALID_HANDLE;
+        depthPrepassPipelineHandle = vulkan_pipeline_compiler_submit(&depth_desc);
+        if (depthPrepassPipelineHandle == VULKAN_PIPELINE_INVALID_HANDLE)
+            ERR_EXIT("Failed to submit the depth pre-pass Pipeline!\n", "create_graphics_pipeline::vulkan_pipeline_compiler_submit");
+    }
+
+    graphicsPipelineHandle = vulkan_pipeline_compiler_submit(&desc);
+    if (graphicsPipelineHandle == VULKAN_PIPELINE_INVALID_HANDLE)
+        ERR_EXIT("Failed to submit the Graphics Pipeline!\n", "create_graphics_pipeline::vulkan_pipeline_compiler_submit");
+}
 
-    // Destroy Shader Modules, no longer needed after Pipeline created
-    vkDestroyShaderModule(context.device.logical_device, fragmentShaderModule, context.allocator);
-    vkDestroyShaderModule(context.device.logical_device, vertexShaderModule, context.allocator);
+// The instance buffers of each frame slot are read by the vertex shader through the global set
+void add_instance_buffers()
+{
+    for (u32 i = 0; i < context.frames_in_flight; ++i)
+    {
+        vulkan_frame *frame = &context.frames[i];
+        frame->instance_buffer_index = vulkan_bindless_add_buffer(
+            &context, &context.bindless, context.culling.frames[i].instances.handle, 0, VK_WHOLE_SIZE);
+        frame->visible_instance_buffer_index = vulkan_bindless_add_buffer(
+            &context, &context.bindless, context.culling.frames[i].visible_instances.handle, 0, VK_WHOLE_SIZE);
+        if (frame->instance_buffer_index == VULKAN_BINDLESS_INVALID_INDEX || frame->visible_instance_buffer_index == VULKAN_BINDLESS_INVALID_INDEX)
+            ERR_EXIT("Failed to add the instance buffers to the global set!\n", "add_instance_buffers");
+    }
 }
 
 /**
@@ -1393,13 +1778,22 @@ void create_graphics_pipeline()
  */
 void create_frame_buffers()
 {
-    context.swap_chain.framebuffers = (vulkan_framebuffer *)(malloc(sizeof(vulkan_framebuffer) * context.swap_chain.image_count));
+    // The swapchain views are rendered into directly
+    if (context.use_dynamic_rendering)
+        return;
+
+    context.swap_chain.framebuffers = (vulkan_framebuffer *)(realloc(context.swap_chain.framebuffers, sizeof(vulkan_framebuffer) * context.swap_chain.image_count));
     for (uint32_t i = 0; i < context.swap_chain.image_count; ++i)
     {
-        uint32_t attachment_count = 1;
+        // See create_render_pass, the multisampled attachments come last
+        uint32_t attachment_count = context.msaa_samples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+        if (context.swap_chain.depth_resolve.handle)
+            attachment_count = 4;
         VkImageView attachments[/*attachment_count*/] = {
-            context.swap_chain.views[i] // TODO: add Depth attachment
-        };
+            context.swap_chain.views[i],
+            context.swap_chain.depth_attachment.view,
+            context.swap_chain.colour_attachment.view,
+            context.swap_chain.depth_resolve.view};
 
         // Take a copy of the attachments
         context.swap_chain.framebuffers[i].attachments = (VkImageView *)(malloc(sizeof(VkImageView) * attachment_count));
@@ -1441,53 +1835,12 @@ void create_command_pool()
 
     if (result != VK_SUCCESS)
         ERR_EXIT("Failed to create Command pool!\n", "create_command_pool::vkCreateCommandPool");
-}
 
-// FWD decl
-void vulkan_command_buffer_free(
-    vulkan_context *context,
-    VkCommandPool *pool,
-    vulkan_command_buffer *command_buffer);
-/**
- * Command buffers are destroyed automatically during the destruction of
- * the corresponding command pool so no need to explicitly free.
- */
-void create_command_buffers()
-{
-    // Allocate if not defined yet
-    if (!context.graphics_command_buffers)
-    {
-        context.graphics_command_buffers = (vulkan_command_buffer *)malloc(sizeof(vulkan_command_buffer) * context.swap_chain.image_count);
-        for (u32 i = 0; i < context.swap_chain.image_count; ++i)
-            memset(&context.graphics_command_buffers[i], 0, sizeof(vulkan_command_buffer));
-    }
-
-    for (u32 i = 0; i < context.swap_chain.image_count; ++i)
-    {
-        if (context.graphics_command_buffers[i].handle)
-        {
-            // Deallocate the existing ones
-            vulkan_command_buffer_free(
-                &context,
-                &context.device.graphics_command_pool,
-                &context.graphics_command_buffers[i]);
-        }
-        // reset
-        memset(&context.graphics_command_buffers[i], 0, sizeof(vulkan_command_buffer));
-
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = context.device.graphics_command_pool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
-        allocInfo.pNext = 0;
-
-        context.graphics_command_buffers[i].state = COMMAND_BUFFER_STATE_NOT_ALLOCATED;
-        VkResult result = vkAllocateCommandBuffers(context.device.logical_device, &allocInfo, &context.graphics_command_buffers[i].handle);
-        if (result != VK_SUCCESS)
-            ERR_EXIT("Failed to allocate command buffers!\n", "create_command_buffer::vkAllocateCommandBuffers");
-        context.graphics_command_buffers[i].state = COMMAND_BUFFER_STATE_READY;
-    }
+    // Transient pools per frame in flight and recording thread. A frame never touches the pools of a frame
+    // still executing and threads never share a pool, so neither needs any locking.
+    for (u32 i = 0; i < context.frames_in_flight; ++i)
+        for (u32 t = 0; t < context.recording_thread_count; ++t)
+            vulkan_transient_command_pool_create(&context, context.device.graphics_queue_index, &context.frames[i].command_pools[t]);
 }
 
 // Sync
@@ -1508,12 +1861,14 @@ b8 vulkan_fence_wait(vulkan_context *context, vulkan_fence *fence, u64 timeout_n
 {
     if (!fence->is_signaled)
     { // We have to wait
+        f64 wait_start = platform_get_absolute_time();
         VkResult result = vkWaitForFences(
             context->device.logical_device,
             1,
             &fence->handle,
             VK_TRUE,
             timeout_ns);
+        context->frame_stats.fence_wait_ms += (platform_get_absolute_time() - wait_start) * 1000.0;
         switch (result)
         {
         case VK_SUCCESS:
@@ -1557,46 +1912,90 @@ void vulkan_fence_reset(vulkan_context *context, vulkan_fence *fence)
     }
 }
 
+// Resizes images_in_flight to the image count of the swapchain and clears it
+void reset_images_in_flight()
+{
+    // These are stored in pointers because the initial state should be 0, and will be 0 when not in use.
+    // Acutal fences are not owned by this list.
+    free(context.images_in_flight);
+    context.images_in_flight = (u64 *)(malloc(sizeof(u64) * context.swap_chain.image_count));
+    for (u32 i = 0; i < context.swap_chain.image_count; ++i)
+    {
+        context.images_in_flight[i] = 0;
+    }
+}
+
 void create_sync_objects()
 {
-    // TODO: 1 for now
-    context.image_available_semaphores = (VkSemaphore *)malloc(sizeof(VkSemaphore) * context.swap_chain.max_frames_in_flight);
-    context.queue_complete_semaphores = (VkSemaphore *)malloc(sizeof(VkSemaphore) * context.swap_chain.max_frames_in_flight);
-    context.in_flight_fences = (vulkan_fence *)(malloc(sizeof(vulkan_fence) * context.swap_chain.max_frames_in_flight));
+    if (context.use_timeline)
+        vulkan_timeline_create(&context, &context.graphics_timeline);
 
-    for (u8 i = 0; i < context.swap_chain.max_frames_in_flight; ++i)
+    for (u32 i = 0; i < context.frames_in_flight; ++i)
     {
+        vulkan_frame *frame = &context.frames[i];
+
         VkSemaphoreCreateInfo semaphore_create_info = {};
         semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        VkResult result = vkCreateSemaphore(context.device.logical_device, &semaphore_create_info, context.allocator, &context.image_available_semaphores[i]);
+        VkResult result = vkCreateSemaphore(context.device.logical_device, &semaphore_create_info, context.allocator, &frame->image_available_semaphore);
         if (result != VK_SUCCESS)
-            ERR_EXIT("Failed to create semaphore for image_available_semaphores.\n", "vkCreateSemaphore");
+            ERR_EXIT("Failed to create semaphore for image_available_semaphore.\n", "vkCreateSemaphore");
 
-        result = vkCreateSemaphore(context.device.logical_device, &semaphore_create_info, context.allocator, &context.queue_complete_semaphores[i]);
+        result = vkCreateSemaphore(context.device.logical_device, &semaphore_create_info, context.allocator, &frame->queue_complete_semaphore);
         if (result != VK_SUCCESS)
-            ERR_EXIT("Failed to create semaphore for queue_complete_semaphores.\n", "vkCreateSemaphore");
+            ERR_EXIT("Failed to create semaphore for queue_complete_semaphore.\n", "vkCreateSemaphore");
 
-        vulkan_fence_create(&context, true, &context.in_flight_fences[i]);
+        // Signaled so that the first use of the frame does not wait
+        if (!context.use_timeline)
+            vulkan_fence_create(&context, true, &frame->in_flight_fence);
     }
 
-    // In flight fences should not yet exist at this point, so clear the list. These are stored in pointers
-    // because the initial state should be 0, and will be 0 when not in use. Acutal fences are not owned
-    // by this list.
-    context.images_in_flight = (vulkan_fence **)(malloc(sizeof(vulkan_fence *) * context.swap_chain.image_count));
-    for (u32 i = 0; i < context.swap_chain.image_count; ++i)
-    {
-        context.images_in_flight[i] = 0;
-    }
+    // In flight fences should not yet exist at this point, so clear the list.
+    reset_images_in_flight();
 }
 
 //--------------
 // Regenerate
 //--------------
-void destroy_framebuffers();
-void destroy_command_buffers(b8);
-void destroy_swapchain(vulkan_context *, b8);
 void create_frame_buffers();
-void create_command_buffers();
+
+// The single sample depth the depth pyramid is built from, see create_attachments
+static const vulkan_image *pyramid_depth()
+{
+    if (context.swap_chain.depth_resolve.handle)
+        return &context.swap_chain.depth_resolve;
+    return &context.swap_chain.depth_attachment;
+}
+
+// Hands the framebuffers, views (and the images owned by the headless swapchain) over to the
+// deletion queue. Frames in flight may still be rendering into them.
+void retire_swapchain_resources()
+{
+    vulkan_swapchain *swap_chain = &context.swap_chain;
+    for (u32 i = 0; i < swap_chain->image_count; ++i)
+    {
+        if (!context.use_dynamic_rendering)
+        {
+            vulkan_framebuffer *frame_buffer = &swap_chain->framebuffers[i];
+            vulkan_deletion_queue_push(&context.deletion_queue, VULKAN_DELETION_FRAMEBUFFER, (u64)frame_buffer->handle, context.frame_number);
+            free(frame_buffer->attachments);
+            memset(frame_buffer, 0, sizeof(vulkan_framebuffer));
+        }
+
+        vulkan_deletion_queue_push(&context.deletion_queue, VULKAN_DELETION_IMAGE_VIEW, (u64)swap_chain->views[i], context.frame_number);
+        swap_chain->views[i] = VK_NULL_HANDLE;
+
+        if (context.headless)
+        {
+            vulkan_deletion_queue_push(&context.deletion_queue, VULKAN_DELETION_IMAGE, (u64)swap_chain->images[i], context.frame_number);
+            vulkan_deletion_queue_push_allocation(&context.deletion_queue, &swap_chain->image_allocations[i], context.frame_number);
+            memset(&swap_chain->image_allocations[i], 0, sizeof(vulkan_allocation));
+        }
+        swap_chain->images[i] = VK_NULL_HANDLE;
+    }
+    vulkan_image_retire(&context, &swap_chain->depth_attachment, context.frame_number);
+    vulkan_image_retire(&context, &swap_chain->colour_attachment, context.frame_number);
+    vulkan_image_retire(&context, &swap_chain->depth_resolve, context.frame_number);
+}
 
 b8 recreate_swapchain(GLFWwindow *window, b8 use_cached_framebuffer_size)
 {
@@ -1614,18 +2013,11 @@ b8 recreate_swapchain(GLFWwindow *window, b8 use_cached_framebuffer_size)
 
     context.recreating_swapchain = BC_TRUE;
 
-    // Wait for any operation to complete
-    vkDeviceWaitIdle(context.device.logical_device);
-
-    // 1. Destroy old resources first
-    destroy_command_buffers(VK_FALSE);
-    destroy_framebuffers();
-    destroy_swapchain(&context, VK_TRUE);
-    for (u32 i = 0; i < context.swap_chain.image_count; ++i)
-        context.images_in_flight[i] = 0;
-
-    // TODO: Make sure we have most up-to-date format available
-    // vulkan_device_detect_depth_format(&context.device);
+    // 1. Retire old resources first
+    // There is no wait for the device to be idle, the frames in flight keep going and the old resources
+    // are destroyed once they complete.
+    // Command buffers belong to the frames in flight, not to the images, so they are kept.
+    retire_swapchain_resources();
 
     // 2. Create
     /// Swapchain
@@ -1635,6 +2027,11 @@ b8 recreate_swapchain(GLFWwindow *window, b8 use_cached_framebuffer_size)
         context.framebuffer_height = cached_framebuffer_height;
     }
     create_swap_chain(window, context.framebuffer_width, context.framebuffer_height);
+    create_attachments();
+    if (context.occlusion_culling && !vulkan_depth_pyramid_resize(&context, &context.depth_pyramid, pyramid_depth(), context.frame_number))
+        ERR_EXIT("Failed to resize the depth pyramid.\n", "recreate_swapchain");
+    // The image count may have changed
+    reset_images_in_flight();
     if (use_cached_framebuffer_size)
     {
         context.main_renderpass.x = 0;
@@ -1651,7 +2048,6 @@ b8 recreate_swapchain(GLFWwindow *window, b8 use_cached_framebuffer_size)
     context.framebuffer_size_last_generation = context.framebuffer_size_generation;
 
     create_frame_buffers();
-    create_command_buffers();
 
     /// 3. Completed
     context.recreating_swapchain = BC_FALSE;
@@ -1673,7 +2069,8 @@ void command_buffer_begin(vulkan_command_buffer *command_buffer)
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING;
 }
 
-void renderpass_begin(vulkan_command_buffer *command_buffer, vulkan_renderpass *renderpass, u32 image_index)
+// contents: VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS if the subpass is recorded by secondary command buffers
+void renderpass_begin(vulkan_command_buffer *command_buffer, vulkan_renderpass *renderpass, u32 image_index, VkSubpassContents contents)
 {
     VkRenderPassBeginInfo begin_info = {};
     begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1685,42 +2082,249 @@ void renderpass_begin(vulkan_command_buffer *command_buffer, vulkan_renderpass *
     // begin_info.renderArea.extent.width = renderpass->w;
     // begin_info.renderArea.extent.height = renderpass->h;
 
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    begin_info.clearValueCount = 1;
-    begin_info.pClearValues = &clearColor;
+    // Indexed by attachment, the multisampled one is cleared instead of the swapchain image with MSAA
+    VkClearValue clearValues[3] = {};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearValues[1].depthStencil.depth = renderpass->depth;
+    clearValues[1].depthStencil.stencil = renderpass->stencil;
+    clearValues[2].color = clearValues[0].color;
+    begin_info.clearValueCount = 3;
+    begin_info.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(command_buffer->handle, &begin_info, contents);
+    command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
+}
 
-    vkCmdBeginRenderPass(command_buffer->handle, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+// Dynamic rendering counterpart of renderpass_begin, straight into the swapchain view
+void rendering_begin(vulkan_command_buffer *command_buffer, vulkan_renderpass *renderpass, u32 image_index, VkSubpassContents contents)
+{
+    // The layout transitions and the dependency of the render pass are barriers here.
+    // The previous contents are cleared. Waits for the acquire semaphore, which is waited on at this stage.
+    vulkan_image_barrier(
+        command_buffer->handle, context.swap_chain.images[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        0, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    // The depth buffer is shared by the frames, the clear waits for the depth writes of the previous frame, and with
+    // occlusion culling for the depth pyramid of the previous frame to be done reading it
+    const vulkan_image *depth = &context.swap_chain.depth_attachment;
+    vulkan_image_barrier(
+        command_buffer->handle, depth->handle, depth->aspect,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+    // So is the single sample depth it is resolved into, written at the colour output stage
+    const vulkan_image *depth_resolve = &context.swap_chain.depth_resolve;
+    if (depth_resolve->handle)
+        vulkan_image_barrier(
+            command_buffer->handle, depth_resolve->handle, depth_resolve->aspect,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    // So is the multisampled colour target
+    const vulkan_image *msaa = &context.swap_chain.colour_attachment;
+    if (msaa->handle)
+        vulkan_image_barrier(
+            command_buffer->handle, msaa->handle, msaa->aspect,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    VkRenderingAttachmentInfo colour_attachment = {};
+    colour_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colour_attachment.imageView = context.swap_chain.views[image_index];
+    colour_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colour_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colour_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colour_attachment.clearValue.color.float32[3] = 1.0f;
+    if (msaa->handle)
+    {
+        // Rendered into the samples, averaged into the swapchain image at the end and dropped
+        colour_attachment.imageView = msaa->view;
+        colour_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colour_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        colour_attachment.resolveImageView = context.swap_chain.views[image_index];
+        colour_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkRenderingAttachmentInfo depth_attachment = {};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depth_attachment.imageView = depth->view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil.depth = renderpass->depth;
+    depth_attachment.clearValue.depthStencil.stencil = renderpass->stencil;
+    // Kept for the depth pyramid, see create_attachments
+    if (context.occlusion_culling && !msaa->handle)
+        depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    if (depth_resolve->handle)
+    {
+        depth_attachment.resolveMode = context.depth_resolve_mode;
+        depth_attachment.resolveImageView = depth_resolve->view;
+        depth_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    VkRenderingInfo rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.flags = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    rendering_info.renderArea.offset.x = renderpass->x;
+    rendering_info.renderArea.offset.y = renderpass->y;
+    rendering_info.renderArea.extent = context.swap_chain.extent_2d;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &colour_attachment;
+    rendering_info.pDepthAttachment = &depth_attachment;
+
+    vkCmdBeginRendering(command_buffer->handle, &rendering_info);
     command_buffer->state = COMMAND_BUFFER_STATE_IN_RENDER_PASS;
 }
 
+void rendering_end(vulkan_command_buffer *command_buffer, u32 image_index)
+{
+    vkCmdEndRendering(command_buffer->handle);
+    // Nothing is presented in headless mode; leave the image ready to be copied out instead
+    vulkan_image_barrier(
+        command_buffer->handle, context.swap_chain.images[image_index], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        context.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+// Updates completed_frame_count without blocking. Only the timeline can tell about any frame,
+// with fences it is updated as they are waited on.
+void poll_completed_frames()
+{
+    if (context.use_timeline)
+        context.completed_frame_count = vulkan_timeline_poll(&context, &context.graphics_timeline);
+}
+
+// Blocks until the first frame_count frames have completed on the GPU
+b8 wait_for_frame(u64 frame_count)
+{
+    if (frame_count <= context.completed_frame_count)
+        return BC_TRUE;
+
+    if (context.use_timeline)
+    {
+        if (!vulkan_timeline_wait(&context, &context.graphics_timeline, frame_count, UINT64_MAX))
+            return BC_FALSE;
+    }
+    else
+    {
+        // Frames are submitted round robin over the frames in flight. If the slot of that frame has
+        // been submitted again, its fence no longer tells about it, but then it has been waited on already.
+        vulkan_frame *frame = &context.frames[(frame_count - 1) % context.frames_in_flight];
+        if (frame->submitted_frame_count == frame_count && !vulkan_fence_wait(&context, &frame->in_flight_fence, UINT64_MAX))
+            return BC_FALSE;
+    }
+
+    context.completed_frame_count = frame_count;
+    return BC_TRUE;
+}
+
+// Until renderer_set_instances is called, draw_count instances at the origin cycle through the meshes
+void update_default_instances()
+{
+    u32 mesh_count = context.geometry.mesh_count;
+    if (context.custom_instances ||
+        (context.default_instance_count == context.draw_count && context.default_instance_mesh_count == mesh_count))
+        return;
+
+    u32 instance_count = mesh_count ? context.draw_count : 0;
+    renderer_instance *instances = (renderer_instance *)(calloc(instance_count + 1, sizeof(renderer_instance)));
+    for (u32 i = 0; i < instance_count; ++i)
+        instances[i].mesh = i % mesh_count;
+    vulkan_culling_set_instances(&context.culling, &context.geometry, instances, instance_count);
+    free(instances);
+
+    context.default_instance_count = context.draw_count;
+    context.default_instance_mesh_count = mesh_count;
+}
+
+// Written into the uniform ring once per frame, the GPU is done with the part of the frame slot
+void update_global_uniforms()
+{
+    vulkan_uniform_ring_begin_frame(&context.uniform_ring, context.current_frame);
+    global_uniforms *globals = (global_uniforms *)vulkan_uniform_ring_push(&context.uniform_ring, sizeof(global_uniforms), &context.global_uniform_offset);
+    if (globals)
+        memcpy(globals->view_projection, context.view_projection, sizeof(globals->view_projection));
+}
+
+// A pipeline failing to compile is a missing or broken shader: without this the frames would silently draw
+// nothing forever. The pre-pass and shading pipelines can fail as long as their fallback did not.
+static void check_pipelines()
+{
+    if (vulkan_pipeline_compiler_status(fallbackPipelineHandle) != VULKAN_PIPELINE_STATUS_FAILED)
+        return;
+    if (vulkan_pipeline_compiler_status(graphicsPipelineHandle) == VULKAN_PIPELINE_STATUS_FAILED)
+        ERR_EXIT("Failed to compile the Graphics Pipeline and its fallback!\n", "check_pipelines");
+    if (context.depth_prepass && vulkan_pipeline_compiler_status(depthPrepassPipelineHandle) == VULKAN_PIPELINE_STATUS_FAILED)
+        ERR_EXIT("Failed to compile the depth pre-pass Pipeline and the fallback!\n", "check_pipelines");
+}
+
+// The culling pipelines are compute pipelines, which compile in a few milliseconds: they are rebuilt right away.
+// Called before the culling passes are recorded, so the frame records with the rebuilt one.
+static b8 reload_compute_shader(const char *path)
+{
+    vulkan_compute_pipeline *pipeline;
+    if (!strcmp(path, CULL_INSTANCES_SHADER_PATH))
+        pipeline = &context.culling.cull_pipeline;
+    else if (!strcmp(path, COMPACT_DRAWS_SHADER_PATH))
+        pipeline = &context.culling.compact_pipeline;
+    else if (!strcmp(path, DEPTH_PYRAMID_SHADER_PATH))
+        pipeline = &context.depth_pyramid.pipeline;
+    else
+        return BC_FALSE;
+    // Not created without GPU (occlusion) culling
+    if (!pipeline->handle)
+        return BC_TRUE;
+
+    VkShaderModule shader = try_create_shader_module(path);
+    if (shader && vulkan_compute_pipeline_reload(&context, shader, pipeline, context.frame_number))
+        printf("Reloaded the pipeline of %s.\n", path);
+    if (shader)
+        vkDestroyShaderModule(context.device.logical_device, shader, context.allocator);
+    return BC_TRUE;
+}
+
+// Rebuilds the pipelines using the shaders recompiled by the watcher, the graphics ones through the compiler
+static void reload_changed_shaders()
+{
+    char paths[8][SHADER_WATCHER_MAX_PATH];
+    u32 count;
+    while ((count = shader_watcher_poll(paths, 8)) > 0)
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            if (!reload_compute_shader(paths[i]) && !vulkan_pipeline_compiler_reload(paths[i]))
+                printf("WARN: reload_changed_shaders - No pipeline uses %s.\n", paths[i]);
+        }
+    }
+}
+
 b8 begin_frame(f32 delta_time, GLFWwindow *window)
 {
     context.frame_delta_time = delta_time;
+    context.frame_stats.fence_wait_ms = 0;
+    context.frame_stats.acquire_ms = 0;
+    context.frame_stats.present_to_acquire_ms = 0;
+    context.frame_stats.host_allocation_calls = vulkan_host_allocator_begin_frame();
 
     // Check if recreating swap chain and boot out.
     if (context.recreating_swapchain)
     {
-        // Make sure device is in idle and is not doing anything so you can proceed.
-        VkResult result = vkDeviceWaitIdle(context.device.logical_device);
-        if (!vulkan_result_is_success(result))
-        {
-            ERR_EXIT("vulkan_renderer_backend_begin_frame vkDeviceWaitIdle failed:", vulkan_result_string(result, true));
-            return BC_FALSE;
-        }
         printf("Recreating swapchain, booting.");
         return BC_FALSE;
     }
 
     // Check if the framebuffer has been resized. If so, a new swapchain must be created.
+    // The frames in flight are not waited on, see recreate_swapchain.
     if (context.framebuffer_size_generation != context.framebuffer_size_last_generation)
     {
-        VkResult result = vkDeviceWaitIdle(context.device.logical_device);
-        if (!vulkan_result_is_success(result))
-        {
-            ERR_EXIT("vulkan_renderer_backend_begin_frame vkDeviceWaitIdle (2) failed:", vulkan_result_string(result, true));
-            return BC_FALSE;
-        }
-
         // If the swapchain recreation failed (because, for example, the window was minimized),
         // boot out before unsetting the flag.
         if (!recreate_swapchain(window, 1))
@@ -1732,25 +2336,65 @@ b8 begin_frame(f32 delta_time, GLFWwindow *window)
         return BC_FALSE;
     }
 
-    // Wait for fence
-    if (!vulkan_fence_wait(
-            &context,
-            &context.in_flight_fences[context.current_frame],
-            UINT64_MAX))
+    // Same for a new presentation mode, there is nothing to present to when headless
+    if (context.present_policy_changed)
+    {
+        if (context.headless)
+            context.present_policy_changed = BC_FALSE;
+        else
+        {
+            // Tried again next frame if it failed (i.e. minimized window)
+            if (recreate_swapchain(window, 0))
+                context.present_policy_changed = BC_FALSE;
+            return BC_FALSE;
+        }
+    }
+
+    vulkan_frame *frame = &context.frames[context.current_frame];
+
+    // Wait until the GPU is done with the previous use of this frame's resources
+    b8 frame_available = context.use_timeline
+                             ? vulkan_timeline_wait(&context, &context.graphics_timeline, frame->submitted_frame_count, UINT64_MAX)
+                             : vulkan_fence_wait(&context, &frame->in_flight_fence, UINT64_MAX);
+    if (!frame_available)
     {
         printf("WARN: In-flight fence wait failure!"); // not an error but if we start to see too many, we should keep an eye on it,
         return BC_FALSE;
     }
 
+    // Frames complete in submission order, so every frame up to the last one using this slot is done
+    if (frame->submitted_frame_count > context.completed_frame_count)
+        context.completed_frame_count = frame->submitted_frame_count;
+    // Later frames may be done too
+    poll_completed_frames();
+    vulkan_deletion_queue_flush(&context, &context.deletion_queue, context.completed_frame_count);
+    vulkan_bindless_begin_frame(&context, &context.bindless, context.current_frame, context.completed_frame_count);
+    // Frame boundary: the pipelines rebuilt since the last frame are swapped in
+    if (context.shader_hot_reload)
+        reload_changed_shaders();
+    vulkan_pipeline_compiler_begin_frame(context.frame_number);
+    update_global_uniforms();
+
     // vulkan_swapchain_acquire_next_image_index
     // Acquire the next image from the swap chain. Pass along the semaphore that should signaled when this completes.
     // This same semaphore will later be waited on by the queue submission to ensure this image is available.
-    VkResult result = vkAcquireNextImageKHR(
-        context.device.logical_device, context.swap_chain.handle,
-        UINT64_MAX,
-        context.image_available_semaphores[context.current_frame],
-        VK_NULL_HANDLE,
-        &context.image_index);
+    // Headless images are owned by us, so just walk the ring. end_frame still waits on images_in_flight
+    // before the image is reused.
+    VkResult result = VK_SUCCESS;
+    f64 acquire_start = platform_get_absolute_time();
+    if (context.headless)
+        context.image_index = (context.image_index + 1) % context.swap_chain.image_count;
+    else
+        result = vkAcquireNextImageKHR(
+            context.device.logical_device, context.swap_chain.handle,
+            UINT64_MAX,
+            frame->image_available_semaphore,
+            VK_NULL_HANDLE,
+            &context.image_index);
+    f64 acquire_end = platform_get_absolute_time();
+    context.frame_stats.acquire_ms = (acquire_end - acquire_start) * 1000.0;
+    if (!context.headless && result >= 0 && context.swap_chain.present_times[context.image_index] > 0)
+        context.frame_stats.present_to_acquire_ms = (acquire_end - context.swap_chain.present_times[context.image_index]) * 1000.0;
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     { // Not a failure
         // Trigger swapchain recreation, then boot out of the render loop.
@@ -1765,17 +2409,57 @@ b8 begin_frame(f32 delta_time, GLFWwindow *window)
     }
     // end: vulkan_swapchain_acquire_next_image_index
 
-    vulkan_fence_reset(&context, &context.in_flight_fences[context.current_frame]);
+    if (!context.use_timeline)
+        vulkan_fence_reset(&context, &frame->in_flight_fence);
+
+    // The GPU is done with every command buffer of this frame, so reset them in bulk, pool by pool,
+    // rather than one by one
+    for (u32 t = 0; t < context.recording_thread_count; ++t)
+        vulkan_transient_command_pool_reset(&context, &frame->command_pools[t]);
 
     // Begin recording commands
-    vulkan_command_buffer *command_buffer = &context.graphics_command_buffers[context.image_index];
-    // reset first
-    vkResetCommandBuffer(command_buffer->handle, 0);
+    vulkan_command_buffer *command_buffer = &frame->command_buffer;
+    command_buffer->handle = vulkan_transient_command_pool_acquire(&context, &frame->command_pools[0], VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     command_buffer->state = COMMAND_BUFFER_STATE_READY;
     command_buffer_begin(command_buffer);
+
+    // The fence of this frame slot has been waited on, so its previous queries can be collected
+    vulkan_gpu_timer_begin_frame(&context, &context.gpu_timer, command_buffer->handle, context.current_frame, context.frame_number);
+
+    // Submit the uploads queued since the last frame and take over what the transfer queue released.
+    // On the graphics queue they are simply submitted ahead of the frame.
+    if (!vulkan_uploader_flush(&context, &context.uploader))
+        printf("WARN: begin_frame - Failed to submit the pending uploads.\n");
+    vulkan_uploader_record_acquire(&context.uploader, command_buffer->handle);
+
+    // Compute passes are recorded from here (see vulkan_compute.h) and submitted ahead of the render pass consuming them
+    vulkan_compute_begin_frame(&context, &context.compute, context.current_frame);
+    update_default_instances();
+    // The fallback is drawn with until the pipelines are compiled, nothing until it is.
+    // The shading pass only passes on the depth of the pre-pass, without it the fallback is drawn alone.
+    graphicsPipeline = vulkan_pipeline_compiler_get(graphicsPipelineHandle);
+    depthPrepassPipeline = context.depth_prepass ? vulkan_pipeline_compiler_get(depthPrepassPipelineHandle) : VK_NULL_HANDLE;
+    if (context.depth_prepass && !depthPrepassPipeline)
+        graphicsPipeline = vulkan_pipeline_compiler_get(fallbackPipelineHandle);
+    if (!graphicsPipeline)
+        check_pipelines();
+    vulkan_culling_begin_frame(&context.culling, &context.draws, &context.geometry, graphicsPipeline, context.current_frame);
+    vulkan_culling_record(
+        &context, &context.culling, &context.compute, &context.draws, context.occlusion_culling ? &context.depth_pyramid : NULL,
+        command_buffer->handle, context.view_projection);
+    if (!vulkan_compute_submit(&context, &context.compute, command_buffer->handle))
+        printf("WARN: begin_frame - Failed to submit the compute work.\n");
+
+    vulkan_gpu_timer_render_pass_begin(&context.gpu_timer, command_buffer->handle, context.current_frame);
+    vulkan_gpu_timer_statistics_begin(&context.gpu_timer, command_buffer->handle, context.current_frame);
+
     context.main_renderpass.w = context.framebuffer_width;
     context.main_renderpass.h = context.framebuffer_height;
-    renderpass_begin(command_buffer, &context.main_renderpass, context.image_index);
+    VkSubpassContents contents = context.recording_thread_count > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+    if (context.use_dynamic_rendering)
+        rendering_begin(command_buffer, &context.main_renderpass, context.image_index, contents);
+    else
+        renderpass_begin(command_buffer, &context.main_renderpass, context.image_index, contents);
 
     return BC_TRUE;
 }
@@ -1783,14 +2467,10 @@ b8 begin_frame(f32 delta_time, GLFWwindow *window)
 //--------------
 // Update
 //--------------
-void update_global_state()
+// State is not inherited by secondary command buffers, so this is recorded by each of them
+// Pipelines are bound by the draw batches
+void update_global_state(VkCommandBuffer command_buffer)
 {
-    vulkan_command_buffer *command_buffer = &context.graphics_command_buffers[context.image_index];
-
-    // vulkan_object_shader_use
-    vkCmdBindPipeline(command_buffer->handle, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-    // END: // vulkan_object_shader_use
-
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -1798,39 +2478,189 @@ void update_global_state()
     viewport.height = (f32)context.framebuffer_height; // context.swap_chain.extent_2d.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(command_buffer->handle, 0, 1, &viewport);
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
     scissor.extent.width = context.framebuffer_width; // context.swap_chain.extent_2d;
     scissor.extent.height = context.framebuffer_height;
-    vkCmdSetScissor(command_buffer->handle, 0, 1, &scissor);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    vulkan_geometry_bind(&context.geometry, command_buffer);
 
     // vulkan_object_shader_update_global_state
+    // Every pipeline shares the layout, so the global set and the push constants stay bound across the batches
+    vulkan_bindless_bind(&context.bindless, command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+    vulkan_uniform_ring_bind(&context.uniform_ring, command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, context.global_uniform_offset);
+    const vulkan_frame *frame = &context.frames[context.current_frame];
+    object_push_constants constants;
+    constants.instance_buffer_index = frame->instance_buffer_index;
+    constants.visible_instance_buffer_index = frame->visible_instance_buffer_index;
+    vkCmdPushConstants(command_buffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
     // END: vulkan_object_shader_update_global_state
 }
 
-void update_object()
+// Records the draw batches [first_batch, first_batch + batch_count), each one is timed as a single draw
+void update_object(VkCommandBuffer command_buffer, u32 first_batch, u32 batch_count)
 {
-    vulkan_command_buffer *command_buffer = &context.graphics_command_buffers[context.image_index];
+    for (u32 i = first_batch; i < first_batch + batch_count; ++i)
+    {
+        vulkan_gpu_timer_draw_begin(&context.gpu_timer, command_buffer, context.current_frame, i);
+        vulkan_indirect_draw_batch(&context.draws, command_buffer, i);
+        vulkan_gpu_timer_draw_end(&context.gpu_timer, command_buffer, context.current_frame, i);
+    }
+}
 
-    vkCmdDraw(command_buffer->handle, 3, 1, 0, 0);
+// Records the depth of the batches [first_batch, first_batch + batch_count) with the depth pre-pass pipeline
+void update_depth_prepass(VkCommandBuffer command_buffer, u32 first_batch, u32 batch_count)
+{
+    for (u32 i = first_batch; i < first_batch + batch_count; ++i)
+        vulkan_indirect_draw_batch_with_pipeline(&context.draws, command_buffer, i, depthPrepassPipeline);
+}
+
+typedef struct record_draws_job_data
+{
+    u32 first_batch;
+    u32 batch_count;
+    // Records the depth pre-pass of the batches rather than their shading
+    b8 depth_prepass;
+    // Secondary command buffer recorded by the job
+    VkCommandBuffer command_buffer;
+} record_draws_job_data;
+
+// The depth pre-pass jobs come first
+static record_draws_job_data record_draws_jobs[VULKAN_MAX_RECORDING_THREADS * 2];
+
+// Runs on any thread. Everything it reads from the context is left untouched while recording.
+static void record_draws_job(void *data, u32 thread_index)
+{
+    record_draws_job_data *job_data = (record_draws_job_data *)data;
+    vulkan_frame *frame = &context.frames[context.current_frame];
+
+    // Each thread has its own pool, so allocating from it does not need any locking
+    VkCommandBuffer command_buffer = vulkan_transient_command_pool_acquire(
+        &context, &frame->command_pools[thread_index], VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    VkCommandBufferInheritanceInfo inheritance_info = {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    // With dynamic rendering the attachments are described instead of the render pass
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {};
+    inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritance_rendering_info.colorAttachmentCount = 1;
+    inheritance_rendering_info.pColorAttachmentFormats = &context.swap_chain.surface_format.format;
+    inheritance_rendering_info.depthAttachmentFormat = context.device.depth_format;
+    inheritance_rendering_info.rasterizationSamples = context.msaa_samples;
+    if (context.use_dynamic_rendering)
+        inheritance_info.pNext = &inheritance_rendering_info;
+    else
+    {
+        inheritance_info.renderPass = context.main_renderpass.handle;
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = context.swap_chain.framebuffers[context.image_index].handle;
+    }
+    if (context.gpu_timer.statistics_enabled)
+        inheritance_info.pipelineStatistics = context.gpu_timer.statistic_flags;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // Entirely inside the render pass and recorded anew every frame
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to begin recording secondary command buffer", "record_draws_job");
+
+    update_global_state(command_buffer);
+    if (job_data->depth_prepass)
+        update_depth_prepass(command_buffer, job_data->first_batch, job_data->batch_count);
+    else
+        update_object(command_buffer, job_data->first_batch, job_data->batch_count);
+
+    result = vkEndCommandBuffer(command_buffer);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to record secondary command buffer!\n", "record_draws_job");
+
+    job_data->command_buffer = command_buffer;
+}
+
+// Splits the draw batches into a contiguous range per recording thread and executes the
+// resulting secondary command buffers in batch order, the ones of the depth pre-pass first
+void update_parallel(VkCommandBuffer primary)
+{
+    u32 total_batches = context.draws.batch_count;
+    u32 range_count = context.recording_thread_count < total_batches ? context.recording_thread_count : total_batches;
+    if (!range_count)
+        return;
+
+    u32 pass_count = depthPrepassPipeline ? 2 : 1;
+    u32 job_count = range_count * pass_count;
+    job jobs[VULKAN_MAX_RECORDING_THREADS * 2];
+    for (u32 pass = 0; pass < pass_count; ++pass)
+    {
+        u32 first_batch = 0;
+        for (u32 r = 0; r < range_count; ++r)
+        {
+            u32 i = pass * range_count + r;
+            // Spread the remainder over the first jobs
+            u32 batch_count = total_batches / range_count + (r < total_batches % range_count ? 1 : 0);
+            record_draws_jobs[i].first_batch = first_batch;
+            record_draws_jobs[i].batch_count = batch_count;
+            record_draws_jobs[i].depth_prepass = pass_count == 2 && pass == 0;
+            record_draws_jobs[i].command_buffer = VK_NULL_HANDLE;
+            first_batch += batch_count;
+
+            jobs[i].function = record_draws_job;
+            jobs[i].data = &record_draws_jobs[i];
+        }
+    }
+
+    // The main thread records a share of the draws as well while waiting
+    job_counter counter = {};
+    job_system_submit(jobs, job_count, &counter);
+    job_system_wait(&counter);
+
+    VkCommandBuffer secondaries[VULKAN_MAX_RECORDING_THREADS * 2];
+    for (u32 i = 0; i < job_count; ++i)
+        secondaries[i] = record_draws_jobs[i].command_buffer;
+    vkCmdExecuteCommands(primary, job_count, secondaries);
 }
 
 void update()
 {
-    update_global_state();
-    update_object();
+    VkCommandBuffer command_buffer = context.frames[context.current_frame].command_buffer.handle;
+    // Bound from here on, possibly by the recording threads
+    vulkan_bindless_close_frame(&context.bindless);
+    if (context.recording_thread_count > 1)
+    {
+        update_parallel(command_buffer);
+        return;
+    }
+
+    update_global_state(command_buffer);
+    if (depthPrepassPipeline)
+        update_depth_prepass(command_buffer, 0, context.draws.batch_count);
+    update_object(command_buffer, 0, context.draws.batch_count);
 }
 //--------------
 // End
 //--------------
 b8 end_frame(GLFWwindow *window, f32 delta_time)
 {
-    vulkan_command_buffer *command_buffer = &context.graphics_command_buffers[context.image_index];
+    vulkan_frame *frame = &context.frames[context.current_frame];
+    vulkan_command_buffer *command_buffer = &frame->command_buffer;
 
     // End renderpass
-    vkCmdEndRenderPass(command_buffer->handle);
+    if (context.use_dynamic_rendering)
+        rendering_end(command_buffer, context.image_index);
+    else
+        vkCmdEndRenderPass(command_buffer->handle);
+    vulkan_gpu_timer_statistics_end(&context.gpu_timer, command_buffer->handle, context.current_frame);
+    vulkan_gpu_timer_render_pass_end(&context.gpu_timer, command_buffer->handle, context.current_frame, context.draws.batch_count);
+    // Culled against by the next frame
+    if (context.occlusion_culling)
+        vulkan_depth_pyramid_record(&context, &context.depth_pyramid, command_buffer->handle, context.current_frame, context.view_projection);
+    vulkan_gpu_timer_end_frame(&context.gpu_timer, command_buffer->handle, context.current_frame);
 
     // End command buffer
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING;
@@ -1839,20 +2669,12 @@ b8 end_frame(GLFWwindow *window, f32 delta_time)
         ERR_EXIT("failed to record command buffer!\n", "vkEndCommandBuffer");
     command_buffer->state = COMMAND_BUFFER_STATE_RECORDING_ENDED;
 
-    // Make sure the previous frame is not using this image (i.e. its fence is being waited on)
-    if (context.images_in_flight[context.image_index] != VK_NULL_HANDLE)
-    {                      // was frame
-        vulkan_fence_wait( // Make sure previous frame is not using this image
-            &context,
-            context.images_in_flight[context.image_index],
-            UINT64_MAX);
-    }
-
-    // Mark the image fence as in-use by this frame.
-    context.images_in_flight[context.image_index] = &context.in_flight_fences[context.current_frame];
+    // Make sure the previous frame is not using this image. Usually it has long completed, then this is only a comparison.
+    if (!wait_for_frame(context.images_in_flight[context.image_index]))
+        printf("WARN: Image in-flight wait failure!");
 
-    // Reset the fence for use on the next frame
-    vulkan_fence_reset(&context, &context.in_flight_fences[context.current_frame]);
+    // Mark the image as in-use by this frame.
+    context.images_in_flight[context.image_index] = context.frame_number + 1;
 
     // Submit the command buffer
     // Begin queue submission
@@ -1862,24 +2684,89 @@ b8 end_frame(GLFWwindow *window, f32 delta_time)
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &(command_buffer->handle);
     // The semaphore(s) to be signaled when the queue is complete.
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &context.queue_complete_semaphores[context.current_frame];
-    // Wait semaphore ensures that the operation cannot begin until the image is available.
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &context.image_available_semaphores[context.current_frame];
+    // In headless mode there is neither an acquire to wait for nor a present waiting on us.
+    VkSemaphore signal_semaphores[3];
+    uint64_t signal_values[3];
+    u32 signal_count = 0;
+    if (!context.headless)
+    {
+        signal_semaphores[signal_count] = frame->queue_complete_semaphore;
+        signal_values[signal_count++] = 0; // Ignored for binary semaphores
+    }
+    // The depth pyramid built by this frame, for the culling of the next one on the async compute queue
+    VkSemaphore pyramid_semaphore;
+    if (vulkan_depth_pyramid_take_signal(&context.depth_pyramid, &pyramid_semaphore))
+    {
+        signal_semaphores[signal_count] = pyramid_semaphore;
+        signal_values[signal_count++] = 0; // Ignored for binary semaphores
+    }
 
+    // Wait semaphore ensures that the operation cannot begin until the image is available.
     // Each semaphore waits on the corresponding pipeline stage to complete. 1:1 ratio.
     // VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT prevents subsequent colour attachment
     // writes from executing until the semaphore signals (i.e. makes sure we present one frame is presented at a time)
-    VkPipelineStageFlags wait_flags[1] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    VkSemaphore wait_semaphores[3];
+    uint64_t wait_values[3];
+    VkPipelineStageFlags wait_flags[3];
+    u32 wait_count = 0;
+    if (!context.headless)
+    {
+        wait_semaphores[wait_count] = frame->image_available_semaphore;
+        wait_values[wait_count] = 0; // Ignored for binary semaphores
+        wait_flags[wait_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    // Uploads acquired by this frame from the transfer queue
+    VkSemaphore upload_semaphore;
+    u64 upload_value;
+    VkPipelineStageFlags upload_stages;
+    b8 waits_on_uploads = vulkan_uploader_take_graphics_wait(&context.uploader, &upload_semaphore, &upload_value, &upload_stages);
+    if (waits_on_uploads)
+    {
+        wait_semaphores[wait_count] = upload_semaphore;
+        wait_values[wait_count] = upload_value;
+        wait_flags[wait_count++] = upload_stages;
+    }
+    // Dispatches of this frame on the async compute queue
+    VkSemaphore compute_semaphore;
+    VkPipelineStageFlags compute_stages;
+    if (vulkan_compute_take_graphics_wait(&context.compute, &compute_semaphore, &compute_stages))
+    {
+        wait_semaphores[wait_count] = compute_semaphore;
+        wait_values[wait_count] = 0; // Ignored for binary semaphores
+        wait_flags[wait_count++] = compute_stages;
+    }
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
     submit_info.pWaitDstStageMask = wait_flags;
 
+    // With a timeline the frame signals the next value (= frame count) instead of a fence
+    VkFence submit_fence = frame->in_flight_fence.handle;
+    if (context.use_timeline)
+    {
+        signal_semaphores[signal_count] = context.graphics_timeline.handle;
+        signal_values[signal_count++] = vulkan_timeline_next_value(&context.graphics_timeline);
+        submit_fence = VK_NULL_HANDLE;
+    }
+    submit_info.signalSemaphoreCount = signal_count;
+    submit_info.pSignalSemaphores = signal_semaphores;
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info = {};
+    if (context.use_timeline || waits_on_uploads)
+    {
+        timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_submit_info.waitSemaphoreValueCount = wait_count;
+        timeline_submit_info.pWaitSemaphoreValues = wait_values;
+        timeline_submit_info.signalSemaphoreValueCount = signal_count;
+        timeline_submit_info.pSignalSemaphoreValues = signal_values;
+        submit_info.pNext = &timeline_submit_info;
+    }
+
     // Submit the queue
     VkResult result = vkQueueSubmit(
         context.device.graphicsQueue,
         1,
         &submit_info,
-        context.in_flight_fences[context.current_frame].handle);
+        submit_fence);
 
     if (result != VK_SUCCESS)
     {
@@ -1888,19 +2775,30 @@ b8 end_frame(GLFWwindow *window, f32 delta_time)
     }
 
     command_buffer->state = COMMAND_BUFFER_STATE_SUBMITTED;
+    context.frame_stats.frame_number = context.frame_number;
+    ++context.frame_number;
+    frame->submitted_frame_count = context.frame_number;
     // end of queue submission
 
+    if (context.headless)
+    {
+        // Nothing to present, the frame ends with the submission.
+        context.current_frame = (context.current_frame + 1) % context.frames_in_flight;
+        return BC_TRUE;
+    }
+
     // Return the image to the swapchain for presentation.
     VkPresentInfoKHR present_info = {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &context.queue_complete_semaphores[context.current_frame];
+    present_info.pWaitSemaphores = &frame->queue_complete_semaphore;
     present_info.swapchainCount = 1;
     present_info.pSwapchains = &context.swap_chain.handle;
     present_info.pImageIndices = &context.image_index;
     present_info.pResults = 0;
 
     result = vkQueuePresentKHR(context.device.presentQueue, &present_info);
+    context.swap_chain.present_times[context.image_index] = platform_get_absolute_time();
     // TODO: Handle other non-error cases
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
     {
@@ -1915,16 +2813,16 @@ b8 end_frame(GLFWwindow *window, f32 delta_time)
     // Increment (and loop) the index.
     /*
     By using the modulo (%) operator,
-    we ensure that the frame index loops around after every MAX_FRAMES_IN_FLIGHT enqueued frames.
+    we ensure that the frame index loops around after every frames_in_flight enqueued frames.
     */
-    context.current_frame = (context.current_frame + 1) % context.swap_chain.max_frames_in_flight;
+    context.current_frame = (context.current_frame + 1) % context.frames_in_flight;
     return BC_TRUE;
 }
 
 //--------------
 // Draw
 //--------------
-void draw_frame(f32 delta_time, GLFWwindow *window)
+b8 draw_frame(f32 delta_time, GLFWwindow *window)
 {
     if (begin_frame(delta_time, window))
     {
@@ -1934,7 +2832,9 @@ void draw_frame(f32 delta_time, GLFWwindow *window)
         {
             ERR_EXIT("end_frame failed.\n", "draw_frame()\n.");
         }
+        return BC_TRUE;
     }
+    return BC_FALSE;
 }
 
 //--------------
@@ -1970,6 +2870,8 @@ void destroy_device(vulkan_device *the_device)
     memset(&the_device->swapchain_support.surfaceCapabilities, 0, sizeof(the_device->swapchain_support.surfaceCapabilities));
     the_device->graphics_queue_index = -1;
     the_device->present_queue_index = -1;
+    the_device->transfer_queue_index = -1;
+    the_device->compute_queue_index = -1;
 }
 
 void destroy_swapchain(vulkan_context *context, b8 is_to_recreate)
@@ -1978,17 +2880,32 @@ void destroy_swapchain(vulkan_context *context, b8 is_to_recreate)
         vkDeviceWaitIdle(context->device.logical_device);
 
     // Destroy the depth attachment (image)
-    // vulkan_image_destroy(context, &swapchain->depth_attachment);
+    vulkan_image_destroy(context, &context->swap_chain.depth_attachment);
+    vulkan_image_destroy(context, &context->swap_chain.colour_attachment);
+    vulkan_image_destroy(context, &context->swap_chain.depth_resolve);
 
     for (uint32_t i = 0; i < context->swap_chain.image_count; ++i)
         vkDestroyImageView(context->device.logical_device, context->swap_chain.views[i], context->allocator);
 
+    if (context->headless)
+    {
+        // Headless images are ours to destroy
+        for (uint32_t i = 0; i < context->swap_chain.image_count; ++i)
+        {
+            vkDestroyImage(context->device.logical_device, context->swap_chain.images[i], context->allocator);
+            vulkan_memory_free(context, &context->memory, &context->swap_chain.image_allocations[i]);
+        }
+        return;
+    }
+
     vkDestroySwapchainKHR(context->device.logical_device, context->swap_chain.handle, context->allocator);
+    free(context->swap_chain.present_times);
+    context->swap_chain.present_times = NULL;
 }
 
+// The pipelines are destroyed along with the pipeline compiler
 void destroy_graphics_pipeline()
 {
-    vkDestroyPipeline(context.device.logical_device, graphicsPipeline, context.allocator);
     vkDestroyPipelineLayout(context.device.logical_device, pipelineLayout, context.allocator);
 }
 
@@ -2016,6 +2933,8 @@ void vulkan_frame_buffer_destroy(vulkan_context *context, vulkan_framebuffer *fr
 
 void destroy_framebuffers()
 {
+    if (context.use_dynamic_rendering)
+        return;
     for (uint32_t i = 0; i < context.swap_chain.image_count; ++i)
     {
         vulkan_framebuffer fb = context.swap_chain.framebuffers[i];
@@ -2025,6 +2944,13 @@ void destroy_framebuffers()
 // Since this is a device related stuff, this can be handled in destroy_device
 void destroy_command_pools()
 {
+    for (u32 i = 0; i < context.frames_in_flight; ++i)
+    {
+        for (u32 t = 0; t < context.recording_thread_count; ++t)
+            vulkan_transient_command_pool_destroy(&context, &context.frames[i].command_pools[t]);
+        context.frames[i].command_buffer.handle = 0;
+        context.frames[i].command_buffer.state = COMMAND_BUFFER_STATE_NOT_ALLOCATED;
+    }
     vkDestroyCommandPool(context.device.logical_device, context.device.graphics_command_pool, context.allocator);
     // Destroy for other command pools when necessary
     /*
@@ -2042,28 +2968,6 @@ void vulkan_command_buffer_free(vulkan_context *context, VkCommandPool *pool, vu
     command_buffer->state = COMMAND_BUFFER_STATE_NOT_ALLOCATED;
 }
 
-// You don't need to destroy vkCommandBuffer
-// but we have to remove our handles
-void destroy_command_buffers(b8 release_memory_resources)
-{
-    for (u32 i = 0; i < context.swap_chain.image_count; ++i)
-    {
-        if (context.graphics_command_buffers[i].handle)
-        {
-            vulkan_command_buffer_free(
-                &context,
-                &context.device.graphics_command_pool,
-                &context.graphics_command_buffers[i]);
-            context.graphics_command_buffers[i].handle = 0;
-        }
-    }
-
-    if (release_memory_resources)
-    {
-        free(context.graphics_command_buffers);
-        context.graphics_command_buffers = 0;
-    }
-}
 
 void vulkan_fence_destroy(vulkan_context *context, vulkan_fence *fence)
 {
@@ -2080,61 +2984,245 @@ void vulkan_fence_destroy(vulkan_context *context, vulkan_fence *fence)
 
 void destroy_sync_objects()
 {
-    for (u8 i = 0; i < context.swap_chain.max_frames_in_flight; ++i)
+    for (u32 i = 0; i < context.frames_in_flight; ++i)
     {
-        if (context.image_available_semaphores[i])
+        vulkan_frame *frame = &context.frames[i];
+        if (frame->image_available_semaphore)
         {
             vkDestroySemaphore(
                 context.device.logical_device,
-                context.image_available_semaphores[i],
+                frame->image_available_semaphore,
                 context.allocator);
-            context.image_available_semaphores[i] = 0;
+            frame->image_available_semaphore = 0;
         }
-        if (context.queue_complete_semaphores[i])
+        if (frame->queue_complete_semaphore)
         {
             vkDestroySemaphore(
                 context.device.logical_device,
-                context.queue_complete_semaphores[i],
+                frame->queue_complete_semaphore,
                 context.allocator);
-            context.queue_complete_semaphores[i] = 0;
+            frame->queue_complete_semaphore = 0;
         }
-        vulkan_fence_destroy(&context, &context.in_flight_fences[i]);
+        vulkan_fence_destroy(&context, &frame->in_flight_fence);
     }
-    free(context.image_available_semaphores);
-    context.image_available_semaphores = 0;
-
-    free(context.queue_complete_semaphores);
-    context.queue_complete_semaphores = 0;
-
-    free(context.in_flight_fences);
-    context.in_flight_fences = 0;
+    vulkan_timeline_destroy(&context, &context.graphics_timeline);
 
     free(context.images_in_flight);
     context.images_in_flight = 0;
 }
+//--------------
+// Geometry
+//--------------
+// Mesh 0, the triangle which used to be hard coded in the vertex shader
+void create_default_mesh()
+{
+    const renderer_vertex vertices[3] = {
+        {{0.0f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+        {{0.5f, 0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+        {{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+    };
+    const u32 indices[3] = {0, 1, 2};
+
+    if (vulkan_geometry_add_mesh(&context, &context.geometry, &context.uploader, vertices, 3, indices, 3) == -1)
+        ERR_EXIT("Failed to create the default mesh.\n", "create_default_mesh");
+}
+
+// A checker texture in the global set, for the materials without one. Uploaded like any texture, so through the
+// transfer queue and handed over to the graphics family when the device has one.
+void create_default_texture()
+{
+    const u32 size = 8;
+    u32 texels[size * size];
+    for (u32 y = 0; y < size; ++y)
+    {
+        for (u32 x = 0; x < size; ++x)
+            texels[y * size + x] = ((x ^ y) & 1) ? 0xFFFFFFFFu : 0xFFC0C0C0u;
+    }
+
+    VkExtent3D extent = {size, size, 1};
+    if (!vulkan_image_create(
+            &context, size, size, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &context.default_texture) ||
+        !vulkan_uploader_upload_image(
+            &context, &context.uploader, context.default_texture.handle, extent, texels, sizeof(texels),
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT))
+        ERR_EXIT("Failed to create the default texture.\n", "create_default_texture");
+
+    context.default_texture_index = vulkan_bindless_add_image(
+        &context, &context.bindless, context.default_texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (context.default_texture_index == VULKAN_BINDLESS_INVALID_INDEX)
+        ERR_EXIT("Failed to add the default texture to the global set!\n", "create_default_texture");
+}
+
 //--------------
 // Public
 //--------------
+renderer_config renderer_default_config(u32 width, u32 height)
+{
+    renderer_config config = {};
+    config.headless = BC_FALSE;
+    config.width = width;
+    config.height = height;
+    config.frames_in_flight = 2;
+    config.recording_threads = 0;
+    config.pipeline_compile_threads = 2;
+    config.shader_hot_reload = BC_FALSE;
+#ifdef BC_SHADER_SOURCE_DIR
+    config.shader_source_dir = BC_SHADER_SOURCE_DIR;
+#else
+    config.shader_source_dir = NULL;
+#endif
+    config.draw_count = 1;
+    config.vertex_capacity = 1 << 20;
+    config.index_capacity = 1 << 22;
+    config.staging_buffer_size = 16 << 20;
+    config.use_timeline_semaphores = BC_TRUE;
+    config.pipeline_cache_path = "pipeline_cache.bin";
+    config.track_host_allocations = BC_TRUE;
+    config.use_transfer_queue = BC_TRUE;
+    config.use_async_compute = BC_TRUE;
+    config.use_dynamic_rendering = BC_TRUE;
+    config.depth_prepass = BC_FALSE;
+    config.msaa_samples = 4;
+    config.present_policy = RENDERER_PRESENT_POLICY_LOW_LATENCY;
+    config.draw_command_capacity = 4096;
+    config.gpu_culling = BC_TRUE;
+    config.instance_capacity = 1 << 17;
+    config.uniform_buffer_size = 256 << 10;
+    return config;
+}
+
 int init_renderer(GLFWwindow *window, u32 width, u32 height)
 {
+    renderer_config config = renderer_default_config(width, height);
+    return init_renderer_with_config(window, &config);
+}
+
+int init_renderer_with_config(GLFWwindow *window, const renderer_config *config)
+{
+    if (!config->headless && !window)
+        ERR_EXIT("A window is required unless the renderer runs headless.\n", "init_renderer_with_config");
+
     if (init_volk() == EXIT_FAILURE)
         return EXIT_FAILURE;
 
-    cached_framebuffer_width = width;
-    cached_framebuffer_height = height;
+    context.headless = config->headless;
+    // VK_KHR_swapchain is only needed to present to a surface
+    if (context.headless)
+        requested_device_ext_count = 0;
+
+    cached_framebuffer_width = config->width;
+    cached_framebuffer_height = config->height;
+
+    context.frames_in_flight = config->frames_in_flight;
+    if (context.frames_in_flight < 1)
+        context.frames_in_flight = 1;
+    else if (context.frames_in_flight > RENDERER_MAX_FRAMES_IN_FLIGHT)
+        context.frames_in_flight = RENDERER_MAX_FRAMES_IN_FLIGHT;
+    context.current_frame = 0;
+    context.draw_count = config->draw_count;
+    // Downgraded to a render pass by create_logical_device if not supported
+    context.use_dynamic_rendering = config->use_dynamic_rendering;
+    context.depth_prepass = config->depth_prepass;
+    context.present_policy = config->present_policy;
+    context.present_policy_changed = BC_FALSE;
+    context.custom_instances = BC_FALSE;
+    context.default_instance_count = 0;
+    context.default_instance_mesh_count = 0;
+    // Identity until renderer_set_view_projection, but for the depth which is reversed (z' = 1 - z)
+    memset(context.view_projection, 0, sizeof(context.view_projection));
+    for (u32 i = 0; i < 4; ++i)
+        context.view_projection[i * 4 + i] = 1.0f;
+    context.view_projection[2 * 4 + 2] = -1.0f;
+    context.view_projection[3 * 4 + 2] = 1.0f;
+    // Downgraded to fences by create_logical_device if not supported
+    context.use_timeline = config->use_timeline_semaphores;
+
+    // The main thread records too, so one pool more than workers
+    u32 worker_count = config->recording_threads;
+    if (worker_count > VULKAN_MAX_RECORDING_THREADS - 1)
+        worker_count = VULKAN_MAX_RECORDING_THREADS - 1;
+    context.recording_thread_count = worker_count + 1;
+    if (!job_system_create(worker_count))
+        return EXIT_FAILURE;
+
+    // Has to outlive every Vulkan object, from the instance on
+    if (config->track_host_allocations)
+    {
+        vulkan_host_allocator_create();
+        context.allocator = vulkan_host_allocator_callbacks();
+    }
 
     create_instance(); // context.frame_buffer size stuff is set here
     setup_debug_messenger();
-    create_surface(window);
+    if (!context.headless)
+        create_surface(window);
     get_physical_device();
+    detect_depth_format();
+    context.msaa_samples = choose_msaa_samples(config->msaa_samples);
+    choose_occlusion_culling(config->gpu_culling);
     create_logical_device();
+    vulkan_memory_allocator_create(&context, &context.memory);
     create_swap_chain(window, context.framebuffer_width, context.framebuffer_height);
+    create_attachments();
     create_render_pass();
+    context.pipeline_cache_path = config->pipeline_cache_path;
+    vulkan_pipeline_cache_create(&context, context.pipeline_cache_path, &context.pipeline_cache);
+    if (!vulkan_pipeline_compiler_create(&context, config->pipeline_compile_threads))
+        return EXIT_FAILURE;
+    if (!vulkan_bindless_create(&context, context.frames_in_flight, &context.bindless) ||
+        !vulkan_uniform_ring_create(&context, context.frames_in_flight, config->uniform_buffer_size, &context.uniform_ring))
+        return EXIT_FAILURE;
     create_graphics_pipeline();
+    context.shader_hot_reload = BC_FALSE;
+    if (config->shader_hot_reload)
+    {
+        if (config->shader_source_dir && shader_watcher_create(config->shader_source_dir, "assets/shaders"))
+            context.shader_hot_reload = BC_TRUE;
+        else
+            printf("WARNING: Shader hot reload is disabled.\n");
+    }
     create_frame_buffers();
     create_command_pool();
-    create_command_buffers();
     create_sync_objects();
+    if (!vulkan_uploader_create(&context, config->staging_buffer_size, config->use_transfer_queue, &context.uploader) ||
+        !vulkan_geometry_create(&context, config->vertex_capacity, config->index_capacity, &context.geometry) ||
+        !vulkan_compute_create(&context, context.frames_in_flight, config->use_async_compute, &context.compute) ||
+        !vulkan_indirect_create(
+            &context, &context.compute, context.frames_in_flight, config->draw_command_capacity, MAX_DRAW_BATCHES,
+            config->gpu_culling, &context.draws))
+        return EXIT_FAILURE;
+    // The modules are only needed while the pipelines are created
+    VkShaderModule cull_shader = context.draws.gpu_culled ? create_shader_module(CULL_INSTANCES_SHADER_PATH) : VK_NULL_HANDLE;
+    VkShaderModule compact_shader = context.draws.gpu_culled ? create_shader_module(COMPACT_DRAWS_SHADER_PATH) : VK_NULL_HANDLE;
+    b8 culling_created = vulkan_culling_create(
+        &context, &context.compute, &context.draws, context.frames_in_flight, config->instance_capacity,
+        cull_shader, compact_shader, &context.culling);
+    if (cull_shader)
+        vkDestroyShaderModule(context.device.logical_device, cull_shader, context.allocator);
+    if (compact_shader)
+        vkDestroyShaderModule(context.device.logical_device, compact_shader, context.allocator);
+    if (!culling_created)
+        return EXIT_FAILURE;
+    if (context.occlusion_culling)
+    {
+        VkShaderModule pyramid_shader = create_shader_module(DEPTH_PYRAMID_SHADER_PATH);
+        b8 pyramid_created = vulkan_depth_pyramid_create(&context, &context.compute, context.frames_in_flight, pyramid_shader, &context.depth_pyramid) &&
+                             vulkan_depth_pyramid_resize(&context, &context.depth_pyramid, pyramid_depth(), context.frame_number);
+        vkDestroyShaderModule(context.device.logical_device, pyramid_shader, context.allocator);
+        if (!pyramid_created)
+            return EXIT_FAILURE;
+    }
+    add_instance_buffers();
+    create_default_mesh();
+    create_default_texture();
+    vulkan_gpu_timer_create(&context, context.frames_in_flight, &context.gpu_timer);
+    if (context.recording_thread_count > 1 && !context.device.features.inheritedQueries && context.gpu_timer.statistics_enabled)
+    {
+        // Queries can't be active while executing secondary command buffers without it
+        printf("WARNING: inheritedQueries is not supported, pipeline statistics are disabled while recording in parallel.\n");
+        context.gpu_timer.statistics_enabled = BC_FALSE;
+    }
 
     return EXIT_SUCCESS;
 }
@@ -2143,20 +3231,141 @@ void cleanup_renderer()
 {
     vkDeviceWaitIdle(context.device.logical_device);
     // destroy in reverse order of creation
+    job_system_destroy();
+    vulkan_gpu_timer_destroy(&context, &context.gpu_timer);
+    vulkan_depth_pyramid_destroy(&context, &context.depth_pyramid);
+    vulkan_culling_destroy(&context, &context.culling);
+    vulkan_indirect_destroy(&context, &context.draws);
+    vulkan_compute_destroy(&context, &context.compute);
+    vulkan_image_destroy(&context, &context.default_texture);
+    vulkan_geometry_destroy(&context, &context.geometry);
+    vulkan_uploader_destroy(&context, &context.uploader);
     destroy_sync_objects();
-    destroy_command_buffers(VK_TRUE);
     destroy_command_pools();
     destroy_framebuffers();
+    shader_watcher_destroy();
+    // Before saving the pipeline cache, so it has every compiled pipeline
+    vulkan_pipeline_compiler_destroy();
     destroy_graphics_pipeline();
+    vulkan_uniform_ring_destroy(&context, &context.uniform_ring);
+    vulkan_bindless_destroy(&context, &context.bindless);
+    if (context.pipeline_cache_path)
+        vulkan_pipeline_cache_save(&context, context.pipeline_cache, context.pipeline_cache_path);
+    vulkan_pipeline_cache_destroy(&context, &context.pipeline_cache);
     destroy_renderpass();
     destroy_swapchain(&context, 0);
+    vulkan_deletion_queue_destroy(&context, &context.deletion_queue);
+    vulkan_memory_allocator_destroy(&context, &context.memory);
     destroy_device(&context.device);
-    vkDestroySurfaceKHR(context.instance, context.surface, context.allocator);
+    if (!context.headless)
+        vkDestroySurfaceKHR(context.instance, context.surface, context.allocator);
 
     if (enable_validation_layers)
         DestroyDebugUtilsMessengerEXT(context.instance, debugMessenger, context.allocator);
 
     vkDestroyInstance(context.instance, context.allocator);
+    context.allocator = NULL;
+    vulkan_host_allocator_destroy();
+}
+
+i32 renderer_create_mesh(const renderer_vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+    return vulkan_geometry_add_mesh(&context, &context.geometry, &context.uploader, vertices, vertex_count, indices, index_count);
+}
+
+b8 renderer_set_instances(const renderer_instance *instances, u32 instance_count)
+{
+    context.custom_instances = BC_TRUE;
+    return vulkan_culling_set_instances(&context.culling, &context.geometry, instances, instance_count);
+}
+
+void renderer_set_view_projection(const f32 view_projection[16])
+{
+    memcpy(context.view_projection, view_projection, sizeof(context.view_projection));
+}
+
+void renderer_wait_for_pipelines()
+{
+    vulkan_pipeline_compiler_wait_all();
+    check_pipelines();
+}
+
+void renderer_set_present_policy(renderer_present_policy policy)
+{
+    if (policy == context.present_policy)
+        return;
+    context.present_policy = policy;
+    context.present_policy_changed = BC_TRUE;
+}
+
+void renderer_perspective_reverse_z(f32 fov_y, f32 aspect, f32 near_plane, f32 out_projection[16])
+{
+    f32 f = 1.0f / tanf(fov_y * 0.5f);
+    memset(out_projection, 0, sizeof(f32) * 16);
+    out_projection[0] = f / aspect;
+    out_projection[5] = -f;
+    // z' = near, w' = -z, so the depth near / -z is 1 at the near plane
+    out_projection[2 * 4 + 3] = -1.0f;
+    out_projection[3 * 4 + 2] = near_plane;
+}
+
+b8 renderer_get_host_memory_stats(renderer_host_memory_stats *out_stats)
+{
+    return vulkan_host_allocator_get_stats(out_stats);
+}
+
+void renderer_get_frame_stats(renderer_frame_stats *out_stats)
+{
+    *out_stats = context.frame_stats;
+}
+
+u32 renderer_gpu_timings_count()
+{
+    return context.gpu_timer.history_count;
+}
+
+b8 renderer_get_gpu_timings(u32 frames_ago, renderer_gpu_frame_timings *out_timings)
+{
+    const renderer_gpu_frame_timings *timings = vulkan_gpu_timer_get(&context.gpu_timer, frames_ago);
+    if (!timings)
+        return BC_FALSE;
+
+    *out_timings = *timings;
+    return BC_TRUE;
+}
+
+b8 renderer_dump_gpu_timings_csv(const char *path)
+{
+    file_handle handle;
+    if (!filesystem_open(path, FILE_MODE_WRITE, BC_FALSE, &handle))
+    {
+        printf("Unable to open %s to write GPU timings.\n", path);
+        return BC_FALSE;
+    }
+
+    b8 result = filesystem_write_line(&handle,
+                                      "frame,frame_ms,pre_render_pass_ms,render_pass_ms,timed_draws,draw_ms_total,"
+                                      "ia_vertices,ia_primitives,vs_invocations,clipping_invocations,clipping_primitives,fs_invocations");
+
+    char line[512];
+    // Oldest first
+    for (i32 i = (i32)renderer_gpu_timings_count() - 1; i >= 0 && result; --i)
+    {
+        const renderer_gpu_frame_timings *t = vulkan_gpu_timer_get(&context.gpu_timer, (u32)i);
+        f64 draw_ms_total = 0;
+        for (u32 j = 0; j < t->timed_draw_count; ++j)
+            draw_ms_total += t->draw_ms[j];
+
+        snprintf(line, sizeof(line), "%llu,%.6f,%.6f,%.6f,%u,%.6f,%llu,%llu,%llu,%llu,%llu,%llu",
+                 (unsigned long long)t->frame_number, t->frame_ms, t->pre_render_pass_ms, t->render_pass_ms, t->timed_draw_count, draw_ms_total,
+                 (unsigned long long)t->input_assembly_vertices, (unsigned long long)t->input_assembly_primitives,
+                 (unsigned long long)t->vertex_shader_invocations, (unsigned long long)t->clipping_invocations,
+                 (unsigned long long)t->clipping_primitives, (unsigned long long)t->fragment_shader_invocations);
+        result = filesystem_write_line(&handle, line);
+    }
+
+    filesystem_close(&handle);
+    return result;
 }
 
 //--------------
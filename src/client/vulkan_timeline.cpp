@@ -0,0 +1,83 @@
+#include "vulkan_timeline.h"
+#include "platform.h"
+#include "log_assert.h"
+
+#include <stdio.h>
+
+void vulkan_timeline_create(vulkan_context *context, vulkan_timeline *out_timeline)
+{
+    VkSemaphoreTypeCreateInfo type_create_info = {};
+    type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_create_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_create_info = {};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext = &type_create_info;
+
+    VkResult result = vkCreateSemaphore(context->device.logical_device, &semaphore_create_info, context->allocator, &out_timeline->handle);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to create timeline semaphore.\n", "vulkan_timeline_create::vkCreateSemaphore");
+
+    out_timeline->last_value = 0;
+    out_timeline->completed_value = 0;
+}
+
+void vulkan_timeline_destroy(vulkan_context *context, vulkan_timeline *timeline)
+{
+    if (timeline->handle)
+    {
+        vkDestroySemaphore(context->device.logical_device, timeline->handle, context->allocator);
+        timeline->handle = 0;
+    }
+}
+
+u64 vulkan_timeline_next_value(vulkan_timeline *timeline)
+{
+    return ++timeline->last_value;
+}
+
+u64 vulkan_timeline_poll(vulkan_context *context, vulkan_timeline *timeline)
+{
+    uint64_t value = 0;
+    VkResult result = vkGetSemaphoreCounterValue(context->device.logical_device, timeline->handle, &value);
+    if (result != VK_SUCCESS)
+        ERR_EXIT("Failed to read timeline semaphore value.\n", "vulkan_timeline_poll::vkGetSemaphoreCounterValue");
+
+    if (value > timeline->completed_value)
+        timeline->completed_value = value;
+    return timeline->completed_value;
+}
+
+b8 vulkan_timeline_wait(vulkan_context *context, vulkan_timeline *timeline, u64 value, u64 timeout_ns)
+{
+    if (timeline->completed_value >= value)
+        return BC_TRUE;
+
+    uint64_t wait_value = value;
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &timeline->handle;
+    wait_info.pValues = &wait_value;
+
+    f64 wait_start = platform_get_absolute_time();
+    VkResult result = vkWaitSemaphores(context->device.logical_device, &wait_info, timeout_ns);
+    context->frame_stats.fence_wait_ms += (platform_get_absolute_time() - wait_start) * 1000.0;
+
+    switch (result)
+    {
+    case VK_SUCCESS:
+        timeline->completed_value = value;
+        return BC_TRUE;
+    case VK_TIMEOUT:
+        break;
+    case VK_ERROR_DEVICE_LOST:
+        printf("ERROR: vulkan_timeline_wait - VK_ERROR_DEVICE_LOST.\n");
+        break;
+    default:
+        printf("ERROR: vulkan_timeline_wait - An unknown error has occurred.\n");
+        break;
+    }
+    return BC_FALSE;
+}
@@ -0,0 +1,40 @@
+#ifndef VULKAN_NOTES_1703940886_VULKAN_TIMELINE_H
+#define VULKAN_NOTES_1703940886_VULKAN_TIMELINE_H
+
+#include "vulkan_types.h"
+
+/*
+A timeline semaphore (Vulkan 1.2) of a queue. Every submission to the queue signals the next value,
+so "the GPU has finished submission N" is simply completed_value >= N. Unlike fences, it never needs
+to be reset and can be checked without blocking.
+*/
+
+/**
+ * Creates a timeline semaphore with an initial value of 0.
+ * @param context A pointer to the vulkan context. The logical device should be created with the timelineSemaphore feature.
+ * @param out_timeline A pointer to the timeline to be created.
+ */
+void vulkan_timeline_create(vulkan_context *context, vulkan_timeline *out_timeline);
+
+void vulkan_timeline_destroy(vulkan_context *context, vulkan_timeline *timeline);
+
+/**
+ * Reserves the value to be signaled by the next submission to the queue.
+ * @returns The value to be put in VkTimelineSemaphoreSubmitInfo::pSignalSemaphoreValues.
+ */
+u64 vulkan_timeline_next_value(vulkan_timeline *timeline);
+
+/**
+ * Reads the current value of the semaphore without blocking.
+ * @returns The last value known to be completed.
+ */
+u64 vulkan_timeline_poll(vulkan_context *context, vulkan_timeline *timeline);
+
+/**
+ * Blocks until the semaphore reaches value. Returns immediately if it is already known to be completed.
+ * @param timeout_ns Timeout in nanoseconds.
+ * @returns True if the value has been reached; otherwise false.
+ */
+b8 vulkan_timeline_wait(vulkan_context *context, vulkan_timeline *timeline, u64 value, u64 timeout_ns);
+
+#endif
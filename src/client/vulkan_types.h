@@ -12,10 +12,11 @@
 #error "Platform not supported by this example."
 #endif
 
-#define VOLK_IMPLEMENTATION
+// NOTE: VOLK_IMPLEMENTATION is defined by vulkan_renderer.cpp only, this header is shared by the vulkan_* modules.
 #include "volk.h"
 
 #include "defines.h"
+#include "renderer_types.h"
 
 typedef struct vulkan_renderpass
 {
@@ -40,6 +41,121 @@ typedef struct vulkan_framebuffer
     vulkan_renderpass *renderpass;
 } vulkan_framebuffer;
 
+// Second level subdivisions of each power of two size class of the TLSF blocks (log2)
+#define VULKAN_MEMORY_SL_BITS 4
+#define VULKAN_MEMORY_SL_COUNT (1 << VULKAN_MEMORY_SL_BITS)
+// Allocation sizes and offsets within a block are multiples of this (log2)
+#define VULKAN_MEMORY_ALIGN_SHIFT 4
+// Sizes below 1 << VULKAN_MEMORY_FL_SHIFT share the first first level class
+#define VULKAN_MEMORY_FL_SHIFT (VULKAN_MEMORY_SL_BITS + VULKAN_MEMORY_ALIGN_SHIFT)
+#define VULKAN_MEMORY_FL_COUNT (64 - VULKAN_MEMORY_FL_SHIFT + 1)
+
+// A range of a block, either free or allocated
+typedef struct vulkan_memory_node
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    // Physical neighbours in the block, VULKAN_MEMORY_NIL if none
+    u32 prev_physical, next_physical;
+    // Links of the free list of its size class, only used while free
+    u32 prev_free, next_free;
+    b8 free;
+} vulkan_memory_node;
+
+#define VULKAN_MEMORY_NIL 0xFFFFFFFFu
+
+// A VkDeviceMemory sub-allocated with a two level segregated fit (TLSF) allocator
+typedef struct vulkan_memory_block
+{
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    // Base pointer of the block if it is host visible
+    void *mapped;
+    VkDeviceSize used;
+
+    vulkan_memory_node *nodes;
+    u32 node_count, node_capacity;
+    // Unused entries of nodes, linked through next_free
+    u32 first_unused_node;
+
+    // Bit i is set if first level class i has a free node
+    u64 fl_bitmap;
+    // Bit j of sl_bitmap[i] is set if free_heads[i][j] is not empty
+    u32 sl_bitmap[VULKAN_MEMORY_FL_COUNT];
+    u32 free_heads[VULKAN_MEMORY_FL_COUNT][VULKAN_MEMORY_SL_COUNT];
+} vulkan_memory_block;
+
+// Blocks of a single memory type. Linear resources (buffers) and optimal tiling images never share
+// a pool, so bufferImageGranularity does not need to be respected between neighbouring allocations.
+typedef struct vulkan_memory_pool
+{
+    u32 memory_type_index;
+    b8 optimal_tiling;
+    VkDeviceSize block_size;
+    vulkan_memory_block *blocks;
+    u32 block_count, block_capacity;
+} vulkan_memory_pool;
+
+typedef struct vulkan_memory_allocator
+{
+    // Two per memory type, index memory_type_index * 2 + optimal_tiling
+    vulkan_memory_pool pools[VK_MAX_MEMORY_TYPES * 2];
+    // Live vkAllocateMemory allocations (blocks and dedicated allocations)
+    u32 device_allocation_count;
+    // Requests of at least this size get a dedicated allocation
+    VkDeviceSize dedicated_threshold;
+} vulkan_memory_allocator;
+
+typedef struct vulkan_allocation
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    // Points at offset if the memory is host visible
+    void *mapped;
+
+    // Owned VkDeviceMemory, not sub-allocated
+    b8 dedicated;
+    // Location of the node, unused if dedicated
+    u32 pool;
+    u32 block;
+    u32 node;
+} vulkan_allocation;
+
+// Per frame bump allocator over a single allocation. Each frame in flight owns frame_size bytes which are
+// reclaimed all at once when the frame slot is reused. Meant for transient buffers only.
+typedef struct vulkan_linear_allocator
+{
+    vulkan_allocation allocation;
+    VkDeviceSize frame_size;
+    u32 frame_count;
+    u32 frame_slot;
+    // Next free byte of the current frame slot, relative to its beginning
+    VkDeviceSize head;
+} vulkan_linear_allocator;
+
+typedef struct vulkan_buffer
+{
+    VkBuffer handle;
+    vulkan_allocation allocation;
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
+    // Persistently mapped pointer to the memory, NULL unless it is host visible
+    void *mapped;
+} vulkan_buffer;
+
+// Image owned by the renderer with a view over all of it, see vulkan_image.h
+typedef struct vulkan_image
+{
+    VkImage handle;
+    VkImageView view;
+    vulkan_allocation allocation;
+    VkFormat format;
+    VkImageAspectFlags aspect;
+    u32 width;
+    u32 height;
+} vulkan_image;
+
 // vulkan_swapchain_support_info
 typedef struct SwapChainDetails
 {
@@ -59,11 +175,19 @@ typedef struct vulkan_swapchain
     uint32_t image_count;
     VkImage *images;
     VkImageView *views;
-
-    // vulkan_image depth_attachment;
+    // Backing memory of the images. Only used by the headless swapchain
+    // as the WSI swapchain owns its images.
+    vulkan_allocation *image_allocations;
+
+    // Depth buffer shared by the images, the frames render one after the other on the graphics queue
+    vulkan_image depth_attachment;
+    // Single sample depth the multisampled one is resolved into, only with MSAA and occlusion culling
+    vulkan_image depth_resolve;
+    // Multisampled colour target resolved into the images, only with MSAA. Shared the same way.
+    vulkan_image colour_attachment;
     vulkan_framebuffer *framebuffers;
-
-    u8 max_frames_in_flight; //
+    // platform_get_absolute_time of the last present of each image, 0 if not presented yet
+    f64 *present_times;
 } vulkan_swapchain;
 
 typedef enum vulkan_command_buffer_state
@@ -107,6 +231,507 @@ typedef struct vulkan_fence
     b8 is_signaled;
 } vulkan_fence;
 
+typedef enum vulkan_deletion_type
+{
+    VULKAN_DELETION_IMAGE,
+    VULKAN_DELETION_IMAGE_VIEW,
+    VULKAN_DELETION_FRAMEBUFFER,
+    VULKAN_DELETION_DEVICE_MEMORY,
+    VULKAN_DELETION_SWAPCHAIN,
+    VULKAN_DELETION_PIPELINE,
+    // Memory of the vulkan_memory_allocator, handle is unused
+    VULKAN_DELETION_ALLOCATION
+} vulkan_deletion_type;
+
+typedef struct vulkan_deferred_deletion
+{
+    vulkan_deletion_type type;
+    u64 handle;
+    vulkan_allocation allocation;
+    u64 retire_value;
+} vulkan_deferred_deletion;
+
+// FIFO of resources waiting for the GPU to be done with them
+typedef struct vulkan_deletion_queue
+{
+    vulkan_deferred_deletion *entries;
+    u32 count;
+    u32 capacity;
+} vulkan_deletion_queue;
+
+// Upper bound of the threads recording commands for a frame (the main thread included)
+#define VULKAN_MAX_RECORDING_THREADS 8
+
+// A VK_COMMAND_POOL_CREATE_TRANSIENT_BIT pool which is reset as a whole with vkResetCommandPool.
+// Command buffers are handed out linearly and are kept allocated across resets, so after a few frames
+// a frame allocates nothing. A pool must only be used by a single thread.
+typedef struct vulkan_transient_command_pool
+{
+    VkCommandPool handle;
+
+    // Allocated command buffers of each level (primary, secondary)
+    VkCommandBuffer *buffers[2];
+    u32 capacity[2];
+    // Number of buffers handed out since the last reset
+    u32 used[2];
+} vulkan_transient_command_pool;
+
+// Range of the shared geometry buffers used by a mesh
+typedef struct vulkan_mesh
+{
+    u32 first_index;
+    u32 index_count;
+    // Added to the indices of the mesh
+    i32 vertex_offset;
+    // Center and radius of a sphere around the vertices, in mesh space
+    f32 bounding_sphere[4];
+} vulkan_mesh;
+
+// All meshes share one device local vertex buffer and one index buffer, so draws only bind them once.
+typedef struct vulkan_geometry
+{
+    vulkan_buffer vertex_buffer;
+    vulkan_buffer index_buffer;
+    u32 vertex_count, vertex_capacity;
+    u32 index_count, index_capacity;
+
+    vulkan_mesh *meshes;
+    u32 mesh_count;
+    u32 mesh_capacity;
+} vulkan_geometry;
+
+// Draws sharing a pipeline, recorded with a single indirect call
+typedef struct vulkan_draw_batch
+{
+    VkPipeline pipeline;
+    // Range of the frame's indirect commands
+    u32 first_command;
+    u32 command_count;
+} vulkan_draw_batch;
+
+// Indirect draw buffers of a single frame in flight, host visible and persistently mapped
+typedef struct vulkan_indirect_frame
+{
+    // VkDrawIndexedIndirectCommand of every batch
+    vulkan_buffer commands;
+    // Draw count (u32) of each batch, read by vkCmdDrawIndexedIndirectCount
+    vulkan_buffer counts;
+    // Device local commands and counts written by the GPU culling from the ones above, drawn instead of them
+    vulkan_buffer culled_commands;
+    vulkan_buffer culled_counts;
+} vulkan_indirect_frame;
+
+// Draws of the frames, written as instanced indirect commands grouped by pipeline
+typedef struct vulkan_indirect_draws
+{
+    u32 frame_count;
+    vulkan_indirect_frame frames[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    u32 current_frame;
+
+    u32 command_capacity;
+    u32 command_count;
+    vulkan_draw_batch *batches;
+    u32 batch_count;
+    u32 batch_capacity;
+
+    // The commands are culled on the GPU, see vulkan_culling.h
+    b8 gpu_culled;
+    // Optional device features the calls are recorded with
+    b8 use_draw_count;      // drawIndirectCount
+    b8 multi_draw;          // multiDrawIndirect
+    b8 use_first_instance;  // drawIndirectFirstInstance, draws are recorded directly without it
+} vulkan_indirect_draws;
+
+// Timeline semaphore of a queue
+typedef struct vulkan_timeline
+{
+    VkSemaphore handle;
+    // Value signaled by the last submission
+    u64 last_value;
+    // Last value known to be reached by the GPU
+    u64 completed_value;
+} vulkan_timeline;
+
+// A copy from the staging buffer waiting to be submitted
+typedef struct vulkan_pending_copy
+{
+    VkBuffer dst;
+    VkBufferCopy region;
+} vulkan_pending_copy;
+
+typedef struct vulkan_pending_image_copy
+{
+    VkImage image;
+    VkBufferImageCopy region;
+    // Layout the image is left in and the stages/accesses which will read it
+    VkImageLayout final_layout;
+    VkPipelineStageFlags dst_stages;
+    VkAccessFlags dst_access;
+} vulkan_pending_image_copy;
+
+#define VULKAN_UPLOAD_BATCH_COUNT 3
+
+// A submission of the uploader with its share of the staging buffer
+typedef struct vulkan_upload_batch
+{
+    // Range of the staging buffer used by the batch
+    VkDeviceSize begin, end;
+    vulkan_transient_command_pool command_pool;
+    // Signaled when the submission completes
+    VkFence fence;
+    b8 in_flight;
+} vulkan_upload_batch;
+
+// Batches copies into device local resources through a reusable staging buffer
+typedef struct vulkan_uploader
+{
+    vulkan_buffer staging;
+    // Ring of batches, the staging buffer is only waited on when the ring wraps onto a batch in flight
+    vulkan_upload_batch batches[VULKAN_UPLOAD_BATCH_COUNT];
+    u32 current_batch;
+    // Next free byte of the staging buffer, within the current batch
+    VkDeviceSize head;
+
+    vulkan_pending_copy *copies;
+    u32 copy_count;
+    u32 copy_capacity;
+    // Stages and accesses which will read the queued buffer copies
+    VkPipelineStageFlags dst_stages;
+    VkAccessFlags dst_access;
+    vulkan_pending_image_copy *image_copies;
+    u32 image_copy_count;
+    u32 image_copy_capacity;
+
+    // Copies run on a transfer only queue family and are released to the graphics family.
+    // Otherwise they are submitted to the graphics queue ahead of the frames.
+    b8 use_transfer_queue;
+    VkQueue queue;
+    u32 queue_family_index;
+    // Signaled by each batch submitted to the transfer queue
+    vulkan_timeline timeline;
+
+    // Acquire halves of the ownership transfers released by the submitted batches, recorded by the next frame
+    VkBufferMemoryBarrier *buffer_acquires;
+    u32 buffer_acquire_count, buffer_acquire_capacity;
+    VkImageMemoryBarrier *image_acquires;
+    u32 image_acquire_count, image_acquire_capacity;
+    VkPipelineStageFlags acquire_stages;
+    // Timeline value the next graphics submission waits on at graphics_wait_stages, 0 if none
+    u64 graphics_wait_value;
+    VkPipelineStageFlags graphics_wait_stages;
+} vulkan_uploader;
+
+typedef struct vulkan_compute_pipeline
+{
+    VkPipeline handle;
+    VkPipelineLayout layout;
+} vulkan_compute_pipeline;
+
+// Index of a pipeline submitted to the pipeline compiler
+typedef u32 vulkan_pipeline_handle;
+
+// Graphics pipeline drawing renderer_vertex triangle lists, with dynamic viewport and scissor
+typedef struct vulkan_graphics_pipeline_desc
+{
+    // SPIR-V files, copied when submitted. No fragment shader makes a depth only pipeline.
+    const char *vertex_shader_path;
+    const char *fragment_shader_path;
+    VkPipelineLayout layout;
+    // Render pass the pipeline is used in, VK_NULL_HANDLE with dynamic rendering
+    VkRenderPass render_pass;
+    // Attachment formats, with dynamic rendering
+    VkFormat colour_format;
+    VkFormat depth_format;
+    VkSampleCountFlagBits samples;
+    VkCullModeFlags cull_mode;
+    // Alpha blending of the colour, written only if colour_write
+    b8 colour_write;
+    b8 blend;
+    b8 depth_write;
+    VkCompareOp depth_compare_op;
+    // Pipeline used while this one is not compiled yet, submitted before it. VULKAN_PIPELINE_INVALID_HANDLE if none.
+    vulkan_pipeline_handle fallback;
+} vulkan_graphics_pipeline_desc;
+
+// Compute resources of a single frame in flight, reused once the frame is done
+typedef struct vulkan_compute_frame
+{
+    vulkan_transient_command_pool command_pool;
+    // Signaled by the compute submission of the frame, waited on by its graphics submission
+    VkSemaphore complete_semaphore;
+} vulkan_compute_frame;
+
+// Dispatches of the frames, submitted to a compute only queue family (async compute) when the
+// device has one so they overlap with the rasterization of the previous frames.
+// Otherwise they are recorded into the graphics command buffer of the frame.
+typedef struct vulkan_compute
+{
+    b8 async;
+    VkQueue queue;
+    u32 queue_family_index;
+
+    u32 frame_count;
+    vulkan_compute_frame frames[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    u32 current_frame;
+
+    // Command buffer the current frame records its dispatches into, VK_NULL_HANDLE until the first one
+    VkCommandBuffer command_buffer;
+    // Semaphore the submission of the current frame waits on (async compute), VK_NULL_HANDLE if none
+    VkSemaphore wait_semaphore;
+    VkPipelineStageFlags wait_stages;
+    // Stages and accesses of the graphics work which reads what the dispatches write
+    VkPipelineStageFlags dst_stages;
+    VkAccessFlags dst_access;
+    // Stages the graphics submission of the current frame waits at, 0 if it does not wait
+    VkPipelineStageFlags graphics_wait_stages;
+} vulkan_compute;
+
+// GPU side of an instance (std430), see assets/shaders/shader_base.vert.glsl
+typedef struct vulkan_instance_data
+{
+    f32 position[3];
+    // Index of the indirect command drawing its mesh
+    u32 command;
+    // World space center and radius
+    f32 bounding_sphere[4];
+} vulkan_instance_data;
+
+// Instance buffers of a single frame in flight
+typedef struct vulkan_culling_frame
+{
+    // vulkan_instance_data of every instance, host visible
+    vulkan_buffer instances;
+    // Instance indices drawn by the indirect commands, from their firstInstance on (gl_InstanceIndex)
+    vulkan_buffer visible_instances;
+    // Visible instances (u32) of each indirect command, counted by the culling pass
+    vulkan_buffer command_counts;
+    // What the occlusion test needs of the depth pyramid, host visible (see cull_instances.comp.glsl)
+    vulkan_buffer occlusion;
+    VkDescriptorSet descriptor_set;
+    // Generation of the instances written into the buffers
+    u64 generation;
+    // Generation of the depth pyramid the descriptor set refers to, 0 if none
+    u64 pyramid_generation;
+} vulkan_culling_frame;
+
+// The instances drawn every frame and their culling on the GPU
+typedef struct vulkan_culling
+{
+    // Frustum culling and draw compaction run in compute passes. Otherwise every instance is drawn.
+    b8 enabled;
+
+    // Sorted by mesh, so the instances of an indirect command are contiguous
+    vulkan_instance_data *instances;
+    u32 instance_count;
+    u32 instance_capacity;
+    // Mesh and instance count of each indirect command
+    u32 *command_meshes;
+    u32 *command_instance_counts;
+    u32 command_count;
+    u32 command_capacity;
+    // Incremented each time the instances change
+    u64 generation;
+
+    u32 frame_count;
+    vulkan_culling_frame frames[RENDERER_MAX_FRAMES_IN_FLIGHT];
+
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    vulkan_compute_pipeline cull_pipeline;
+    vulkan_compute_pipeline compact_pipeline;
+} vulkan_culling;
+
+// log2 of the largest image dimension, plus one
+#define VULKAN_DEPTH_PYRAMID_MAX_LEVELS 16
+
+typedef struct vulkan_depth_pyramid_frame
+{
+    // One per level, from the depth (or the previous level) into the level
+    VkDescriptorSet descriptor_sets[VULKAN_DEPTH_PYRAMID_MAX_LEVELS];
+    // Generation of the pyramid the descriptor sets refer to, 0 if none
+    u64 generation;
+} vulkan_depth_pyramid_frame;
+
+// Farthest depth of the previous frame over increasingly large tiles, see vulkan_depth_pyramid.h
+typedef struct vulkan_depth_pyramid
+{
+    // R32_SFLOAT mip chain down to 1x1, level 0 is half the size of the depth (rounded up)
+    VkImage image;
+    vulkan_allocation allocation;
+    // Every level, read by the culling
+    VkImageView view;
+    // A single level each, written by the build
+    VkImageView level_views[VULKAN_DEPTH_PYRAMID_MAX_LEVELS];
+    u32 width;
+    u32 height;
+    u32 level_count;
+
+    // Single sample depth the pyramid is built from, and a view of its depth aspect
+    VkImage depth_image;
+    VkImageAspectFlags depth_aspect;
+    VkImageView depth_view;
+    u32 depth_width;
+    u32 depth_height;
+
+    // Nearest, for texelFetch
+    VkSampler sampler;
+    // Incremented each time the image is recreated
+    u64 generation;
+    // The pyramid holds the depth of a frame since it was (re)created, and the view projection it was drawn with
+    b8 built;
+    f32 view_projection[16];
+
+    // With async compute the culling waits on the build of the previous frame with this semaphore.
+    // signal: the current graphics submission signals it. wait_pending: signaled, no dispatch waited on it yet.
+    b8 async;
+    VkSemaphore built_semaphore;
+    b8 signal;
+    b8 wait_pending;
+    // Queue families sharing the image
+    u32 queue_families[2];
+
+    u32 frame_count;
+    vulkan_depth_pyramid_frame frames[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    vulkan_compute_pipeline pipeline;
+} vulkan_depth_pyramid;
+
+// Uniform data written by the CPU each frame, sub-allocated linearly from the part of the buffer of the
+// current frame in flight and bound with dynamic offsets
+typedef struct vulkan_uniform_ring
+{
+    // Bound to the whole memory of linear
+    VkBuffer buffer;
+    // A slot per frame in flight. Persistently mapped, device local too if the device has such memory.
+    vulkan_linear_allocator linear;
+    b8 device_local;
+    // minUniformBufferOffsetAlignment
+    VkDeviceSize alignment;
+    // Range of the descriptor, that is the largest block
+    VkDeviceSize range;
+
+    // A single VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+} vulkan_uniform_ring;
+
+// Arrays of the global descriptor set, also its bindings
+typedef enum vulkan_bindless_type
+{
+    VULKAN_BINDLESS_STORAGE_BUFFER,
+    VULKAN_BINDLESS_SAMPLED_IMAGE,
+    VULKAN_BINDLESS_SAMPLER,
+    VULKAN_BINDLESS_TYPE_COUNT
+} vulkan_bindless_type;
+
+// A removed descriptor, its index is reused once retire_value frames have completed
+typedef struct vulkan_bindless_release
+{
+    u32 index;
+    u64 retire_value;
+} vulkan_bindless_release;
+
+// A descriptor array of the global set
+typedef struct vulkan_bindless_array
+{
+    // buffers for storage buffers, images (with the sampler only) otherwise
+    VkDescriptorBufferInfo *buffers;
+    VkDescriptorImageInfo *images;
+    b8 *used;
+    // Indices below high_water have been handed out at least once
+    u32 high_water;
+    u32 capacity;
+    u32 *free_indices;
+    u32 free_count;
+    // FIFO, in increasing retire values
+    vulkan_bindless_release *releases;
+    u32 release_count;
+    u32 release_capacity;
+} vulkan_bindless_array;
+
+// The global descriptor set, bound once per command buffer. Shaders index its arrays with indices
+// handed out by vulkan_bindless_add_*, passed through push constants or instance data.
+typedef struct vulkan_bindless
+{
+    // The descriptors are written into the single set right away. Otherwise every frame in flight has
+    // its own copy of the set, rewritten when it begins if the descriptors changed.
+    b8 update_after_bind;
+    VkDescriptorSetLayout set_layout;
+    VkDescriptorPool descriptor_pool;
+    u32 set_count;
+    VkDescriptorSet sets[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    // Generation of the descriptors written into each set
+    u64 set_generations[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    // Incremented each time a descriptor is added
+    u64 generation;
+    // Set of the current frame
+    u32 current_set;
+    // The set of the current frame is not bound yet, descriptors added are written into it too
+    b8 current_set_open;
+
+    vulkan_bindless_array arrays[VULKAN_BINDLESS_TYPE_COUNT];
+} vulkan_bindless;
+
+// CPU side resources of a single frame in flight. They are reused once in_flight_fence signals,
+// independently of which swapchain image the frame renders into.
+typedef struct vulkan_frame
+{
+    // A pool per recording thread, index 0 is the main thread. All of them are reset at once
+    // when the frame begins.
+    vulkan_transient_command_pool command_pools[VULKAN_MAX_RECORDING_THREADS];
+    // Primary command buffer of the frame, handed out by command_pools[0]
+    vulkan_command_buffer command_buffer;
+
+    // Signaled when the acquired image is available for rendering (when presentation is done with it)
+    VkSemaphore image_available_semaphore;
+    // Signaled when the commands of the frame are complete and the image is ready to be presented
+    VkSemaphore queue_complete_semaphore;
+    // Signaled when the GPU is done with the frame. Not used with timeline semaphores.
+    vulkan_fence in_flight_fence;
+    // context.frame_number + 1 at the time the frame was last submitted, 0 if it has never been
+    u64 submitted_frame_count;
+    // Global set indices of the instances and visible instances of the frame slot, read by the vertex shader
+    u32 instance_buffer_index;
+    u32 visible_instance_buffer_index;
+} vulkan_frame;
+
+// Query pools of a single frame in flight
+typedef struct vulkan_gpu_timer_frame
+{
+    VkQueryPool timestamp_pool;
+    VkQueryPool statistics_pool;
+    // Timestamps written by the frame which was recorded last into this slot
+    u32 timestamp_count;
+    u32 timed_draw_count;
+    b8 statistics_written;
+    // Results are pending read back
+    b8 pending;
+    u64 frame_number;
+} vulkan_gpu_timer_frame;
+
+// Per frame-in-flight ring of query pools with a rolling history of their results
+typedef struct vulkan_gpu_timer
+{
+    // False if the graphics queue does not support timestamps
+    b8 enabled;
+    b8 statistics_enabled;
+    // Statistics collected by the pipeline statistics pools
+    VkQueryPipelineStatisticFlags statistic_flags;
+    // Nanoseconds per timestamp tick
+    f32 timestamp_period;
+    u64 timestamp_mask;
+
+    u32 frame_count;
+    vulkan_gpu_timer_frame *frames;
+
+    // Rolling buffer of RENDERER_GPU_TIMING_HISTORY entries
+    renderer_gpu_frame_timings *history;
+    u32 history_head; // next slot to be written
+    u32 history_count;
+} vulkan_gpu_timer;
+
 typedef struct vulkan_device
 {
     VkPhysicalDevice physical_device;
@@ -116,11 +741,29 @@ typedef struct vulkan_device
     i32 graphics_queue_index;
     i32 present_queue_index;
     i32 transfer_queue_index;
+    i32 compute_queue_index;
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    // VK_NULL_HANDLE if the device has no transfer only queue family
+    VkQueue transferQueue;
+    // VK_NULL_HANDLE if the device has no compute queue family without graphics
+    VkQueue computeQueue;
 
+    // For one-off commands recorded outside of a frame
     VkCommandPool graphics_command_pool;
+
+    VkPhysicalDeviceProperties properties;
+    // Vulkan 1.2 properties, all 0 if the device is older
+    VkPhysicalDeviceVulkan12Properties properties12;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    // Supported Vulkan 1.2 features, all false if the device is older
+    VkPhysicalDeviceVulkan12Features features12;
+    // Supported Vulkan 1.3 features, all false if the device is older
+    VkPhysicalDeviceVulkan13Features features13;
+    // Depth attachment format picked among the ones the device supports
+    VkFormat depth_format;
 } vulkan_device;
 
 typedef struct vulkan_context
@@ -141,36 +784,94 @@ typedef struct vulkan_context
     // Currently used image's index
     u32 image_index;
     f32 frame_delta_time;
+    // Index into frames
     u32 current_frame;
+    // Number of frames submitted so far
+    u64 frame_number;
+    // Number of frames known to be completed on the GPU
+    u64 completed_frame_count;
+    // CPU stats of the frame being drawn
+    renderer_frame_stats frame_stats;
 
     VkInstance instance;
     VkAllocationCallbacks *allocator;
     VkSurfaceKHR surface;
 
+    // Render offscreen without a window, surface or presentation.
+    b8 headless;
+
     b8 recreating_swapchain;
     vulkan_swapchain swap_chain;
 
     vulkan_device device;
     vulkan_renderpass main_renderpass;
-
-    vulkan_command_buffer *graphics_command_buffers;
-
-    /**
-     * Triggered when an image becomes available for rendering
-     * this is when we're done presenting it
-     */
-    VkSemaphore *image_available_semaphores; // darray
-
-    /**
-     * Triggered when a queue run against that and is now complete
-     * and the queue is ready to be presented
-     */
-    VkSemaphore *queue_complete_semaphores; // darray
-
-    u32 in_flight_fence_count;
-    vulkan_fence *in_flight_fences;
-    // Holds pointers to fences which exist and are owned elsewhere.
-    vulkan_fence **images_in_flight; // in sync with current_frame
+    // Render with vkCmdBeginRendering into the swapchain views (Vulkan 1.3), main_renderpass.handle and
+    // the framebuffers are not created
+    b8 use_dynamic_rendering;
+    // Draw the depth of the opaque geometry before shading it, see create_graphics_pipeline
+    b8 depth_prepass;
+    // Requested presentation policy, present_policy_changed triggers a swapchain recreation
+    renderer_present_policy present_policy;
+    b8 present_policy_changed;
+    // Samples of the colour and depth attachments, MSAA if more than 1
+    VkSampleCountFlagBits msaa_samples;
+    // The depth is kept after the render pass to build the depth pyramid of the GPU culling from.
+    // With MSAA it is resolved into swap_chain.depth_resolve with these modes.
+    b8 occlusion_culling;
+    VkResolveModeFlagBits depth_resolve_mode;
+    VkResolveModeFlagBits stencil_resolve_mode;
+
+    VkPipelineCache pipeline_cache;
+    // NULL if the pipeline cache is not persisted
+    const char *pipeline_cache_path;
+    // The shader watcher runs, the pipelines using the shaders it rebuilds are rebuilt too
+    b8 shader_hot_reload;
+
+    // Number of frames the CPU can record ahead of the GPU, [1, RENDERER_MAX_FRAMES_IN_FLIGHT]
+    u32 frames_in_flight;
+    vulkan_frame frames[RENDERER_MAX_FRAMES_IN_FLIGHT];
+    // Number of command pools used in each frame, one per recording thread (the main thread included).
+    // Draws are recorded into secondary command buffers if greater than 1.
+    u32 recording_thread_count;
+    u32 draw_count;
+
+    // Frame count after the frame which last rendered into each swapchain image (image_count entries),
+    // that is the completed frame count at which the image is free again. 0 if not used yet.
+    u64 *images_in_flight;
+
+    // Frames are synchronized with a timeline semaphore instead of fences
+    b8 use_timeline;
+    // Signaled by the frame submissions only, so its value is the number of completed frames
+    vulkan_timeline graphics_timeline;
+
+    vulkan_gpu_timer gpu_timer;
+
+    // Device memory of the buffers and images
+    vulkan_memory_allocator memory;
+    vulkan_uploader uploader;
+    vulkan_geometry geometry;
+    vulkan_compute compute;
+    vulkan_indirect_draws draws;
+    vulkan_culling culling;
+    vulkan_depth_pyramid depth_pyramid;
+    // The global descriptor set of the graphics pipelines
+    vulkan_bindless bindless;
+    // Sampled image uploaded at init, and its index in the global set
+    vulkan_image default_texture;
+    u32 default_texture_index;
+    vulkan_uniform_ring uniform_ring;
+    // Dynamic offset of the global uniforms of the current frame in uniform_ring
+    u32 global_uniform_offset;
+    // Set by renderer_set_instances, otherwise draw_count instances are drawn at the origin
+    b8 custom_instances;
+    // draw_count and mesh count the default instances were generated with
+    u32 default_instance_count;
+    u32 default_instance_mesh_count;
+    // Column major, transforms the instances to clip space. Also gives the frustum of the GPU culling.
+    f32 view_projection[16];
+
+    // Resources retired while frames in flight may still use them
+    vulkan_deletion_queue deletion_queue;
 
 } vulkan_context;
 
@@ -179,6 +880,8 @@ typedef struct vulkan_physical_device_queue_family_info
 {
     i32 graphics_family_index = -1;     // Location of Graphics Queue Family
     i32 presentation_family_index = -1; // Location of the presentation queue family
+    i32 transfer_family_index = -1;     // Location of a transfer queue family without graphics (optional)
+    i32 compute_family_index = -1;      // Location of a compute queue family without graphics (optional)
 } vulkan_physical_device_queue_family_info;
 
 #endif
\ No newline at end of file
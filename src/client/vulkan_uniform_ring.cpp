@@ -0,0 +1,171 @@
+#include "vulkan_uniform_ring.h"
+#include "vulkan_memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Device local memory the CPU can write to, if any
+static b8 has_device_local_host_visible_memory(vulkan_context *context)
+{
+    const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const VkPhysicalDeviceMemoryProperties *memory_properties = &context->device.memory_properties;
+    for (u32 i = 0; i < memory_properties->memoryTypeCount; ++i)
+    {
+        if ((memory_properties->memoryTypes[i].propertyFlags & flags) == flags)
+            return BC_TRUE;
+    }
+    return BC_FALSE;
+}
+
+b8 vulkan_uniform_ring_create(vulkan_context *context, u32 frame_count, VkDeviceSize frame_size, vulkan_uniform_ring *out_ring)
+{
+    memset(out_ring, 0, sizeof(vulkan_uniform_ring));
+    const VkPhysicalDeviceLimits *limits = &context->device.properties.limits;
+    out_ring->alignment = limits->minUniformBufferOffsetAlignment ? limits->minUniformBufferOffsetAlignment : 1;
+    frame_size = align_up(frame_size, out_ring->alignment);
+    out_ring->range = limits->maxUniformBufferRange < frame_size ? limits->maxUniformBufferRange : frame_size;
+
+    // The descriptor range is read from the dynamic offset on, so the last blocks are followed by a range of padding
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = frame_size * frame_count + out_ring->range;
+    buffer_create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(context->device.logical_device, &buffer_create_info, context->allocator, &out_ring->buffer) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uniform_ring_create - Failed to create the uniform buffer.\n");
+        return BC_FALSE;
+    }
+
+    // The dynamic offsets are relative to the memory of the linear allocator, aligned like them
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(context->device.logical_device, out_ring->buffer, &requirements);
+    if (requirements.alignment < out_ring->alignment)
+        requirements.alignment = out_ring->alignment;
+
+    VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    out_ring->device_local = has_device_local_host_visible_memory(context);
+    if (!out_ring->device_local ||
+        !vulkan_linear_allocator_create(
+            context, &context->memory, &requirements, memory_flags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            frame_size, frame_count, out_ring->range, &out_ring->linear))
+    {
+        // The device local host visible heap can be small
+        out_ring->device_local = BC_FALSE;
+        if (!vulkan_linear_allocator_create(
+                context, &context->memory, &requirements, memory_flags, frame_size, frame_count, out_ring->range, &out_ring->linear))
+        {
+            printf("ERROR: vulkan_uniform_ring_create - Failed to allocate the uniform memory.\n");
+            return BC_FALSE;
+        }
+    }
+    if (vkBindBufferMemory(context->device.logical_device, out_ring->buffer, out_ring->linear.allocation.memory, out_ring->linear.allocation.offset) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uniform_ring_create - Failed to bind the uniform memory.\n");
+        return BC_FALSE;
+    }
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 1;
+    layout_create_info.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(context->device.logical_device, &layout_create_info, context->allocator, &out_ring->set_layout) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uniform_ring_create - Failed to create descriptor set layout.\n");
+        return BC_FALSE;
+    }
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = 1;
+    pool_create_info.poolSizeCount = 1;
+    pool_create_info.pPoolSizes = &pool_size;
+    if (vkCreateDescriptorPool(context->device.logical_device, &pool_create_info, context->allocator, &out_ring->descriptor_pool) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uniform_ring_create - Failed to create descriptor pool.\n");
+        return BC_FALSE;
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = out_ring->descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &out_ring->set_layout;
+    if (vkAllocateDescriptorSets(context->device.logical_device, &allocate_info, &out_ring->descriptor_set) != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uniform_ring_create - Failed to allocate descriptor set.\n");
+        return BC_FALSE;
+    }
+
+    // Written once, the blocks are selected with the dynamic offsets
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = out_ring->buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = out_ring->range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = out_ring->descriptor_set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(context->device.logical_device, 1, &write, 0, NULL);
+
+    vulkan_uniform_ring_begin_frame(out_ring, 0);
+    return BC_TRUE;
+}
+
+void vulkan_uniform_ring_destroy(vulkan_context *context, vulkan_uniform_ring *ring)
+{
+    if (ring->descriptor_pool)
+        vkDestroyDescriptorPool(context->device.logical_device, ring->descriptor_pool, context->allocator);
+    if (ring->set_layout)
+        vkDestroyDescriptorSetLayout(context->device.logical_device, ring->set_layout, context->allocator);
+    if (ring->buffer)
+        vkDestroyBuffer(context->device.logical_device, ring->buffer, context->allocator);
+    if (ring->linear.allocation.memory)
+        vulkan_linear_allocator_destroy(context, &context->memory, &ring->linear);
+
+    memset(ring, 0, sizeof(vulkan_uniform_ring));
+}
+
+void vulkan_uniform_ring_begin_frame(vulkan_uniform_ring *ring, u32 frame_slot)
+{
+    vulkan_linear_allocator_begin_frame(&ring->linear, frame_slot);
+}
+
+void *vulkan_uniform_ring_push(vulkan_uniform_ring *ring, VkDeviceSize size, u32 *out_dynamic_offset)
+{
+    vulkan_allocation block;
+    if (size > ring->range || !vulkan_linear_allocator_allocate(&ring->linear, size, ring->alignment, &block))
+    {
+        printf("WARN: vulkan_uniform_ring_push - Out of uniform memory for the frame.\n");
+        return NULL;
+    }
+
+    *out_dynamic_offset = (u32)(block.offset - ring->linear.allocation.offset);
+    return block.mapped;
+}
+
+void vulkan_uniform_ring_bind(
+    const vulkan_uniform_ring *ring, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+    VkPipelineLayout layout, u32 set_index, u32 dynamic_offset)
+{
+    vkCmdBindDescriptorSets(command_buffer, bind_point, layout, set_index, 1, &ring->descriptor_set, 1, &dynamic_offset);
+}
@@ -0,0 +1,58 @@
+#ifndef VULKAN_NOTES_1704455980_VULKAN_UNIFORM_RING_H
+#define VULKAN_NOTES_1704455980_VULKAN_UNIFORM_RING_H
+
+#include "vulkan_types.h"
+
+/*
+A single uniform buffer, mapped once when created, over the memory of a vulkan_linear_allocator with a slot per
+frame in flight. Each frame the uniform blocks are bumped one after the other from the slot of the frame (aligned
+to minUniformBufferOffsetAlignment) and written with a plain memcpy, nothing is mapped or allocated while drawing.
+A single dynamic uniform buffer descriptor covers the whole buffer, each block is bound with its dynamic offset.
+
+The part of a slot is only reused once the GPU is done with the previous frame of the slot. The memory is host
+coherent, and device local as well if the device has such memory (resizable BAR, integrated GPUs).
+*/
+
+/**
+ * Creates the buffer and its descriptor set.
+ * @param context A pointer to the vulkan context.
+ * @param frame_count The number of frames in flight.
+ * @param frame_size The bytes of uniform data per frame.
+ * @param out_ring A pointer to the ring to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_uniform_ring_create(vulkan_context *context, u32 frame_count, VkDeviceSize frame_size, vulkan_uniform_ring *out_ring);
+
+/**
+ * Destroys the buffer and the descriptor set. The GPU should be done with them.
+ */
+void vulkan_uniform_ring_destroy(vulkan_context *context, vulkan_uniform_ring *ring);
+
+/**
+ * Starts pushing into the part of the frame slot. The GPU should be done with the previous use of the slot.
+ */
+void vulkan_uniform_ring_begin_frame(vulkan_uniform_ring *ring, u32 frame_slot);
+
+/**
+ * Takes a block of the current frame. Not thread safe.
+ * @param ring A pointer to the ring.
+ * @param size The size of the block in bytes, at most ring->range.
+ * @param out_dynamic_offset A pointer to the dynamic offset of the block.
+ * @returns The mapped block to memcpy the data into or NULL if the part of the frame is full.
+ */
+void *vulkan_uniform_ring_push(vulkan_uniform_ring *ring, VkDeviceSize size, u32 *out_dynamic_offset);
+
+/**
+ * Binds the descriptor set of the ring at a block. Can be called from any thread.
+ * @param ring A pointer to the ring.
+ * @param command_buffer The command buffer.
+ * @param bind_point The pipeline bind point.
+ * @param layout A pipeline layout with the layout of the ring as set set_index.
+ * @param set_index The index of the set in the layout.
+ * @param dynamic_offset The dynamic offset of the block.
+ */
+void vulkan_uniform_ring_bind(
+    const vulkan_uniform_ring *ring, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+    VkPipelineLayout layout, u32 set_index, u32 dynamic_offset);
+
+#endif
@@ -0,0 +1,421 @@
+#include "vulkan_upload.h"
+#include "vulkan_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_timeline.h"
+#include "log_assert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Keeps the staging offsets aligned for any kind of data (and texel size of the images)
+#define STAGING_ALIGNMENT 16
+
+#define GROW_ARRAY(array, count, capacity, type)                                       \
+    if ((count) == (capacity))                                                         \
+    {                                                                                  \
+        (capacity) = (capacity) ? (capacity) * 2 : 64;                                 \
+        (array) = (type *)realloc((array), sizeof(type) * (capacity));                 \
+    }
+
+static const VkImageSubresourceRange color_subresource_range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+static inline VkDeviceSize align_staging(VkDeviceSize offset)
+{
+    return (offset + STAGING_ALIGNMENT - 1) & ~(VkDeviceSize)(STAGING_ALIGNMENT - 1);
+}
+
+// Waits for the previous submission of the current batch so its staging range and command pool can be reused
+static b8 wait_for_batch(vulkan_context *context, vulkan_uploader *uploader)
+{
+    vulkan_upload_batch *batch = &uploader->batches[uploader->current_batch];
+    if (!batch->in_flight)
+        return BC_TRUE;
+
+    VkResult result = vkWaitForFences(context->device.logical_device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uploader - Failed to wait for the upload batch.\n");
+        return BC_FALSE;
+    }
+    vkResetFences(context->device.logical_device, 1, &batch->fence);
+    vulkan_transient_command_pool_reset(context, &batch->command_pool);
+
+    batch->in_flight = BC_FALSE;
+    return BC_TRUE;
+}
+
+// Reserves size contiguous bytes of the current batch, flushing it first if they do not fit.
+// Fails if they do not fit in an empty batch.
+static b8 reserve_staging(vulkan_context *context, vulkan_uploader *uploader, VkDeviceSize size, VkDeviceSize *out_offset)
+{
+    for (;;)
+    {
+        if (!wait_for_batch(context, uploader))
+            return BC_FALSE;
+
+        vulkan_upload_batch *batch = &uploader->batches[uploader->current_batch];
+        VkDeviceSize offset = align_staging(uploader->head);
+        if (offset + size <= batch->end)
+        {
+            *out_offset = offset;
+            uploader->head = offset + size;
+            return BC_TRUE;
+        }
+        // Nothing queued in the batch yet, it would never fit
+        if (uploader->head == batch->begin)
+            return BC_FALSE;
+        if (!vulkan_uploader_flush(context, uploader))
+            return BC_FALSE;
+    }
+}
+
+b8 vulkan_uploader_create(vulkan_context *context, VkDeviceSize staging_size, b8 use_transfer_queue, vulkan_uploader *out_uploader)
+{
+    memset(out_uploader, 0, sizeof(vulkan_uploader));
+
+    // The handover to the graphics queue waits on a timeline semaphore
+    out_uploader->use_transfer_queue = use_transfer_queue && context->device.transferQueue && context->device.features12.timelineSemaphore;
+    if (out_uploader->use_transfer_queue)
+    {
+        out_uploader->queue = context->device.transferQueue;
+        out_uploader->queue_family_index = (u32)context->device.transfer_queue_index;
+        vulkan_timeline_create(context, &out_uploader->timeline);
+    }
+    else
+    {
+        out_uploader->queue = context->device.graphicsQueue;
+        out_uploader->queue_family_index = (u32)context->device.graphics_queue_index;
+    }
+
+    if (!vulkan_buffer_create(
+            context, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &out_uploader->staging))
+        return BC_FALSE;
+
+    VkDeviceSize batch_size = (staging_size / VULKAN_UPLOAD_BATCH_COUNT) & ~(VkDeviceSize)(STAGING_ALIGNMENT - 1);
+    for (u32 i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; ++i)
+    {
+        vulkan_upload_batch *batch = &out_uploader->batches[i];
+        batch->begin = batch_size * i;
+        batch->end = batch->begin + batch_size;
+
+        vulkan_transient_command_pool_create(context, out_uploader->queue_family_index, &batch->command_pool);
+
+        VkFenceCreateInfo fence_create_info = {};
+        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkResult result = vkCreateFence(context->device.logical_device, &fence_create_info, context->allocator, &batch->fence);
+        if (result != VK_SUCCESS)
+        {
+            printf("ERROR: vulkan_uploader_create - Failed to create fence.\n");
+            return BC_FALSE;
+        }
+    }
+    out_uploader->head = out_uploader->batches[0].begin;
+
+    return BC_TRUE;
+}
+
+void vulkan_uploader_destroy(vulkan_context *context, vulkan_uploader *uploader)
+{
+    for (u32 i = 0; i < VULKAN_UPLOAD_BATCH_COUNT; ++i)
+    {
+        uploader->current_batch = i;
+        wait_for_batch(context, uploader);
+
+        vulkan_upload_batch *batch = &uploader->batches[i];
+        if (batch->fence)
+            vkDestroyFence(context->device.logical_device, batch->fence, context->allocator);
+        vulkan_transient_command_pool_destroy(context, &batch->command_pool);
+    }
+
+    if (uploader->use_transfer_queue)
+        vulkan_timeline_destroy(context, &uploader->timeline);
+    vulkan_buffer_destroy(context, &uploader->staging);
+    free(uploader->copies);
+    free(uploader->image_copies);
+    free(uploader->buffer_acquires);
+    free(uploader->image_acquires);
+
+    memset(uploader, 0, sizeof(vulkan_uploader));
+}
+
+b8 vulkan_uploader_upload_buffer(
+    vulkan_context *context, vulkan_uploader *uploader,
+    const vulkan_buffer *dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size,
+    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    if (dst_offset + size > dst->size)
+    {
+        printf("ERROR: vulkan_uploader_upload_buffer - Upload out of the bounds of the destination buffer.\n");
+        return BC_FALSE;
+    }
+
+    const u8 *src = (const u8 *)data;
+    while (size)
+    {
+        if (!wait_for_batch(context, uploader))
+            return BC_FALSE;
+
+        vulkan_upload_batch *batch = &uploader->batches[uploader->current_batch];
+        VkDeviceSize head = align_staging(uploader->head);
+        if (head >= batch->end)
+        {
+            // Full, submit what is queued and go on with the next batch
+            if (!vulkan_uploader_flush(context, uploader))
+                return BC_FALSE;
+            continue;
+        }
+
+        VkDeviceSize chunk = batch->end - head;
+        if (chunk > size)
+            chunk = size;
+        memcpy((u8 *)uploader->staging.mapped + head, src, chunk);
+
+        GROW_ARRAY(uploader->copies, uploader->copy_count, uploader->copy_capacity, vulkan_pending_copy);
+        vulkan_pending_copy *copy = &uploader->copies[uploader->copy_count++];
+        copy->dst = dst->handle;
+        copy->region.srcOffset = head;
+        copy->region.dstOffset = dst_offset;
+        copy->region.size = chunk;
+
+        uploader->dst_stages |= dst_stages;
+        uploader->dst_access |= dst_access;
+        uploader->head = head + chunk;
+        src += chunk;
+        dst_offset += chunk;
+        size -= chunk;
+    }
+
+    return BC_TRUE;
+}
+
+b8 vulkan_uploader_upload_image(
+    vulkan_context *context, vulkan_uploader *uploader,
+    VkImage image, VkExtent3D extent, const void *data, VkDeviceSize size,
+    VkImageLayout final_layout, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    VkDeviceSize offset;
+    if (!reserve_staging(context, uploader, size, &offset))
+    {
+        printf("ERROR: vulkan_uploader_upload_image - The image does not fit in an upload batch.\n");
+        return BC_FALSE;
+    }
+    memcpy((u8 *)uploader->staging.mapped + offset, data, size);
+
+    GROW_ARRAY(uploader->image_copies, uploader->image_copy_count, uploader->image_copy_capacity, vulkan_pending_image_copy);
+    vulkan_pending_image_copy *copy = &uploader->image_copies[uploader->image_copy_count++];
+    memset(copy, 0, sizeof(vulkan_pending_image_copy));
+    copy->image = image;
+    copy->region.bufferOffset = offset;
+    copy->region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy->region.imageSubresource.layerCount = 1;
+    copy->region.imageExtent = extent;
+    copy->final_layout = final_layout;
+    copy->dst_stages = dst_stages;
+    copy->dst_access = dst_access;
+    return BC_TRUE;
+}
+
+static VkImageMemoryBarrier image_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = color_subresource_range;
+    return barrier;
+}
+
+// Records the copies of the batch along with the barriers making them visible to the graphics queue
+static void record_copies(vulkan_context *context, vulkan_uploader *uploader, VkCommandBuffer command_buffer)
+{
+    // One copy command per run of copies into the same buffer
+    if (uploader->copy_count)
+    {
+        VkBufferCopy *regions = (VkBufferCopy *)malloc(sizeof(VkBufferCopy) * uploader->copy_count);
+        for (u32 i = 0; i < uploader->copy_count; ++i)
+            regions[i] = uploader->copies[i].region;
+        u32 first = 0;
+        for (u32 i = 1; i <= uploader->copy_count; ++i)
+        {
+            if (i == uploader->copy_count || uploader->copies[i].dst != uploader->copies[first].dst)
+            {
+                vkCmdCopyBuffer(command_buffer, uploader->staging.handle, uploader->copies[first].dst, i - first, &regions[first]);
+                first = i;
+            }
+        }
+        free(regions);
+    }
+
+    u32 image_count = uploader->image_copy_count;
+    VkImageMemoryBarrier *image_barriers = NULL;
+    if (image_count)
+    {
+        image_barriers = (VkImageMemoryBarrier *)malloc(sizeof(VkImageMemoryBarrier) * image_count);
+        for (u32 i = 0; i < image_count; ++i)
+            image_barriers[i] = image_barrier(uploader->image_copies[i].image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, NULL, 0, NULL, image_count, image_barriers);
+
+        for (u32 i = 0; i < image_count; ++i)
+            vkCmdCopyBufferToImage(command_buffer, uploader->staging.handle, uploader->image_copies[i].image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &uploader->image_copies[i].region);
+    }
+
+    VkPipelineStageFlags dst_stages = uploader->copy_count ? uploader->dst_stages : 0;
+    for (u32 i = 0; i < image_count; ++i)
+    {
+        const vulkan_pending_image_copy *copy = &uploader->image_copies[i];
+        image_barriers[i] = image_barrier(copy->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy->final_layout,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT, copy->dst_access);
+        dst_stages |= copy->dst_stages;
+    }
+
+    if (!uploader->use_transfer_queue)
+    {
+        // Same queue as the frames, a barrier is enough to make the copies visible to them
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = uploader->dst_access;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0,
+                             uploader->copy_count ? 1 : 0, &barrier, 0, NULL, image_count, image_barriers);
+        free(image_barriers);
+        return;
+    }
+
+    // Release to the graphics family. The acquire half uses the same parameters but its own access masks.
+    u32 graphics_family = (u32)context->device.graphics_queue_index;
+    VkBufferMemoryBarrier *buffer_releases = (VkBufferMemoryBarrier *)malloc(sizeof(VkBufferMemoryBarrier) * (uploader->copy_count + 1));
+    for (u32 i = 0; i < uploader->copy_count; ++i)
+    {
+        VkBufferMemoryBarrier *release = &buffer_releases[i];
+        memset(release, 0, sizeof(VkBufferMemoryBarrier));
+        release->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release->srcQueueFamilyIndex = uploader->queue_family_index;
+        release->dstQueueFamilyIndex = graphics_family;
+        release->buffer = uploader->copies[i].dst;
+        release->offset = uploader->copies[i].region.dstOffset;
+        release->size = uploader->copies[i].region.size;
+
+        GROW_ARRAY(uploader->buffer_acquires, uploader->buffer_acquire_count, uploader->buffer_acquire_capacity, VkBufferMemoryBarrier);
+        VkBufferMemoryBarrier *acquire = &uploader->buffer_acquires[uploader->buffer_acquire_count++];
+        *acquire = *release;
+        acquire->srcAccessMask = 0;
+        acquire->dstAccessMask = uploader->dst_access;
+    }
+    for (u32 i = 0; i < image_count; ++i)
+    {
+        VkImageMemoryBarrier *release = &image_barriers[i];
+        release->srcQueueFamilyIndex = uploader->queue_family_index;
+        release->dstQueueFamilyIndex = graphics_family;
+
+        GROW_ARRAY(uploader->image_acquires, uploader->image_acquire_count, uploader->image_acquire_capacity, VkImageMemoryBarrier);
+        VkImageMemoryBarrier *acquire = &uploader->image_acquires[uploader->image_acquire_count++];
+        *acquire = *release;
+        release->dstAccessMask = 0;
+        acquire->srcAccessMask = 0;
+    }
+    uploader->acquire_stages |= dst_stages;
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, NULL, uploader->copy_count, buffer_releases, image_count, image_barriers);
+    free(buffer_releases);
+    free(image_barriers);
+}
+
+b8 vulkan_uploader_flush(vulkan_context *context, vulkan_uploader *uploader)
+{
+    if (!uploader->copy_count && !uploader->image_copy_count)
+        return BC_TRUE;
+
+    vulkan_upload_batch *batch = &uploader->batches[uploader->current_batch];
+    VkCommandBuffer command_buffer = vulkan_transient_command_pool_acquire(context, &batch->command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+        ERR_EXIT("Failed to begin recording upload command buffer!\n", "vulkan_uploader_flush");
+
+    record_copies(context, uploader, command_buffer);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+        ERR_EXIT("Failed to record upload command buffer!\n", "vulkan_uploader_flush");
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+
+    uint64_t signal_value = 0;
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info = {};
+    if (uploader->use_transfer_queue)
+    {
+        signal_value = vulkan_timeline_next_value(&uploader->timeline);
+        timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_submit_info.signalSemaphoreValueCount = 1;
+        timeline_submit_info.pSignalSemaphoreValues = &signal_value;
+        submit_info.pNext = &timeline_submit_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &uploader->timeline.handle;
+    }
+
+    VkResult result = vkQueueSubmit(uploader->queue, 1, &submit_info, batch->fence);
+    if (result != VK_SUCCESS)
+    {
+        printf("ERROR: vulkan_uploader_flush - vkQueueSubmit failed.\n");
+        return BC_FALSE;
+    }
+
+    batch->in_flight = BC_TRUE;
+    uploader->copy_count = 0;
+    uploader->image_copy_count = 0;
+    uploader->dst_stages = 0;
+    uploader->dst_access = 0;
+
+    // The next batch is only waited on once something is written into it
+    uploader->current_batch = (uploader->current_batch + 1) % VULKAN_UPLOAD_BATCH_COUNT;
+    uploader->head = uploader->batches[uploader->current_batch].begin;
+    return BC_TRUE;
+}
+
+void vulkan_uploader_record_acquire(vulkan_uploader *uploader, VkCommandBuffer command_buffer)
+{
+    if (!uploader->buffer_acquire_count && !uploader->image_acquire_count)
+        return;
+
+    // The semaphore wait of the submission orders the acquire after the release
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uploader->acquire_stages, 0,
+                         0, NULL, uploader->buffer_acquire_count, uploader->buffer_acquires,
+                         uploader->image_acquire_count, uploader->image_acquires);
+
+    uploader->graphics_wait_value = uploader->timeline.last_value;
+    uploader->graphics_wait_stages |= uploader->acquire_stages;
+    uploader->buffer_acquire_count = 0;
+    uploader->image_acquire_count = 0;
+    uploader->acquire_stages = 0;
+}
+
+b8 vulkan_uploader_take_graphics_wait(vulkan_uploader *uploader, VkSemaphore *out_semaphore, u64 *out_value, VkPipelineStageFlags *out_stages)
+{
+    if (!uploader->graphics_wait_value)
+        return BC_FALSE;
+
+    *out_semaphore = uploader->timeline.handle;
+    *out_value = uploader->graphics_wait_value;
+    *out_stages = uploader->graphics_wait_stages;
+    uploader->graphics_wait_value = 0;
+    uploader->graphics_wait_stages = 0;
+    return BC_TRUE;
+}
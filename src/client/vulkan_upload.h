@@ -0,0 +1,100 @@
+#ifndef VULKAN_NOTES_1704029011_VULKAN_UPLOAD_H
+#define VULKAN_NOTES_1704029011_VULKAN_UPLOAD_H
+
+#include "vulkan_types.h"
+
+/*
+Uploads to device local resources go through a single host visible staging buffer, split between a
+ring of VULKAN_UPLOAD_BATCH_COUNT batches. Each upload copies the data into the current batch and
+queues the copy. vulkan_uploader_flush records all queued copies of the batch into one command buffer,
+submits it and moves on to the next batch. Nothing waits unless the ring wraps onto a batch which is
+still executing.
+
+If the device has a transfer only queue family (and timeline semaphores), batches run on that queue so
+streaming does not take graphics queue time. Every destination is released to the graphics family at
+the end of its batch; the next frame records the matching acquire barriers with
+vulkan_uploader_record_acquire and its submission waits on the uploader's timeline.
+Otherwise batches are submitted to the graphics queue, which then sees the data in later submissions.
+
+Destinations should not be in use by the GPU when uploaded to: buffer ranges are expected to be fresh
+(i.e. newly allocated meshes) and images newly created, in VK_IMAGE_LAYOUT_UNDEFINED.
+*/
+
+/**
+ * Creates the uploader and its staging buffer.
+ * @param context A pointer to the vulkan context.
+ * @param staging_size The size of the staging buffer in bytes, shared by the batches. Bigger buffer uploads are split.
+ * @param use_transfer_queue Run the copies on the transfer queue if the device has one.
+ * @param out_uploader A pointer to the uploader to be created.
+ * @returns True if created successfully; otherwise false.
+ */
+b8 vulkan_uploader_create(vulkan_context *context, VkDeviceSize staging_size, b8 use_transfer_queue, vulkan_uploader *out_uploader);
+
+/**
+ * Waits for the batches in flight and destroys the uploader. Queued copies which were not flushed are dropped.
+ */
+void vulkan_uploader_destroy(vulkan_context *context, vulkan_uploader *uploader);
+
+/**
+ * Queues a copy of data into dst. The data is copied into the staging buffer before returning.
+ * @param context A pointer to the vulkan context.
+ * @param uploader A pointer to the uploader.
+ * @param dst The destination buffer. Should have VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+ * @param dst_offset The offset in dst in bytes.
+ * @param data The data to be uploaded.
+ * @param size The size of data in bytes.
+ * @param dst_stages The pipeline stages which will read the data, i.e. VK_PIPELINE_STAGE_VERTEX_INPUT_BIT.
+ * @param dst_access The access type of those stages, i.e. VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT.
+ * @returns True if queued successfully; otherwise false.
+ */
+b8 vulkan_uploader_upload_buffer(
+    vulkan_context *context, vulkan_uploader *uploader,
+    const vulkan_buffer *dst, VkDeviceSize dst_offset, const void *data, VkDeviceSize size,
+    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+/**
+ * Queues a copy of data into the first mip level and layer of a color image, then transitions it to final_layout.
+ * The data should fit in a single batch (the staging size divided by VULKAN_UPLOAD_BATCH_COUNT).
+ * Only whole subresources are copied: the transfer only family may have a minImageTransferGranularity other than
+ * (1,1,1), which rules out arbitrary regions, but a whole subresource is valid for any granularity ((0,0,0) too).
+ * @param context A pointer to the vulkan context.
+ * @param uploader A pointer to the uploader.
+ * @param image The destination image, in VK_IMAGE_LAYOUT_UNDEFINED. Should have VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+ * @param extent The size of the image in texels, the whole first mip level is written.
+ * @param data The tightly packed texels.
+ * @param size The size of data in bytes.
+ * @param final_layout The layout the image is used in, i.e. VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+ * @param dst_stages The pipeline stages which will read the image.
+ * @param dst_access The access type of those stages.
+ * @returns True if queued successfully; otherwise false.
+ */
+b8 vulkan_uploader_upload_image(
+    vulkan_context *context, vulkan_uploader *uploader,
+    VkImage image, VkExtent3D extent, const void *data, VkDeviceSize size,
+    VkImageLayout final_layout, VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+/**
+ * Submits the queued copies, if any, in a single submission and moves on to the next batch. Does not wait.
+ * @returns True if there was nothing to submit or submitted successfully; otherwise false.
+ */
+b8 vulkan_uploader_flush(vulkan_context *context, vulkan_uploader *uploader);
+
+/**
+ * Records the acquire barriers of the resources released by the batches submitted so far.
+ * The submission of command_buffer should then wait as told by vulkan_uploader_take_graphics_wait.
+ * @param uploader A pointer to the uploader.
+ * @param command_buffer A graphics command buffer being recorded, outside of a render pass.
+ */
+void vulkan_uploader_record_acquire(vulkan_uploader *uploader, VkCommandBuffer command_buffer);
+
+/**
+ * Gets the wait the next graphics submission needs for the acquire barriers recorded so far, and clears it.
+ * @param uploader A pointer to the uploader.
+ * @param out_semaphore The uploader's timeline semaphore.
+ * @param out_value The value to wait for.
+ * @param out_stages The stages to wait at.
+ * @returns True if the submission has to wait; otherwise false.
+ */
+b8 vulkan_uploader_take_graphics_wait(vulkan_uploader *uploader, VkSemaphore *out_semaphore, u64 *out_value, VkPipelineStageFlags *out_stages);
+
+#endif